@@ -0,0 +1,42 @@
+import esphome.codegen as cg
+from esphome.components import ecoworthy_bms
+import esphome.config_validation as cv
+from esphome.const import CONF_ID
+
+AUTO_LOAD = ["ecoworthy_bms", "sensor"]
+CODEOWNERS = ["@rar"]
+MULTI_CONF = True
+
+CONF_ECOWORTHY_BANK_ID = "ecoworthy_bank_id"
+CONF_ECOWORTHY_BMS_IDS = "ecoworthy_bms_ids"
+CONF_PACK_TIMEOUT = "pack_timeout"
+
+ecoworthy_bank_ns = cg.esphome_ns.namespace("ecoworthy_bank")
+EcoworthyBank = ecoworthy_bank_ns.class_("EcoworthyBank", cg.PollingComponent)
+
+ECOWORTHY_BANK_COMPONENT_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_ECOWORTHY_BANK_ID): cv.use_id(EcoworthyBank),
+    }
+)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(EcoworthyBank),
+        # Packs are numbered across these instances in list order
+        cv.Required(CONF_ECOWORTHY_BMS_IDS): cv.All(
+            cv.ensure_list(cv.use_id(ecoworthy_bms.EcoworthyBms)), cv.Length(min=1)
+        ),
+        # Packs that have not answered for this long are left out of the totals
+        cv.Optional(CONF_PACK_TIMEOUT, default="60s"): cv.positive_time_period_milliseconds,
+    }
+).extend(cv.polling_component_schema("10s"))
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+    cg.add(var.set_pack_timeout(config[CONF_PACK_TIMEOUT]))
+    for bms_id in config[CONF_ECOWORTHY_BMS_IDS]:
+        bms = await cg.get_variable(bms_id)
+        cg.add(var.add_bms(bms))
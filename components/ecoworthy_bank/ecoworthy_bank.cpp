@@ -0,0 +1,238 @@
+#include "ecoworthy_bank.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace ecoworthy_bank {
+
+static const char *const TAG = "ecoworthy_bank";
+
+using ecoworthy_bms::PackStatus;
+
+static uint8_t cell_number(float value) { return std::isnan(value) ? 0 : uint8_t(value); }
+
+void EcoworthyBank::setup() {
+  uint8_t first_pack = 0;
+  for (auto *bms : this->bms_) {
+    bms->add_on_pack_status_callback([this, first_pack](uint8_t battery_index, const PackStatus &status) {
+      this->on_pack_status_(first_pack + battery_index, status);
+    });
+    first_pack += bms->get_battery_count();
+  }
+  if (first_pack >= NO_PACK) {
+    ESP_LOGE(TAG, "Too many packs (%u)", first_pack);
+    this->mark_failed();
+    return;
+  }
+  this->packs_.resize(first_pack);
+}
+
+void EcoworthyBank::dump_config() {
+  ESP_LOGCONFIG(TAG, "Ecoworthy Bank:");
+  ESP_LOGCONFIG(TAG, "  BMS instances: %u", (unsigned) this->bms_.size());
+  ESP_LOGCONFIG(TAG, "  Packs: %u", (unsigned) this->packs_.size());
+  ESP_LOGCONFIG(TAG, "  Pack timeout: %u ms", this->pack_timeout_);
+  LOG_UPDATE_INTERVAL(this);
+  LOG_SENSOR("  ", "Current", this->sensors_[BANK_CURRENT]);
+  LOG_SENSOR("  ", "Power", this->sensors_[BANK_POWER]);
+  LOG_SENSOR("  ", "State Of Charge", this->sensors_[BANK_STATE_OF_CHARGE]);
+  LOG_SENSOR("  ", "Remaining Capacity", this->sensors_[BANK_REMAINING_CAPACITY]);
+  LOG_SENSOR("  ", "Full Capacity", this->sensors_[BANK_FULL_CAPACITY]);
+  LOG_SENSOR("  ", "Min Cell Voltage", this->sensors_[BANK_MIN_CELL_VOLTAGE]);
+  LOG_SENSOR("  ", "Min Voltage Pack", this->sensors_[BANK_MIN_VOLTAGE_PACK]);
+  LOG_SENSOR("  ", "Min Voltage Cell", this->sensors_[BANK_MIN_VOLTAGE_CELL]);
+  LOG_SENSOR("  ", "Max Cell Voltage", this->sensors_[BANK_MAX_CELL_VOLTAGE]);
+  LOG_SENSOR("  ", "Max Voltage Pack", this->sensors_[BANK_MAX_VOLTAGE_PACK]);
+  LOG_SENSOR("  ", "Max Voltage Cell", this->sensors_[BANK_MAX_VOLTAGE_CELL]);
+  LOG_SENSOR("  ", "Delta Cell Voltage", this->sensors_[BANK_DELTA_CELL_VOLTAGE]);
+  LOG_SENSOR("  ", "Max Temperature", this->sensors_[BANK_MAX_TEMPERATURE]);
+  LOG_SENSOR("  ", "Max Temperature Pack", this->sensors_[BANK_MAX_TEMPERATURE_PACK]);
+  LOG_SENSOR("  ", "Charge Current Limit", this->sensors_[BANK_CHARGE_CURRENT_LIMIT]);
+  LOG_SENSOR("  ", "Discharge Current Limit", this->sensors_[BANK_DISCHARGE_CURRENT_LIMIT]);
+  LOG_SENSOR("  ", "Online Packs", this->sensors_[BANK_ONLINE_PACKS]);
+}
+
+float EcoworthyBank::get_setup_priority() const { return setup_priority::DATA; }
+
+void EcoworthyBank::on_pack_status_(uint8_t pack, const PackStatus &status) {
+  PackEntry &entry = this->packs_[pack];
+  const PackEntry previous = entry;
+
+  entry.online = true;
+  entry.timestamp = status.timestamp;
+  entry.current = status.get(ecoworthy_bms::PACK_CURRENT);
+  entry.power = status.power();
+  entry.remaining_capacity = status.get(ecoworthy_bms::PACK_REMAINING_CAPACITY);
+  entry.full_capacity = status.get(ecoworthy_bms::PACK_FULL_CAPACITY);
+  entry.state_of_charge = status.get(ecoworthy_bms::PACK_STATE_OF_CHARGE);
+  entry.min_cell_voltage = status.get(ecoworthy_bms::PACK_MIN_CELL_VOLTAGE);
+  entry.min_voltage_cell = cell_number(status.get(ecoworthy_bms::PACK_MIN_VOLTAGE_CELL));
+  entry.max_cell_voltage = status.get(ecoworthy_bms::PACK_MAX_CELL_VOLTAGE);
+  entry.max_voltage_cell = cell_number(status.get(ecoworthy_bms::PACK_MAX_VOLTAGE_CELL));
+  entry.max_temperature = status.get(ecoworthy_bms::PACK_MAX_TEMPERATURE);
+  entry.charge_current_limit = status.get(ecoworthy_bms::PACK_CHARGE_CURRENT_LIMIT);
+  entry.discharge_current_limit = status.get(ecoworthy_bms::PACK_DISCHARGE_CURRENT_LIMIT);
+
+  if (previous.online) {
+    this->remove_entry_(previous);
+  } else {
+    this->online_packs_++;
+  }
+  this->add_entry_(entry);
+  this->update_extremes_(pack, previous);
+  this->update_status_();
+}
+
+void EcoworthyBank::add_entry_(const PackEntry &entry) {
+  this->current_.add(entry.current);
+  this->power_.add(entry.power);
+  this->remaining_capacity_.add(entry.remaining_capacity);
+  this->full_capacity_.add(entry.full_capacity);
+  this->charge_weighted_.add(entry.state_of_charge * entry.full_capacity);
+  this->soc_capacity_.add(std::isnan(entry.state_of_charge) ? NAN : entry.full_capacity);
+  this->charge_limit_packs_ += std::isnan(entry.charge_current_limit) ? 0 : 1;
+  this->discharge_limit_packs_ += std::isnan(entry.discharge_current_limit) ? 0 : 1;
+}
+
+void EcoworthyBank::remove_entry_(const PackEntry &entry) {
+  this->current_.remove(entry.current);
+  this->power_.remove(entry.power);
+  this->remaining_capacity_.remove(entry.remaining_capacity);
+  this->full_capacity_.remove(entry.full_capacity);
+  this->charge_weighted_.remove(entry.state_of_charge * entry.full_capacity);
+  this->soc_capacity_.remove(std::isnan(entry.state_of_charge) ? NAN : entry.full_capacity);
+  this->charge_limit_packs_ -= std::isnan(entry.charge_current_limit) ? 0 : 1;
+  this->discharge_limit_packs_ -= std::isnan(entry.discharge_current_limit) ? 0 : 1;
+}
+
+void EcoworthyBank::update_extremes_(uint8_t pack, const PackEntry &previous) {
+  this->update_extreme_(this->min_cell_pack_, &PackEntry::min_cell_voltage, true, pack, previous);
+  this->update_extreme_(this->max_cell_pack_, &PackEntry::max_cell_voltage, false, pack, previous);
+  this->update_extreme_(this->max_temperature_pack_, &PackEntry::max_temperature, false, pack, previous);
+  this->update_extreme_(this->min_charge_limit_pack_, &PackEntry::charge_current_limit, true, pack, previous);
+  this->update_extreme_(this->min_discharge_limit_pack_, &PackEntry::discharge_current_limit, true, pack,
+                        previous);
+}
+
+// O(1) unless the holder's own value got less extreme or went away; then the packs are scanned
+void EcoworthyBank::update_extreme_(uint8_t &holder, PackValue value, bool lowest, uint8_t pack,
+                                    const PackEntry &previous) {
+  const PackEntry &entry = this->packs_[pack];
+  const float current = entry.online ? entry.*value : NAN;
+  if (holder == pack) {
+    const float before = previous.*value;
+    if (std::isnan(current) || (lowest ? current > before : current < before)) {
+      holder = this->find_extreme_(value, lowest);
+    }
+    return;
+  }
+  if (std::isnan(current)) {
+    return;
+  }
+  if (holder == NO_PACK) {
+    holder = pack;
+    return;
+  }
+  const float best = this->packs_[holder].*value;
+  if (lowest ? current < best : current > best) {
+    holder = pack;
+  }
+}
+
+uint8_t EcoworthyBank::find_extreme_(PackValue value, bool lowest) const {
+  uint8_t holder = NO_PACK;
+  float best = NAN;
+  for (uint8_t pack = 0; pack < this->packs_.size(); pack++) {
+    const PackEntry &entry = this->packs_[pack];
+    const float candidate = entry.*value;
+    if (!entry.online || std::isnan(candidate)) {
+      continue;
+    }
+    if (holder == NO_PACK || (lowest ? candidate < best : candidate > best)) {
+      holder = pack;
+      best = candidate;
+    }
+  }
+  return holder;
+}
+
+void EcoworthyBank::update_status_() {
+  BankStatus &status = this->status_;
+  status.online_packs = this->online_packs_;
+  status.current = this->current_.value();
+  status.power = this->power_.value();
+  status.remaining_capacity = this->remaining_capacity_.value();
+  status.full_capacity = this->full_capacity_.value();
+  status.state_of_charge =
+      this->soc_capacity_.count > 0 && this->soc_capacity_.total > 0.0 ? this->charge_weighted_.total / this->soc_capacity_.total : NAN;
+
+  const PackEntry *min_cell = this->min_cell_pack_ != NO_PACK ? &this->packs_[this->min_cell_pack_] : nullptr;
+  status.min_cell_voltage = min_cell != nullptr ? min_cell->min_cell_voltage : NAN;
+  status.min_voltage_pack = min_cell != nullptr ? this->min_cell_pack_ + 1 : 0;
+  status.min_voltage_cell = min_cell != nullptr ? min_cell->min_voltage_cell : 0;
+
+  const PackEntry *max_cell = this->max_cell_pack_ != NO_PACK ? &this->packs_[this->max_cell_pack_] : nullptr;
+  status.max_cell_voltage = max_cell != nullptr ? max_cell->max_cell_voltage : NAN;
+  status.max_voltage_pack = max_cell != nullptr ? this->max_cell_pack_ + 1 : 0;
+  status.max_voltage_cell = max_cell != nullptr ? max_cell->max_voltage_cell : 0;
+
+  const bool has_temperature = this->max_temperature_pack_ != NO_PACK;
+  status.max_temperature = has_temperature ? this->packs_[this->max_temperature_pack_].max_temperature : NAN;
+  status.max_temperature_pack = has_temperature ? this->max_temperature_pack_ + 1 : 0;
+
+  // Parallel packs share the current about equally, so the weakest pack sets the limit for all of them
+  status.charge_current_limit =
+      this->min_charge_limit_pack_ != NO_PACK
+          ? this->packs_[this->min_charge_limit_pack_].charge_current_limit * this->charge_limit_packs_
+          : NAN;
+  status.discharge_current_limit =
+      this->min_discharge_limit_pack_ != NO_PACK
+          ? this->packs_[this->min_discharge_limit_pack_].discharge_current_limit * this->discharge_limit_packs_
+          : NAN;
+}
+
+void EcoworthyBank::update() {
+  // Drop packs that stopped answering; this is the only place that walks all packs unconditionally
+  const uint32_t now = millis();
+  for (uint8_t pack = 0; pack < this->packs_.size(); pack++) {
+    PackEntry &entry = this->packs_[pack];
+    if (!entry.online || now - entry.timestamp < this->pack_timeout_) {
+      continue;
+    }
+    ESP_LOGW(TAG, "Pack %u timed out, removing it from the bank totals", pack + 1);
+    const PackEntry previous = entry;
+    entry.online = false;
+    this->online_packs_--;
+    this->remove_entry_(previous);
+    this->update_extremes_(pack, previous);
+  }
+  this->update_status_();
+
+  const BankStatus &status = this->status_;
+  this->publish_state_(BANK_CURRENT, status.current);
+  this->publish_state_(BANK_POWER, status.power);
+  this->publish_state_(BANK_STATE_OF_CHARGE, status.state_of_charge);
+  this->publish_state_(BANK_REMAINING_CAPACITY, status.remaining_capacity);
+  this->publish_state_(BANK_FULL_CAPACITY, status.full_capacity);
+  this->publish_state_(BANK_MIN_CELL_VOLTAGE, status.min_cell_voltage);
+  this->publish_state_(BANK_MIN_VOLTAGE_PACK, status.min_voltage_pack != 0 ? status.min_voltage_pack : NAN);
+  this->publish_state_(BANK_MIN_VOLTAGE_CELL, status.min_voltage_pack != 0 ? status.min_voltage_cell : NAN);
+  this->publish_state_(BANK_MAX_CELL_VOLTAGE, status.max_cell_voltage);
+  this->publish_state_(BANK_MAX_VOLTAGE_PACK, status.max_voltage_pack != 0 ? status.max_voltage_pack : NAN);
+  this->publish_state_(BANK_MAX_VOLTAGE_CELL, status.max_voltage_pack != 0 ? status.max_voltage_cell : NAN);
+  this->publish_state_(BANK_DELTA_CELL_VOLTAGE, status.max_cell_voltage - status.min_cell_voltage);
+  this->publish_state_(BANK_MAX_TEMPERATURE, status.max_temperature);
+  this->publish_state_(BANK_MAX_TEMPERATURE_PACK,
+                       status.max_temperature_pack != 0 ? status.max_temperature_pack : NAN);
+  this->publish_state_(BANK_CHARGE_CURRENT_LIMIT, status.charge_current_limit);
+  this->publish_state_(BANK_DISCHARGE_CURRENT_LIMIT, status.discharge_current_limit);
+  this->publish_state_(BANK_ONLINE_PACKS, status.online_packs);
+}
+
+void EcoworthyBank::publish_state_(BankSensor slot, float value) {
+  if (this->sensors_[slot] != nullptr) {
+    this->sensors_[slot]->publish_state(value);
+  }
+}
+
+}  // namespace ecoworthy_bank
+}  // namespace esphome
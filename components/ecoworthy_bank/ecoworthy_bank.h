@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/ecoworthy_bms/ecoworthy_bms.h"
+
+namespace esphome {
+namespace ecoworthy_bank {
+
+enum BankSensor : uint8_t {
+  BANK_CURRENT,
+  BANK_POWER,
+  BANK_STATE_OF_CHARGE,
+  BANK_REMAINING_CAPACITY,
+  BANK_FULL_CAPACITY,
+  BANK_MIN_CELL_VOLTAGE,
+  BANK_MIN_VOLTAGE_PACK,
+  BANK_MIN_VOLTAGE_CELL,
+  BANK_MAX_CELL_VOLTAGE,
+  BANK_MAX_VOLTAGE_PACK,
+  BANK_MAX_VOLTAGE_CELL,
+  BANK_DELTA_CELL_VOLTAGE,
+  BANK_MAX_TEMPERATURE,
+  BANK_MAX_TEMPERATURE_PACK,
+  BANK_CHARGE_CURRENT_LIMIT,
+  BANK_DISCHARGE_CURRENT_LIMIT,
+  BANK_ONLINE_PACKS,
+  BANK_SENSOR_COUNT,
+};
+
+// Bank-wide values. Packs are numbered from 1 across all EcoworthyBms instances, in the order they
+// were added; values are NaN (and pack numbers 0) while no online pack reports them.
+struct BankStatus {
+  uint8_t online_packs{0};
+  float current{NAN};             // A, sum over packs
+  float power{NAN};               // W, sum over packs
+  float remaining_capacity{NAN};  // Ah, sum over packs
+  float full_capacity{NAN};       // Ah, sum over packs
+  float state_of_charge{NAN};     // %, weighted by full capacity
+  float min_cell_voltage{NAN};
+  uint8_t min_voltage_pack{0};
+  uint8_t min_voltage_cell{0};
+  float max_cell_voltage{NAN};
+  uint8_t max_voltage_pack{0};
+  uint8_t max_voltage_cell{0};
+  float max_temperature{NAN};
+  uint8_t max_temperature_pack{0};
+  float charge_current_limit{NAN};  // Lowest pack limit times the number of packs reporting one
+  float discharge_current_limit{NAN};
+};
+
+// Aggregates the pack status of one or more EcoworthyBms instances, which may sit on different buses.
+// Each pack response replaces that pack's contribution to the running sums; the extremes only need
+// a scan over the packs when the pack holding one of them moves away from it or goes offline.
+class EcoworthyBank : public PollingComponent {
+ public:
+  void add_bms(ecoworthy_bms::EcoworthyBms *bms) { this->bms_.push_back(bms); }
+  // Packs without a response for this long no longer count
+  void set_pack_timeout(uint32_t pack_timeout) { this->pack_timeout_ = pack_timeout; }
+  void set_sensor(BankSensor slot, sensor::Sensor *s) { this->sensors_[slot] = s; }
+
+  const BankStatus &get_status() const { return this->status_; }
+
+  void setup() override;
+  void update() override;
+  void dump_config() override;
+  float get_setup_priority() const override;
+
+ protected:
+  // What one pack contributes, NaN where the pack did not report the value
+  struct PackEntry {
+    bool online{false};
+    uint32_t timestamp{0};
+    float current{NAN};
+    float power{NAN};
+    float remaining_capacity{NAN};
+    float full_capacity{NAN};
+    float state_of_charge{NAN};
+    float min_cell_voltage{NAN};
+    uint8_t min_voltage_cell{0};
+    float max_cell_voltage{NAN};
+    uint8_t max_voltage_cell{0};
+    float max_temperature{NAN};
+    float charge_current_limit{NAN};
+    float discharge_current_limit{NAN};
+  };
+
+  // Running sums over the online packs; double so that replacing contributions does not drift
+  struct Sum {
+    double total{0.0};
+    uint8_t count{0};
+
+    void add(float value) {
+      if (!std::isnan(value)) {
+        this->total += value;
+        this->count++;
+      }
+    }
+    void remove(float value) {
+      if (!std::isnan(value)) {
+        this->total -= value;
+        this->count--;
+      }
+    }
+    float value() const { return this->count > 0 ? this->total : NAN; }
+  };
+
+  // Pack currently holding an extreme, NO_PACK if none
+  static const uint8_t NO_PACK = 0xFF;
+  using PackValue = float PackEntry::*;
+
+  void on_pack_status_(uint8_t pack, const ecoworthy_bms::PackStatus &status);
+  void add_entry_(const PackEntry &entry);
+  void remove_entry_(const PackEntry &entry);
+  void update_extremes_(uint8_t pack, const PackEntry &previous);
+  void update_extreme_(uint8_t &holder, PackValue value, bool lowest, uint8_t pack, const PackEntry &previous);
+  uint8_t find_extreme_(PackValue value, bool lowest) const;
+  void update_status_();
+  void publish_state_(BankSensor slot, float value);
+
+  std::vector<ecoworthy_bms::EcoworthyBms *> bms_;
+  std::vector<PackEntry> packs_;
+  uint32_t pack_timeout_{60000};
+  sensor::Sensor *sensors_[BANK_SENSOR_COUNT]{};
+
+  uint8_t online_packs_{0};
+  Sum current_;
+  Sum power_;
+  Sum remaining_capacity_;
+  Sum full_capacity_;
+  Sum charge_weighted_;  // state_of_charge * full_capacity
+  Sum soc_capacity_;     // full_capacity of the packs that also report state_of_charge
+  uint8_t min_cell_pack_{NO_PACK};
+  uint8_t max_cell_pack_{NO_PACK};
+  uint8_t max_temperature_pack_{NO_PACK};
+  uint8_t min_charge_limit_pack_{NO_PACK};
+  uint8_t min_discharge_limit_pack_{NO_PACK};
+  uint8_t charge_limit_packs_{0};
+  uint8_t discharge_limit_packs_{0};
+  BankStatus status_;
+};
+
+}  // namespace ecoworthy_bank
+}  // namespace esphome
@@ -0,0 +1,137 @@
+import esphome.codegen as cg
+from esphome.components import sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_CURRENT,
+    CONF_POWER,
+    DEVICE_CLASS_CURRENT,
+    DEVICE_CLASS_POWER,
+    DEVICE_CLASS_TEMPERATURE,
+    DEVICE_CLASS_VOLTAGE,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_AMPERE,
+    UNIT_CELSIUS,
+    UNIT_PERCENT,
+    UNIT_VOLT,
+    UNIT_WATT,
+)
+
+from . import CONF_ECOWORTHY_BANK_ID, ECOWORTHY_BANK_COMPONENT_SCHEMA, ecoworthy_bank_ns
+
+DEPENDENCIES = ["ecoworthy_bank"]
+
+CONF_STATE_OF_CHARGE = "state_of_charge"
+CONF_REMAINING_CAPACITY = "remaining_capacity"
+CONF_FULL_CAPACITY = "full_capacity"
+CONF_MIN_CELL_VOLTAGE = "min_cell_voltage"
+CONF_MIN_VOLTAGE_PACK = "min_voltage_pack"
+CONF_MIN_VOLTAGE_CELL = "min_voltage_cell"
+CONF_MAX_CELL_VOLTAGE = "max_cell_voltage"
+CONF_MAX_VOLTAGE_PACK = "max_voltage_pack"
+CONF_MAX_VOLTAGE_CELL = "max_voltage_cell"
+CONF_DELTA_CELL_VOLTAGE = "delta_cell_voltage"
+CONF_MAX_TEMPERATURE = "max_temperature"
+CONF_MAX_TEMPERATURE_PACK = "max_temperature_pack"
+CONF_CHARGE_CURRENT_LIMIT = "charge_current_limit"
+CONF_DISCHARGE_CURRENT_LIMIT = "discharge_current_limit"
+CONF_ONLINE_PACKS = "online_packs"
+
+UNIT_AMPERE_HOURS = "Ah"
+
+BankSensor = ecoworthy_bank_ns.enum("BankSensor")
+
+CELL_VOLTAGE_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_VOLT,
+    accuracy_decimals=3,
+    device_class=DEVICE_CLASS_VOLTAGE,
+    state_class=STATE_CLASS_MEASUREMENT,
+)
+CAPACITY_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_AMPERE_HOURS,
+    accuracy_decimals=2,
+    state_class=STATE_CLASS_MEASUREMENT,
+    icon="mdi:battery-50",
+)
+CURRENT_LIMIT_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_AMPERE,
+    accuracy_decimals=1,
+    device_class=DEVICE_CLASS_CURRENT,
+    state_class=STATE_CLASS_MEASUREMENT,
+    icon="mdi:current-dc",
+)
+INDEX_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=0,
+    icon="mdi:numeric",
+)
+
+# Config key -> (BankSensor slot, schema)
+BANK_SENSORS = {
+    CONF_CURRENT: (
+        BankSensor.BANK_CURRENT,
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_AMPERE,
+            accuracy_decimals=2,
+            device_class=DEVICE_CLASS_CURRENT,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+    ),
+    CONF_POWER: (
+        BankSensor.BANK_POWER,
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_WATT,
+            accuracy_decimals=1,
+            device_class=DEVICE_CLASS_POWER,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+    ),
+    CONF_STATE_OF_CHARGE: (
+        BankSensor.BANK_STATE_OF_CHARGE,
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            icon="mdi:battery-50",
+        ),
+    ),
+    CONF_REMAINING_CAPACITY: (BankSensor.BANK_REMAINING_CAPACITY, CAPACITY_SCHEMA),
+    CONF_FULL_CAPACITY: (BankSensor.BANK_FULL_CAPACITY, CAPACITY_SCHEMA),
+    CONF_MIN_CELL_VOLTAGE: (BankSensor.BANK_MIN_CELL_VOLTAGE, CELL_VOLTAGE_SCHEMA),
+    CONF_MIN_VOLTAGE_PACK: (BankSensor.BANK_MIN_VOLTAGE_PACK, INDEX_SCHEMA),
+    CONF_MIN_VOLTAGE_CELL: (BankSensor.BANK_MIN_VOLTAGE_CELL, INDEX_SCHEMA),
+    CONF_MAX_CELL_VOLTAGE: (BankSensor.BANK_MAX_CELL_VOLTAGE, CELL_VOLTAGE_SCHEMA),
+    CONF_MAX_VOLTAGE_PACK: (BankSensor.BANK_MAX_VOLTAGE_PACK, INDEX_SCHEMA),
+    CONF_MAX_VOLTAGE_CELL: (BankSensor.BANK_MAX_VOLTAGE_CELL, INDEX_SCHEMA),
+    CONF_DELTA_CELL_VOLTAGE: (BankSensor.BANK_DELTA_CELL_VOLTAGE, CELL_VOLTAGE_SCHEMA),
+    CONF_MAX_TEMPERATURE: (
+        BankSensor.BANK_MAX_TEMPERATURE,
+        sensor.sensor_schema(
+            unit_of_measurement=UNIT_CELSIUS,
+            accuracy_decimals=1,
+            device_class=DEVICE_CLASS_TEMPERATURE,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+    ),
+    CONF_MAX_TEMPERATURE_PACK: (BankSensor.BANK_MAX_TEMPERATURE_PACK, INDEX_SCHEMA),
+    CONF_CHARGE_CURRENT_LIMIT: (BankSensor.BANK_CHARGE_CURRENT_LIMIT, CURRENT_LIMIT_SCHEMA),
+    CONF_DISCHARGE_CURRENT_LIMIT: (BankSensor.BANK_DISCHARGE_CURRENT_LIMIT, CURRENT_LIMIT_SCHEMA),
+    CONF_ONLINE_PACKS: (
+        BankSensor.BANK_ONLINE_PACKS,
+        sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            icon="mdi:battery-check",
+        ),
+    ),
+}
+
+CONFIG_SCHEMA = ECOWORTHY_BANK_COMPONENT_SCHEMA.extend(
+    {cv.Optional(key): schema for key, (_, schema) in BANK_SENSORS.items()}
+)
+
+
+async def to_code(config):
+    hub = await cg.get_variable(config[CONF_ECOWORTHY_BANK_ID])
+    for key, (slot, _) in BANK_SENSORS.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(hub.set_sensor(slot, sens))
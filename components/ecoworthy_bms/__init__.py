@@ -1,7 +1,7 @@
 import esphome.codegen as cg
 from esphome.components import ecoworthy_modbus
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+from esphome.const import CONF_ID, CONF_UPDATE_INTERVAL
 
 AUTO_LOAD = ["ecoworthy_modbus", "binary_sensor", "sensor", "text_sensor", "switch", "button"]
 CODEOWNERS = ["@rar"]
@@ -9,12 +9,62 @@ MULTI_CONF = True
 
 CONF_ECOWORTHY_BMS_ID = "ecoworthy_bms_id"
 CONF_BATTERY_COUNT = "battery_count"
+CONF_READ_FULL_BLOCKS = "read_full_blocks"
+CONF_POLL_MODE = "poll_mode"
+CONF_REFRESH_INTERVALS = "refresh_intervals"
+CONF_PACK_STATUS = "pack_status"
+CONF_FAST_PACK_STATUS = "fast_pack_status"
+CONF_PUBLISH_CHANGES_ONLY = "publish_changes_only"
+CONF_HEARTBEAT_INTERVAL = "heartbeat_interval"
+CONF_DEADBANDS = "deadbands"
+CONF_HISTORY_SIZE = "history_size"
+
+# Config blocks in the order of EcoworthyBms::set_config_block_interval(), with default intervals
+CONFIG_BLOCK_INTERVALS = {
+    "config_1c00": "60s",
+    "config_2000": "120s",
+    "product_info": "720s",
+    "protection_params": "360s",
+    "individual_status": "30s",
+}
 
 DEFAULT_ADDRESS = 0x01
 DEFAULT_BATTERY_COUNT = 1
 
 ecoworthy_bms_ns = cg.esphome_ns.namespace("ecoworthy_bms")
 EcoworthyBms = ecoworthy_bms_ns.class_("EcoworthyBms", cg.PollingComponent, ecoworthy_modbus.EcoworthyModbusDevice)
+PollMode = ecoworthy_bms_ns.enum("PollMode")
+PackField = ecoworthy_bms_ns.enum("PackField")
+BatterySensorSlot = ecoworthy_bms_ns.enum("BatterySensorSlot")
+
+POLL_MODES = {
+    "interval": PollMode.POLL_MODE_INTERVAL,
+    "continuous": PollMode.POLL_MODE_CONTINUOUS,
+}
+
+# Pack status sensors each deadbands key applies to, as (first slot, count) runs of EcoworthyBms::set_deadband()
+DEADBAND_SLOTS = {
+    "total_voltage": [(PackField.PACK_TOTAL_VOLTAGE, 1)],
+    "current": [(PackField.PACK_CURRENT, 1)],
+    # Power, charging power and discharging power
+    "power": [(BatterySensorSlot.BATTERY_POWER, 3)],
+    "state_of_charge": [(PackField.PACK_STATE_OF_CHARGE, 1)],
+    "remaining_capacity": [(PackField.PACK_REMAINING_CAPACITY, 1)],
+    # Cells 1-16 and the max, min, average and delta cell voltage
+    "cell_voltage": [
+        (BatterySensorSlot.BATTERY_CELL_VOLTAGES, 16),
+        (PackField.PACK_MAX_CELL_VOLTAGE, 1),
+        (PackField.PACK_MIN_CELL_VOLTAGE, 1),
+        (PackField.PACK_AVERAGE_CELL_VOLTAGE, 1),
+        (BatterySensorSlot.BATTERY_DELTA_CELL_VOLTAGE, 1),
+    ],
+    # Temperature sensors 1-4, power tube, ambient and the max, min and average temperature
+    "temperature": [
+        (BatterySensorSlot.BATTERY_TEMPERATURE_SENSORS, 4),
+        (PackField.PACK_POWER_TUBE_TEMPERATURE, 2),
+        (PackField.PACK_MAX_TEMPERATURE, 3),
+    ],
+}
 
 ECOWORTHY_BMS_COMPONENT_SCHEMA = cv.Schema(
     {
@@ -22,15 +72,76 @@ ECOWORTHY_BMS_COMPONENT_SCHEMA = cv.Schema(
     }
 )
 
-CONFIG_SCHEMA = (
+
+# Upper bound for the history of all batteries together; more does not fit even with PSRAM
+MAX_TOTAL_HISTORY_SIZE = 4 * 1024 * 1024
+
+
+def validate_history_size(config):
+    total = config[CONF_HISTORY_SIZE] * config[CONF_BATTERY_COUNT]
+    if total > MAX_TOTAL_HISTORY_SIZE:
+        raise cv.Invalid(
+            f"{CONF_HISTORY_SIZE} of {config[CONF_HISTORY_SIZE]} bytes for {config[CONF_BATTERY_COUNT]} batteries "
+            f"needs {total} bytes, more than {MAX_TOTAL_HISTORY_SIZE}"
+        )
+    return config
+
+
+def validate_deadbands(config):
+    if config[CONF_DEADBANDS] and not config[CONF_PUBLISH_CHANGES_ONLY]:
+        raise cv.Invalid(f"{CONF_DEADBANDS} needs {CONF_PUBLISH_CHANGES_ONLY}: true")
+    return config
+
+
+def validate_fast_pack_status(config):
+    # In interval mode only one request goes out per update_interval, which would starve the fast reads
+    if CONF_FAST_PACK_STATUS in config[CONF_REFRESH_INTERVALS] and config[CONF_POLL_MODE] != "continuous":
+        raise cv.Invalid(f"{CONF_FAST_PACK_STATUS} needs {CONF_POLL_MODE}: continuous")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(EcoworthyBms),
             cv.Optional(CONF_BATTERY_COUNT, default=DEFAULT_BATTERY_COUNT): cv.int_range(min=1, max=16),
+            # Request whole register blocks even when configured sensors only need part of them
+            cv.Optional(CONF_READ_FULL_BLOCKS, default=False): cv.boolean,
+            # continuous: send the next request as soon as the bus is idle; update_interval then
+            # only paces the online/offline checks
+            cv.Optional(CONF_POLL_MODE, default="interval"): cv.enum(POLL_MODES, lower=True),
+            # Target age of each block's data; pack status defaults to update_interval
+            cv.Optional(CONF_REFRESH_INTERVALS, default={}): cv.Schema(
+                {
+                    cv.Optional(CONF_PACK_STATUS): cv.positive_time_period_milliseconds,
+                    # Short reads of total voltage, current and SOC only, in between the pack status reads
+                    cv.Optional(CONF_FAST_PACK_STATUS): cv.positive_time_period_milliseconds,
+                    **{
+                        cv.Optional(key, default=default): cv.positive_time_period_milliseconds
+                        for key, default in CONFIG_BLOCK_INTERVALS.items()
+                    },
+                }
+            ),
+            # Skip values that did not change at the sensor's accuracy_decimals; everything is
+            # republished once per heartbeat_interval
+            cv.Optional(CONF_PUBLISH_CHANGES_ONLY, default=False): cv.boolean,
+            cv.Optional(CONF_HEARTBEAT_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+            # Publish these sensors only when they moved more than this from the last published value,
+            # instead of comparing at accuracy_decimals; in the sensors' units, for every battery
+            cv.Optional(CONF_DEADBANDS, default={}): cv.Schema(
+                {cv.Optional(key): cv.positive_float for key in DEADBAND_SLOTS}
+            ),
+            # Bytes of compressed pack status history kept per battery, in 256 byte blocks; 0 disables it
+            cv.Optional(CONF_HISTORY_SIZE, default=0): cv.Any(
+                cv.one_of(0, int=True), cv.int_range(min=512, max=1048576)
+            ),
         }
     )
     .extend(cv.polling_component_schema("10s"))
-    .extend(ecoworthy_modbus.ecoworthy_modbus_device_schema(DEFAULT_ADDRESS))
+    .extend(ecoworthy_modbus.ecoworthy_modbus_device_schema(DEFAULT_ADDRESS)),
+    validate_history_size,
+    validate_fast_pack_status,
+    validate_deadbands,
 )
 
 
@@ -39,3 +150,18 @@ async def to_code(config):
     await cg.register_component(var, config)
     await ecoworthy_modbus.register_ecoworthy_modbus_device(var, config)
     cg.add(var.set_battery_count(config[CONF_BATTERY_COUNT]))
+    cg.add(var.set_read_full_blocks(config[CONF_READ_FULL_BLOCKS]))
+    cg.add(var.set_poll_mode(config[CONF_POLL_MODE]))
+    cg.add(var.set_publish_changes_only(config[CONF_PUBLISH_CHANGES_ONLY]))
+    cg.add(var.set_heartbeat_interval(config[CONF_HEARTBEAT_INTERVAL]))
+    for key, deadband in config[CONF_DEADBANDS].items():
+        for first, count in DEADBAND_SLOTS[key]:
+            cg.add(var.set_deadband(first, count, deadband))
+    cg.add(var.set_history_size(config[CONF_HISTORY_SIZE]))
+
+    intervals = config[CONF_REFRESH_INTERVALS]
+    cg.add(var.set_pack_status_interval(intervals.get(CONF_PACK_STATUS, config[CONF_UPDATE_INTERVAL])))
+    if CONF_FAST_PACK_STATUS in intervals:
+        cg.add(var.set_fast_pack_status_interval(intervals[CONF_FAST_PACK_STATUS]))
+    for block, key in enumerate(CONFIG_BLOCK_INTERVALS):
+        cg.add(var.set_config_block_interval(block, intervals[key]))
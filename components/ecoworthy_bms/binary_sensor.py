@@ -3,7 +3,7 @@ from esphome.components import binary_sensor
 import esphome.config_validation as cv
 from esphome.const import CONF_ID
 
-from . import ECOWORTHY_BMS_COMPONENT_SCHEMA, CONF_ECOWORTHY_BMS_ID
+from . import ECOWORTHY_BMS_COMPONENT_SCHEMA, CONF_ECOWORTHY_BMS_ID, ecoworthy_bms_ns
 
 DEPENDENCIES = ["ecoworthy_bms"]
 
@@ -16,6 +16,18 @@ CONF_DISCHARGING_SWITCH = "discharging_switch"
 CONF_BALANCING = "balancing"
 CONF_BATTERIES = "batteries"
 
+BatteryBinarySensor = ecoworthy_bms_ns.enum("BatteryBinarySensor")
+
+# Slot of each secondary battery binary sensor
+BATTERY_BINARY_SENSOR_SLOTS = {
+    CONF_ONLINE_STATUS: BatteryBinarySensor.BATTERY_ONLINE_STATUS,
+    CONF_CHARGING: BatteryBinarySensor.BATTERY_CHARGING,
+    CONF_DISCHARGING: BatteryBinarySensor.BATTERY_DISCHARGING,
+    CONF_CHARGING_SWITCH: BatteryBinarySensor.BATTERY_CHARGING_SWITCH,
+    CONF_DISCHARGING_SWITCH: BatteryBinarySensor.BATTERY_DISCHARGING_SWITCH,
+    CONF_BALANCING: BatteryBinarySensor.BATTERY_BALANCING,
+}
+
 # Schema for per-battery binary sensors (secondary batteries - all binary sensors from Pack Status)
 BATTERY_BINARY_SENSOR_SCHEMA = cv.Schema(
     {
@@ -101,21 +113,7 @@ async def to_code(config):
             # YAML key is 1-based (secondary_battery_number: 2,3,...) but C++ battery_index
             # from address offset is 0-based (primary=0, secondary1=1, secondary2=2,...)
             cpp_index = battery_index - 1
-            if CONF_ONLINE_STATUS in battery_config:
-                sens = await binary_sensor.new_binary_sensor(battery_config[CONF_ONLINE_STATUS])
-                cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, "online_status", sens))
-            if CONF_CHARGING in battery_config:
-                sens = await binary_sensor.new_binary_sensor(battery_config[CONF_CHARGING])
-                cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, "charging", sens))
-            if CONF_DISCHARGING in battery_config:
-                sens = await binary_sensor.new_binary_sensor(battery_config[CONF_DISCHARGING])
-                cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, "discharging", sens))
-            if CONF_CHARGING_SWITCH in battery_config:
-                sens = await binary_sensor.new_binary_sensor(battery_config[CONF_CHARGING_SWITCH])
-                cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, "charging_switch", sens))
-            if CONF_DISCHARGING_SWITCH in battery_config:
-                sens = await binary_sensor.new_binary_sensor(battery_config[CONF_DISCHARGING_SWITCH])
-                cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, "discharging_switch", sens))
-            if CONF_BALANCING in battery_config:
-                sens = await binary_sensor.new_binary_sensor(battery_config[CONF_BALANCING])
-                cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, "balancing", sens))
+            for key, slot in BATTERY_BINARY_SENSOR_SLOTS.items():
+                if key in battery_config:
+                    sens = await binary_sensor.new_binary_sensor(battery_config[key])
+                    cg.add(hub.set_secondary_battery_binary_sensor(cpp_index, slot, sens))
@@ -4,6 +4,7 @@ from esphome.components import button
 from esphome.const import (
     CONF_ID,
     ENTITY_CATEGORY_CONFIG,
+    ENTITY_CATEGORY_DIAGNOSTIC,
     ICON_POWER,
 )
 
@@ -16,10 +17,12 @@ DEPENDENCIES = ["ecoworthy_bms"]
 StandbySleepButton = ecoworthy_bms_ns.class_("StandbySleepButton", button.Button, cg.Component)
 DeepSleepButton = ecoworthy_bms_ns.class_("DeepSleepButton", button.Button, cg.Component)
 TripButton = ecoworthy_bms_ns.class_("TripButton", button.Button, cg.Component)
+DumpHistoryButton = ecoworthy_bms_ns.class_("DumpHistoryButton", button.Button, cg.Component)
 
 CONF_STANDBY_SLEEP = "standby_sleep"
 CONF_DEEP_SLEEP = "deep_sleep"
 CONF_TRIP = "trip"
+CONF_DUMP_HISTORY = "dump_history"
 
 CONFIG_SCHEMA = cv.Schema(
     {
@@ -39,6 +42,11 @@ CONFIG_SCHEMA = cv.Schema(
             entity_category=ENTITY_CATEGORY_CONFIG,
             icon="mdi:alert-octagon",
         ),
+        cv.Optional(CONF_DUMP_HISTORY): button.button_schema(
+            DumpHistoryButton,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            icon="mdi:history",
+        ),
     }
 )
 
@@ -63,3 +71,9 @@ async def to_code(config):
         await cg.register_component(b, config[CONF_TRIP])
         cg.add(b.set_parent(hub))
         cg.add(hub.set_trip_button(b))
+
+    if CONF_DUMP_HISTORY in config:
+        b = await button.new_button(config[CONF_DUMP_HISTORY])
+        await cg.register_component(b, config[CONF_DUMP_HISTORY])
+        cg.add(b.set_parent(hub))
+        cg.add(hub.set_dump_history_button(b))
@@ -16,6 +16,7 @@ static const uint8_t MAX_NO_RESPONSE_COUNT = 5;
 // Individual Pack Status: 0x0000 - 0x0054 (function 0x45, non-aggregated CCL/DCL)
 static const uint16_t REG_INDIVIDUAL_STATUS_START = 0x0000;
 static const uint16_t REG_INDIVIDUAL_STATUS_END = 0x0054;
+static const uint16_t INDIVIDUAL_STATUS_DATA_LEN = 100;  // Response size; the range is not a byte count
 // Pack Status: 0x1000 - 0x10A0
 static const uint16_t REG_PACK_STATUS_START = 0x1000;
 static const uint16_t REG_PACK_STATUS_END = 0x10A0;
@@ -36,6 +37,275 @@ static const uint16_t REG_PRODUCT_INFO_END = 0x283C;
 static const uint16_t REG_PROTECTION_PARAMS_START = 0x1800;
 static const uint16_t REG_PROTECTION_PARAMS_END = 0x1900;
 
+static_assert(REG_PACK_STATUS_END - REG_PACK_STATUS_START <= 512, "Block exceeds the 512 byte frame limit");
+static_assert(REG_CONFIG_1C00_END - REG_CONFIG_1C00_START <= 512, "Block exceeds the 512 byte frame limit");
+static_assert(REG_CONFIG_2000_END - REG_CONFIG_2000_START <= 512, "Block exceeds the 512 byte frame limit");
+static_assert(REG_PRODUCT_INFO_END - REG_PRODUCT_INFO_START <= 512, "Block exceeds the 512 byte frame limit");
+static_assert(REG_PROTECTION_PARAMS_END - REG_PROTECTION_PARAMS_START <= 512,
+              "Block exceeds the 512 byte frame limit");
+
+// Numeric register fields. Each value is published as (raw + bias) * scale by publish_fields_(), the
+// same loop for every block and every battery.
+enum FieldType : uint8_t {
+  FIELD_U16,
+  FIELD_S16,
+  FIELD_U32,
+  FIELD_S32,
+};
+
+struct RegisterField {
+  uint8_t slot;     // PackField or ParamField the value is published to
+  uint16_t offset;  // Byte offset into the block's data
+  FieldType type;
+  int32_t bias;     // Added to the raw value before scaling
+  float scale;
+};
+
+static constexpr uint16_t field_end(const RegisterField &field) {
+  return field.offset + (field.type == FIELD_U32 || field.type == FIELD_S32 ? 4 : 2);
+}
+
+// Every field must fit the block, and slots must follow table order so tables can be indexed by slot
+template<size_t N>
+static constexpr bool fields_valid(const RegisterField (&fields)[N], uint16_t block_length, uint8_t first_slot) {
+  for (size_t i = 0; i < N; i++) {
+    if (field_end(fields[i]) > block_length || fields[i].slot != first_slot + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Pack status layout: fixed fields up to the cell count at offset 66, then up to 16 cell voltages,
+// then a tail (temperatures, balancing, firmware, serial) whose position depends on the cell count
+static const uint16_t PACK_STATUS_CELLS_OFFSET = 68;
+static const uint16_t PACK_STATUS_TAIL_OFFSET = PACK_STATUS_CELLS_OFFSET + 16 * 2;
+static const uint16_t PACK_STATUS_OPERATION_STATUS_OFFSET = 20;  // 0 idle, 1 charging, 2 discharging
+
+static constexpr RegisterField PACK_STATUS_FIELDS[] = {
+    {PACK_TOTAL_VOLTAGE, 0, FIELD_U16, 0, 0.01f},
+    {PACK_CURRENT, 4, FIELD_S32, -300000, 0.01f},  // Offset by 3000 A so the raw value stays unsigned
+    {PACK_STATE_OF_CHARGE, 8, FIELD_U16, 0, 0.01f},
+    {PACK_REMAINING_CAPACITY, 10, FIELD_U16, 0, 0.01f},
+    {PACK_FULL_CAPACITY, 12, FIELD_U16, 0, 0.01f},
+    {PACK_RATED_CAPACITY, 14, FIELD_U16, 0, 0.01f},
+    {PACK_POWER_TUBE_TEMPERATURE, 16, FIELD_U16, -500, 0.1f},
+    {PACK_AMBIENT_TEMPERATURE, 18, FIELD_U16, -500, 0.1f},
+    {PACK_STATE_OF_HEALTH, 22, FIELD_U16, 0, 1.0f},
+    {PACK_FAULT_BITMASK, 24, FIELD_U32, 0, 1.0f},
+    {PACK_ALARM_BITMASK, 28, FIELD_U32, 0, 1.0f},
+    {PACK_MOSFET_STATUS_BITMASK, 32, FIELD_U16, 0, 1.0f},  // Bit 0 discharge, bit 1 charge
+    {PACK_CYCLE_COUNT, 36, FIELD_U16, 0, 1.0f},
+    {PACK_MAX_VOLTAGE_CELL, 38, FIELD_U16, 0, 1.0f},
+    {PACK_MAX_CELL_VOLTAGE, 40, FIELD_U16, 0, 0.001f},
+    {PACK_MIN_VOLTAGE_CELL, 42, FIELD_U16, 0, 1.0f},
+    {PACK_MIN_CELL_VOLTAGE, 44, FIELD_U16, 0, 0.001f},
+    {PACK_AVERAGE_CELL_VOLTAGE, 46, FIELD_U16, 0, 0.001f},
+    {PACK_MAX_TEMPERATURE, 50, FIELD_U16, -500, 0.1f},
+    {PACK_MIN_TEMPERATURE, 54, FIELD_U16, -500, 0.1f},
+    {PACK_AVG_TEMPERATURE, 56, FIELD_U16, -500, 0.1f},
+    {PACK_CHARGE_VOLTAGE_LIMIT, 58, FIELD_U16, 0, 0.1f},
+    {PACK_CHARGE_CURRENT_LIMIT, 60, FIELD_U16, 0, 0.1f},
+    {PACK_DISCHARGE_VOLTAGE_LIMIT, 62, FIELD_U16, 0, 0.1f},
+    {PACK_DISCHARGE_CURRENT_LIMIT, 64, FIELD_U16, 0, 0.1f},
+    {PACK_CELL_COUNT, 66, FIELD_U16, 0, 1.0f},
+};
+static_assert(sizeof(PACK_STATUS_FIELDS) / sizeof(RegisterField) == PACK_FIELD_COUNT, "Pack status field missing");
+static_assert(fields_valid(PACK_STATUS_FIELDS, PACK_STATUS_CELLS_OFFSET, 0), "Bad pack status field table");
+
+static const uint32_t DUMP_HISTORY_INTERVAL = 50;  // ms per logged history block, i.e. up to 8 lines
+
+// Fast pack status reads stop after the state of charge: total voltage, current and SOC
+static const uint16_t PACK_STATUS_FAST_LENGTH = field_end(PACK_STATUS_FIELDS[PACK_STATE_OF_CHARGE]);
+
+// Ecoworthy's 0x1C00 layout is shifted by 4 bytes compared to EG4. Text fields are decoded in
+// on_config_1c00_data_().
+static constexpr RegisterField CONFIG_1C00_FIELDS[] = {
+    {PARAM_BALANCE_VOLTAGE, 4, FIELD_U16, 0, 0.001f},
+    {PARAM_BALANCE_DIFFERENCE, 6, FIELD_U16, 0, 0.001f},
+    {PARAM_HEATER_START_TEMP, 8, FIELD_U16, -500, 0.1f},
+    {PARAM_HEATER_STOP_TEMP, 10, FIELD_U16, -500, 0.1f},
+    {PARAM_FULL_CHARGE_VOLTAGE, 12, FIELD_U16, 0, 0.01f},
+    {PARAM_FULL_CHARGE_CURRENT, 14, FIELD_U16, 0, 0.01f},
+    {PARAM_SLEEP_VOLTAGE, 64, FIELD_U16, 0, 0.01f},
+    {PARAM_SLEEP_DELAY, 66, FIELD_U16, 0, 1.0f},  // Minutes
+};
+static_assert(fields_valid(CONFIG_1C00_FIELDS, REG_CONFIG_1C00_END - REG_CONFIG_1C00_START, PARAM_BALANCE_VOLTAGE),
+              "Bad 0x1C00 field table");
+
+static constexpr RegisterField CONFIG_2000_FIELDS[] = {
+    {PARAM_TOTAL_CHARGE, 12, FIELD_U32, 0, 0.01f},
+    {PARAM_TOTAL_DISCHARGE, 16, FIELD_U32, 0, 0.01f},
+    {PARAM_CONFIGURED_CVL, 32, FIELD_U16, 0, 0.1f},
+    {PARAM_CONFIGURED_CCL, 34, FIELD_U16, 0, 0.1f},
+    {PARAM_CONFIGURED_DVL, 36, FIELD_U16, 0, 0.1f},
+    {PARAM_CONFIGURED_DCL, 38, FIELD_U16, 0, 0.1f},
+    {PARAM_SHUNT_RESISTANCE, 44, FIELD_U16, 0, 1.0f},  // μΩ
+};
+static_assert(fields_valid(CONFIG_2000_FIELDS, REG_CONFIG_2000_END - REG_CONFIG_2000_START, PARAM_TOTAL_CHARGE),
+              "Bad 0x2000 field table");
+
+// Cell thresholds in mV, pack thresholds in cV, currents in dA, temperatures as (raw - 500) / 10 °C.
+// Most delays are in ms and published in s; the recover delays are in s and OC2 delays in ms.
+static constexpr RegisterField PROTECTION_PARAMS_FIELDS[] = {
+    {PARAM_CELL_OVP_TRIGGER, 0, FIELD_U16, 0, 0.001f},
+    {PARAM_CELL_OVP_RELEASE, 2, FIELD_U16, 0, 0.001f},
+    {PARAM_CELL_UVP_TRIGGER, 12, FIELD_U16, 0, 0.001f},
+    {PARAM_CELL_UVP_RELEASE, 14, FIELD_U16, 0, 0.001f},
+    {PARAM_PACK_OVP_TRIGGER, 24, FIELD_U16, 0, 0.01f},
+    {PARAM_PACK_OVP_RELEASE, 26, FIELD_U16, 0, 0.01f},
+    {PARAM_PACK_UVP_TRIGGER, 36, FIELD_U16, 0, 0.01f},
+    {PARAM_PACK_UVP_RELEASE, 38, FIELD_U16, 0, 0.01f},
+    {PARAM_CHARGE_OC_ALARM, 48, FIELD_U16, 0, 0.1f},
+    {PARAM_CHARGE_OC_ALARM_DELAY, 52, FIELD_U16, 0, 0.001f},
+    {PARAM_CHARGE_OC_TRIGGER, 54, FIELD_U16, 0, 0.1f},
+    {PARAM_CHARGE_OC_DELAY, 56, FIELD_U16, 0, 0.001f},
+    {PARAM_CHARGE_OC_RECOVER_DELAY, 58, FIELD_U16, 0, 1.0f},
+    {PARAM_CHARGE_OC2_TRIGGER, 62, FIELD_U16, 0, 0.1f},
+    {PARAM_CHARGE_OC2_DELAY, 64, FIELD_U16, 0, 1.0f},
+    {PARAM_DISCHARGE_OC_ALARM, 68, FIELD_U16, 0, 0.1f},
+    {PARAM_DISCHARGE_OC_ALARM_DELAY, 72, FIELD_U16, 0, 0.001f},
+    {PARAM_DISCHARGE_OC_TRIGGER, 74, FIELD_U16, 0, 0.1f},
+    {PARAM_DISCHARGE_OC_DELAY, 76, FIELD_U16, 0, 0.001f},
+    {PARAM_DISCHARGE_OC_RECOVER_DELAY, 78, FIELD_U16, 0, 1.0f},
+    {PARAM_DISCHARGE_OC2_TRIGGER, 82, FIELD_U16, 0, 0.1f},
+    {PARAM_DISCHARGE_OC2_DELAY, 84, FIELD_U16, 0, 1.0f},
+    {PARAM_CHARGE_OT_TRIGGER, 94, FIELD_U16, -500, 0.1f},
+    {PARAM_CHARGE_OT_RELEASE, 96, FIELD_U16, -500, 0.1f},
+    {PARAM_CHARGE_OT_DELAY, 98, FIELD_U16, 0, 0.001f},
+    {PARAM_CHARGE_UT_TRIGGER, 106, FIELD_U16, -500, 0.1f},
+    {PARAM_CHARGE_UT_RELEASE, 108, FIELD_U16, -500, 0.1f},
+    {PARAM_CHARGE_UT_DELAY, 110, FIELD_U16, 0, 0.001f},
+    {PARAM_DISCHARGE_OT_TRIGGER, 118, FIELD_U16, -500, 0.1f},
+    {PARAM_DISCHARGE_OT_RELEASE, 120, FIELD_U16, -500, 0.1f},
+    {PARAM_DISCHARGE_OT_DELAY, 122, FIELD_U16, 0, 0.001f},
+    {PARAM_DISCHARGE_UT_TRIGGER, 130, FIELD_U16, -500, 0.1f},
+    {PARAM_DISCHARGE_UT_RELEASE, 132, FIELD_U16, -500, 0.1f},
+    {PARAM_DISCHARGE_UT_DELAY, 134, FIELD_U16, 0, 0.001f},
+};
+static_assert(fields_valid(PROTECTION_PARAMS_FIELDS, REG_PROTECTION_PARAMS_END - REG_PROTECTION_PARAMS_START,
+                           PARAM_CELL_OVP_TRIGGER),
+              "Bad 0x1800 field table");
+
+// Function 0x45 repeats the pack status in its first 96 bytes; only the non-aggregated limits are new
+static constexpr RegisterField INDIVIDUAL_STATUS_FIELDS[] = {
+    {PARAM_INDIVIDUAL_CHARGE_CURRENT_LIMIT, 96, FIELD_U16, 0, 0.1f},
+    {PARAM_INDIVIDUAL_DISCHARGE_CURRENT_LIMIT, 98, FIELD_U16, 0, 0.1f},
+};
+static_assert(fields_valid(INDIVIDUAL_STATUS_FIELDS, INDIVIDUAL_STATUS_DATA_LEN, PARAM_INDIVIDUAL_CHARGE_CURRENT_LIMIT),
+              "Bad 0x45 field table");
+static_assert(PARAM_INDIVIDUAL_DISCHARGE_CURRENT_LIMIT + 1 == PARAM_FIELD_COUNT, "Param field missing");
+
+static bool has_field(const ecoworthy_modbus::FrameView &frame, const RegisterField &field) {
+  return field_end(field) <= frame.data_length();
+}
+
+static float decode_field(const ecoworthy_modbus::FrameView &frame, const RegisterField &field) {
+  if (field.type == FIELD_U32) {
+    return float(int64_t(frame.get_u32(field.offset)) + field.bias) * field.scale;
+  }
+  if (field.type == FIELD_S32) {
+    return float(int32_t(frame.get_u32(field.offset)) + field.bias) * field.scale;
+  }
+  const uint16_t raw = frame.get_u16(field.offset);
+  return float((field.type == FIELD_S16 ? int32_t(int16_t(raw)) : int32_t(raw)) + field.bias) * field.scale;
+}
+
+// Names of the fault and alarm bits, bit 0 first
+static const char *const FAULT_NAMES[] = {
+    "Cell OV",       "Cell UV",           "Pack OV",           "Pack UV",
+    "Charge OC Slow", "Charge OC Fast",   "Discharge OC Slow", "Discharge OC Fast",
+    "Charge HT",     "Charge LT",         "Discharge HT",      "Discharge LT",
+    "MOS HT",        "Ambient HT",        "Ambient LT",        "Cell V Diff",
+    "Temp Diff",     "SOC Low",           "Short Circuit",     "Cell Offline",
+    "Temp Sensor Fail", "Charge MOS Fault", "Discharge MOS Fault", "AFE Comm Error",
+};
+static const uint8_t FAULT_NAME_COUNT = sizeof(FAULT_NAMES) / sizeof(FAULT_NAMES[0]);
+
+static const char *const ALARM_NAMES[] = {
+    "Cell OV",      "Cell UV",      "Pack OV",    "Pack UV",
+    "Charge OC",    "Discharge OC", "Charge HT",  "Charge LT",
+    "Discharge HT", "Discharge LT", "MOS HT",     "Ambient HT",
+    "Ambient LT",   "Cell V Diff",  "Temp Diff",  "SOC Low",
+    "EEP Fault",    "RTC Abnormal", "Full Charge Prot",
+};
+static const uint8_t ALARM_NAME_COUNT = sizeof(ALARM_NAMES) / sizeof(ALARM_NAMES[0]);
+
+// Holds every fault name joined with separators (298 characters)
+static const size_t TEXT_BUFFER_SIZE = 320;
+
+static const char *decode_operation_status(uint16_t status) {
+  switch (status) {
+    case 0: return "Idle";
+    case 1: return "Charging";
+    case 2: return "Discharging";
+    default: return "Unknown";
+  }
+}
+
+// Writes the names of the set bits into buffer as "Cell OV;Cell UV", without a trailing ';'; "None" if no bit
+// is set. Bits without a name are skipped, so the result can be empty.
+static const char *decode_bits(uint32_t bits, const char *const *names, uint8_t count, char *buffer, size_t size) {
+  if (bits == 0) {
+    return "None";
+  }
+  size_t length = 0;
+  buffer[0] = '\0';
+  for (uint8_t bit = 0; bit < count; bit++) {
+    if ((bits & (1UL << bit)) == 0) {
+      continue;
+    }
+    const int written = snprintf(buffer + length, size - length, "%s%s", length > 0 ? ";" : "", names[bit]);
+    if (written < 0 || size_t(written) >= size - length) {
+      break;
+    }
+    length += written;
+  }
+  return buffer;
+}
+
+const char *decode_fault_bits(uint32_t bits, char *buffer, size_t size) {
+  return decode_bits(bits, FAULT_NAMES, FAULT_NAME_COUNT, buffer, size);
+}
+
+const char *decode_alarm_bits(uint32_t bits, char *buffer, size_t size) {
+  return decode_bits(bits, ALARM_NAMES, ALARM_NAME_COUNT, buffer, size);
+}
+
+static uint32_t fnv1a_hash(const char *data, size_t length) {
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ uint8_t(data[i])) * 16777619UL;
+  }
+  return hash;
+}
+
+// Config blocks polled from the primary only, in poll slot order
+struct ConfigBlock {
+  const char *name;
+  uint8_t function;
+  uint16_t start;
+  uint16_t end;
+  const RegisterField *fields;
+  uint8_t field_count;
+};
+static const uint8_t CONFIG_BLOCK_COUNT = EcoworthyBms::CONFIG_BLOCK_SLOTS;
+static const ConfigBlock CONFIG_BLOCKS[CONFIG_BLOCK_COUNT] = {
+    {"0x1C00 config block", FUNCTION_READ, REG_CONFIG_1C00_START, REG_CONFIG_1C00_END, CONFIG_1C00_FIELDS,
+     sizeof(CONFIG_1C00_FIELDS) / sizeof(RegisterField)},
+    {"0x2000 config block", FUNCTION_READ, REG_CONFIG_2000_START, REG_CONFIG_2000_END, CONFIG_2000_FIELDS,
+     sizeof(CONFIG_2000_FIELDS) / sizeof(RegisterField)},
+    {"product info", FUNCTION_READ, REG_PRODUCT_INFO_START, REG_PRODUCT_INFO_END, nullptr, 0},
+    {"0x1800 protection params", FUNCTION_READ, REG_PROTECTION_PARAMS_START, REG_PROTECTION_PARAMS_END,
+     PROTECTION_PARAMS_FIELDS, sizeof(PROTECTION_PARAMS_FIELDS) / sizeof(RegisterField)},
+    {"individual pack status 0x45", FUNCTION_INDIVIDUAL_PACK_STATUS, REG_INDIVIDUAL_STATUS_START,
+     REG_INDIVIDUAL_STATUS_END, INDIVIDUAL_STATUS_FIELDS, sizeof(INDIVIDUAL_STATUS_FIELDS) / sizeof(RegisterField)},
+};
+
+static uint16_t block_data_length(const ConfigBlock &block) {
+  return block.function == FUNCTION_INDIVIDUAL_PACK_STATUS ? INDIVIDUAL_STATUS_DATA_LEN : block.end - block.start;
+}
+
 // Write addresses
 static const uint16_t REG_MOS_CONTROL = 0x2902;
 static const uint16_t REG_SLEEP_MODE = 0x2908;
@@ -44,18 +314,254 @@ static const uint16_t REG_DRY_CONTACT = 0x2904;  // Dry contact / trip control
 void EcoworthyBms::dump_config() {
   ESP_LOGCONFIG(TAG, "Ecoworthy BMS:");
   ESP_LOGCONFIG(TAG, "  Address: 0x%02X", this->address_);
+  ESP_LOGCONFIG(TAG, "  Poll mode: %s", this->poll_mode_ == POLL_MODE_CONTINUOUS ? "continuous" : "interval");
+  if (this->publish_changes_only_) {
+    ESP_LOGCONFIG(TAG, "  Publishing changes only, heartbeat every %u ms", this->heartbeat_interval_);
+  }
+  if (this->history_[0].is_enabled()) {
+    ESP_LOGCONFIG(TAG, "  History: %u blocks of %u bytes per battery", this->history_[0].block_count(),
+                  PackHistory::BLOCK_SIZE);
+  }
   LOG_BINARY_SENSOR("  ", "Online Status", this->online_status_binary_sensor_);
-  LOG_BINARY_SENSOR("  ", "Charging", this->charging_binary_sensor_);
-  LOG_BINARY_SENSOR("  ", "Discharging", this->discharging_binary_sensor_);
-  LOG_SENSOR("  ", "Total Voltage", this->total_voltage_sensor_);
-  LOG_SENSOR("  ", "Current", this->current_sensor_);
-  LOG_SENSOR("  ", "Power", this->power_sensor_);
-  LOG_SENSOR("  ", "State of Charge", this->state_of_charge_sensor_);
-  LOG_TEXT_SENSOR("  ", "Operation Status", this->operation_status_text_sensor_);
+  const BatterySensors &primary = this->batteries_[0];
+  LOG_BINARY_SENSOR("  ", "Charging", primary.binary_sensors[BATTERY_CHARGING]);
+  LOG_BINARY_SENSOR("  ", "Discharging", primary.binary_sensors[BATTERY_DISCHARGING]);
+  LOG_SENSOR("  ", "Total Voltage", primary.sensors[PACK_TOTAL_VOLTAGE]);
+  LOG_SENSOR("  ", "Current", primary.sensors[PACK_CURRENT]);
+  LOG_SENSOR("  ", "Power", primary.sensors[BATTERY_POWER]);
+  LOG_SENSOR("  ", "State of Charge", primary.sensors[PACK_STATE_OF_CHARGE]);
+  LOG_TEXT_SENSOR("  ", "Operation Status", primary.text_sensors[BATTERY_OPERATION_STATUS]);
+
+  ESP_LOGCONFIG(TAG, "  Read plan%s:", this->read_full_blocks_ ? " (full blocks)" : "");
+  uint32_t planned = 0;
+  uint32_t full = 0;
+  for (uint8_t i = 0; i < this->battery_count_; i++) {
+    ESP_LOGCONFIG(TAG, "    Battery %u pack status: %u of %u bytes, every %u ms", i + 1,
+                  this->pack_status_lengths_[i], REG_PACK_STATUS_END - REG_PACK_STATUS_START,
+                  this->poll_slots_[i].interval);
+    if (this->poll_slots_[FAST_SLOTS_START + i].frame_id != ecoworthy_modbus::EcoworthyModbus::INVALID_READ_FRAME) {
+      ESP_LOGCONFIG(TAG, "    Battery %u fast pack status: %u bytes, every %u ms", i + 1, PACK_STATUS_FAST_LENGTH,
+                    this->fast_pack_status_interval_);
+    }
+    planned += this->pack_status_lengths_[i];
+    full += REG_PACK_STATUS_END - REG_PACK_STATUS_START;
+  }
+  for (uint8_t step = 0; step < CONFIG_BLOCK_COUNT; step++) {
+    const ConfigBlock &block = CONFIG_BLOCKS[step];
+    const uint16_t block_bytes = block_data_length(block);
+    const uint16_t length = this->config_lengths_[step];
+    if (length == 0) {
+      ESP_LOGCONFIG(TAG, "    %s: skipped, no sensors configured", block.name);
+    } else {
+      ESP_LOGCONFIG(TAG, "    %s: %u of %u bytes, every %u ms", block.name, length, block_bytes,
+                    this->config_intervals_[step]);
+    }
+    planned += length;
+    full += block_bytes;
+  }
+  ESP_LOGCONFIG(TAG, "    Planned data bytes per pass over all blocks: %u (full blocks: %u)", planned, full);
 }
 
 float EcoworthyBms::get_setup_priority() const { return setup_priority::DATA; }
 
+// Data length a handler needs before it publishes a given entity. Read plans request the shortest
+// block prefix that covers every configured entity, and skip blocks nobody consumes.
+struct ReadNeed {
+  const void *entity;
+  uint16_t length;
+};
+
+static uint16_t plan_length(std::initializer_list<ReadNeed> needs) {
+  uint16_t length = 0;
+  for (const auto &need : needs) {
+    if (need.entity != nullptr) {
+      length = std::max(length, need.length);
+    }
+  }
+  return length;
+}
+
+// Data length that covers every field with a sensor
+static uint16_t plan_fields(const RegisterField *fields, size_t count, sensor::Sensor *const *sensors) {
+  uint16_t length = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (sensors[fields[i].slot] != nullptr) {
+      length = std::max(length, field_end(fields[i]));
+    }
+  }
+  return length;
+}
+
+static uint16_t cells_length(sensor::Sensor *const *cells) {
+  uint16_t length = 0;
+  for (uint8_t i = 0; i < 16; i++) {
+    if (cells[i] != nullptr) {
+      length = PACK_STATUS_CELLS_OFFSET + (i + 1) * 2;
+    }
+  }
+  return length;
+}
+
+uint16_t EcoworthyBms::plan_pack_status_length_(uint8_t battery_index) const {
+  // The history records the cell voltages and temperatures of every battery, and callbacks get the
+  // whole snapshot, whatever sensors are configured
+  if (this->history_size_ > 0 || this->full_pack_status_) {
+    return REG_PACK_STATUS_END - REG_PACK_STATUS_START;
+  }
+  const BatterySensors &bat = this->batteries_[battery_index];
+  bool tail = bat.binary_sensors[BATTERY_BALANCING] != nullptr ||
+              bat.text_sensors[BATTERY_FIRMWARE_VERSION] != nullptr ||
+              bat.text_sensors[BATTERY_SERIAL_NUMBER] != nullptr;
+  for (uint8_t slot = BATTERY_TEMPERATURE_SENSOR_COUNT; slot < BATTERY_SENSOR_COUNT; slot++) {
+    // The cell voltages sit in front of the tail and are planned separately
+    if (slot < BATTERY_CELL_VOLTAGES || slot >= BATTERY_TEMPERATURE_SENSORS) {
+      tail |= bat.sensors[slot] != nullptr;
+    }
+  }
+  if (tail) {
+    return REG_PACK_STATUS_END - REG_PACK_STATUS_START;
+  }
+
+  uint16_t length = std::max(cells_length(bat.sensors + BATTERY_CELL_VOLTAGES),
+                             plan_fields(PACK_STATUS_FIELDS, PACK_FIELD_COUNT, bat.sensors));
+  length = std::max(length, plan_length({
+      {bat.sensors[BATTERY_POWER], field_end(PACK_STATUS_FIELDS[PACK_CURRENT])},
+      {bat.sensors[BATTERY_CHARGING_POWER], field_end(PACK_STATUS_FIELDS[PACK_CURRENT])},
+      {bat.sensors[BATTERY_DISCHARGING_POWER], field_end(PACK_STATUS_FIELDS[PACK_CURRENT])},
+      {bat.text_sensors[BATTERY_OPERATION_STATUS], PACK_STATUS_OPERATION_STATUS_OFFSET + 2},
+      {bat.binary_sensors[BATTERY_CHARGING], PACK_STATUS_OPERATION_STATUS_OFFSET + 2},
+      {bat.binary_sensors[BATTERY_DISCHARGING], PACK_STATUS_OPERATION_STATUS_OFFSET + 2},
+      {bat.text_sensors[BATTERY_FAULT], field_end(PACK_STATUS_FIELDS[PACK_FAULT_BITMASK])},
+      {bat.text_sensors[BATTERY_ALARM], field_end(PACK_STATUS_FIELDS[PACK_ALARM_BITMASK])},
+      {bat.binary_sensors[BATTERY_CHARGING_SWITCH], field_end(PACK_STATUS_FIELDS[PACK_MOSFET_STATUS_BITMASK])},
+      {bat.binary_sensors[BATTERY_DISCHARGING_SWITCH], field_end(PACK_STATUS_FIELDS[PACK_MOSFET_STATUS_BITMASK])},
+      {bat.sensors[BATTERY_DELTA_CELL_VOLTAGE], field_end(PACK_STATUS_FIELDS[PACK_MIN_CELL_VOLTAGE])},
+  }));
+  if (battery_index == 0) {
+    // The MOS switches also need the current MOSFET state to write the other bit unchanged
+    length = std::max(length, plan_length({
+        {this->charging_switch_, field_end(PACK_STATUS_FIELDS[PACK_MOSFET_STATUS_BITMASK])},
+        {this->discharging_switch_, field_end(PACK_STATUS_FIELDS[PACK_MOSFET_STATUS_BITMASK])},
+    }));
+  }
+
+  // Pack status is always read: any answer at all keeps the battery's online status current
+  return std::max<uint16_t>(length, 2);
+}
+
+void EcoworthyBms::plan_reads_() {
+  for (uint8_t i = 0; i < this->battery_count_; i++) {
+    this->pack_status_lengths_[i] = this->plan_pack_status_length_(i);
+  }
+
+  for (uint8_t step = 0; step < CONFIG_BLOCK_COUNT; step++) {
+    const ConfigBlock &block = CONFIG_BLOCKS[step];
+    this->config_lengths_[step] = plan_fields(block.fields, block.field_count, this->param_sensors_);
+  }
+  // Text fields; lengths match the data_length gates in on_config_1c00_data_() and on_product_info_data_()
+  this->config_lengths_[0] = std::max(this->config_lengths_[0], plan_length({
+      {this->bms_serial_number_text_sensor_, 42},
+      {this->pack_serial_number_text_sensor_, 52},
+      {this->manufacturer_text_sensor_, 64},
+      {this->balance_mode_text_sensor_, 70},
+  }));
+  this->config_lengths_[2] = plan_length({
+      {this->hardware_version_text_sensor_, 6},
+      {this->batteries_[0].text_sensors[BATTERY_FIRMWARE_VERSION], 12},
+      {this->bms_model_text_sensor_, 28},
+  });
+  // Function 0x45 does not address by byte, so it can only be skipped, never shortened
+  if (this->config_lengths_[4] != 0) {
+    this->config_lengths_[4] = INDIVIDUAL_STATUS_DATA_LEN;
+  }
+
+  if (this->read_full_blocks_) {
+    for (uint8_t i = 0; i < this->battery_count_; i++) {
+      this->pack_status_lengths_[i] = REG_PACK_STATUS_END - REG_PACK_STATUS_START;
+    }
+    for (uint8_t step = 0; step < CONFIG_BLOCK_COUNT; step++) {
+      this->config_lengths_[step] = block_data_length(CONFIG_BLOCKS[step]);
+    }
+  }
+}
+
+void EcoworthyBms::setup() {
+  this->plan_reads_();
+  if (this->history_size_ > 0) {
+    for (uint8_t i = 0; i < this->battery_count_; i++) {
+      if (!this->history_[i].init(this->history_size_)) {
+        ESP_LOGE(TAG, "Could not allocate %u bytes of history for battery %u", this->history_size_, i + 1);
+        this->mark_failed();
+        return;
+      }
+    }
+  }
+
+  // Build every request frame this device will ever send up front, so polling does no CRC work.
+  // Everything is due at once; equal deadlines are served in slot order, pack status first.
+  const uint32_t now = millis();
+  this->setup_pack_status_slots_(now);
+  for (uint8_t step = 0; step < CONFIG_BLOCK_COUNT; step++) {
+    const ConfigBlock &block = CONFIG_BLOCKS[step];
+    // Blocks without any configured consumer keep an invalid frame and are never polled
+    if (this->config_lengths_[step] == 0) {
+      continue;
+    }
+    // 0x45 answers with its fixed layout whatever the range, so keep its end register as is
+    const uint16_t end = block.function == FUNCTION_INDIVIDUAL_PACK_STATUS ? block.end
+                                                                             : block.start + this->config_lengths_[step];
+    PollSlot &slot = this->poll_slots_[MAX_BATTERIES + step];
+    slot.frame_id = this->register_read(block.function, block.start, end);
+    slot.interval = this->config_intervals_[step];
+    slot.deadline = now;
+  }
+
+  if (this->publish_changes_only_) {
+    this->set_interval("heartbeat", this->heartbeat_interval_, [this]() { this->publish_epoch_++; });
+  }
+}
+
+// Pack status reads of every battery at their planned length, with the fast reads in between
+void EcoworthyBms::setup_pack_status_slots_(uint32_t now) {
+  for (uint8_t i = 0; i < this->battery_count_; i++) {
+
+    PollSlot &slot = this->poll_slots_[i];
+    slot.frame_id = this->register_read(FUNCTION_READ, REG_PACK_STATUS_START,
+                                        REG_PACK_STATUS_START + this->pack_status_lengths_[i], i);
+    slot.interval = this->pack_status_interval_;
+    slot.deadline = now;
+
+    if (this->fast_pack_status_interval_ == 0) {
+      continue;
+    }
+    // When the planned read is already this short, it simply runs at the fast rate
+    if (this->pack_status_lengths_[i] <= PACK_STATUS_FAST_LENGTH) {
+      slot.interval = std::min(slot.interval, this->fast_pack_status_interval_);
+      continue;
+    }
+    PollSlot &fast = this->poll_slots_[FAST_SLOTS_START + i];
+    fast.frame_id = this->register_read(FUNCTION_READ, REG_PACK_STATUS_START,
+                                        REG_PACK_STATUS_START + PACK_STATUS_FAST_LENGTH, i);
+    fast.interval = this->fast_pack_status_interval_;
+    fast.deadline = now;
+  }
+}
+
+void EcoworthyBms::add_on_pack_status_callback(std::function<void(uint8_t, const PackStatus &)> &&callback) {
+  this->pack_status_callback_.add(std::move(callback));
+  if (this->full_pack_status_) {
+    return;
+  }
+  this->full_pack_status_ = true;
+  // Registered after setup() planned the reads, e.g. from on_boot: widen them now
+  if (this->poll_slots_[0].frame_id != ecoworthy_modbus::EcoworthyModbus::INVALID_READ_FRAME) {
+    for (uint8_t i = 0; i < this->battery_count_; i++) {
+      this->pack_status_lengths_[i] = this->plan_pack_status_length_(i);
+    }
+    this->setup_pack_status_slots_(millis());
+  }
+}
+
 void EcoworthyBms::update() {
   // Check for primary timeout
   if (this->no_response_count_ >= MAX_NO_RESPONSE_COUNT) {
@@ -65,7 +571,7 @@ void EcoworthyBms::update() {
   
   // Check for secondary battery timeouts
   for (uint8_t i = 1; i < this->battery_count_; i++) {
-    if (this->secondary_batteries_[i].no_response_count >= MAX_NO_RESPONSE_COUNT) {
+    if (this->batteries_[i].no_response_count >= MAX_NO_RESPONSE_COUNT) {
       this->publish_device_unavailable_(i);
     }
   }
@@ -76,82 +582,79 @@ void EcoworthyBms::update() {
   // Track secondary battery timeouts
   for (uint8_t i = 1; i < this->battery_count_; i++) {
     this->track_online_status_(i);
-    this->secondary_batteries_[i].no_response_count++;
+    this->batteries_[i].no_response_count++;
   }
 
-  // For multi-battery: poll each battery in sequence, then config blocks for primary only
-  // Pattern: battery_1 status, battery_2 status, ..., battery_n status, [config blocks for primary]
-  
-  if (this->current_battery_index_ < this->battery_count_) {
-    // Request pack status for current battery
-    uint8_t battery_address = this->address_ + this->current_battery_index_;
-    ESP_LOGD(TAG, "Requesting pack status for battery %d (address 0x%02X)", 
-             this->current_battery_index_ + 1, battery_address);
-    this->parent_->send(battery_address, FUNCTION_READ, REG_PACK_STATUS_START, REG_PACK_STATUS_END);
-    this->current_battery_index_++;
-  } else {
-    // After polling all batteries, poll config blocks for primary
-    // update_counter_ tracks completed poll cycles (increments after each config step)
-    ESP_LOGD(TAG, "Config polling: step=%d, counter=%d", this->request_step_, this->update_counter_);
-    // Note: step cycles 0,1,2,3,0,1,2,3... so step N occurs when counter % 4 == N
-    // For periodic polling, we need modulo that aligns with step offset
-    switch (this->request_step_) {
-      case 0:
-        // Request config block 1 (at startup and every 20 config cycles = ~60 seconds)
-        // Step 0 at counter 0, 5, 10, 15, 20... so counter % 20 == 0 aligns
-        if (this->update_counter_ <= 1 || (this->update_counter_ % 20) == 0) {
-          ESP_LOGD(TAG, "Polling 0x1C00 config block (counter=%d)", this->update_counter_);
-          this->send(FUNCTION_READ, REG_CONFIG_1C00_START, REG_CONFIG_1C00_END);
-        }
-        break;
-      case 1:
-        // Request config block 2 (at startup and every 40 config cycles = ~2 minutes)
-        // Step 1 at counter 1, 6, 11... so (counter - 1) % 40 == 0 aligns
-        if (this->update_counter_ <= 2 || ((this->update_counter_ - 1) % 40) == 0) {
-          ESP_LOGD(TAG, "Polling 0x2000 config block (counter=%d)", this->update_counter_);
-          this->send(FUNCTION_READ, REG_CONFIG_2000_START, REG_CONFIG_2000_END);
-        }
-        break;
-      case 2:
-        // Request product info (at startup and every 240 config cycles = ~12 minutes)
-        // Step 2 at counter 2, 7, 12... so (counter - 2) % 240 == 0 aligns
-        if (this->update_counter_ <= 3 || ((this->update_counter_ - 2) % 240) == 0) {
-          ESP_LOGD(TAG, "Polling product info (counter=%d)", this->update_counter_);
-          this->send(FUNCTION_READ, REG_PRODUCT_INFO_START, REG_PRODUCT_INFO_END);
-        }
-        break;
-      case 3:
-        // Request protection parameters (at startup and every 120 config cycles = ~6 minutes)
-        // Step 3 at counter 3, 8, 13... so (counter - 3) % 120 == 0 aligns
-        if (this->update_counter_ <= 4 || ((this->update_counter_ - 3) % 120) == 0) {
-          ESP_LOGD(TAG, "Polling 0x1800 protection params (counter=%d)", this->update_counter_);
-          this->send(FUNCTION_READ, REG_PROTECTION_PARAMS_START, REG_PROTECTION_PARAMS_END);
-        }
-        break;
-      case 4:
-        // Request individual pack status (function 0x45) for non-aggregated CCL/DCL
-        // Poll every 10 config cycles = ~30 seconds (more frequent since limits are dynamic)
-        if (this->update_counter_ <= 5 || ((this->update_counter_ - 4) % 10) == 0) {
-          ESP_LOGD(TAG, "Polling individual pack status 0x45 (counter=%d)", this->update_counter_);
-          this->send(FUNCTION_INDIVIDUAL_PACK_STATUS, REG_INDIVIDUAL_STATUS_START, REG_INDIVIDUAL_STATUS_END);
-        }
-        break;
-    }
-    
-    this->request_step_ = (this->request_step_ + 1) % 5;
-    this->current_battery_index_ = 0;  // Reset for next update cycle
-    this->update_counter_++;
+  if (this->suppressed_publishes_sensor_ != nullptr) {
+    this->suppressed_publishes_sensor_->publish_state(this->suppressed_publishes_);
+  }
+
+  // In continuous mode the bus pulls requests through on_bus_idle() instead
+  if (this->poll_mode_ == POLL_MODE_INTERVAL) {
+    this->poll_next_();
   }
 }
 
-void EcoworthyBms::on_modbus_data(const std::vector<uint8_t> &data) {
-  if (data.size() < 10) {
-    ESP_LOGW(TAG, "Invalid response length: %d", data.size());
-    return;
+bool EcoworthyBms::on_bus_idle() {
+  if (this->poll_mode_ != POLL_MODE_CONTINUOUS) {
+    return false;
   }
+  return this->poll_next_();
+}
 
-  uint8_t address = data[0];
-  uint8_t function = data[1];
+// Queues the request whose data is due first, if any is due yet. A request counts as due once
+// its expected bus time would otherwise make the response arrive after the deadline.
+bool EcoworthyBms::poll_next_() {
+  // A passive bus only listens; data arrives at whatever rate the other master polls
+  if (this->parent_->is_passive()) {
+    return false;
+  }
+  const uint32_t now = millis();
+  uint8_t next = 0xFF;
+  for (uint8_t i = 0; i < FAST_SLOTS_START + MAX_BATTERIES; i++) {
+    const PollSlot &slot = this->poll_slots_[i];
+    if (slot.frame_id == ecoworthy_modbus::EcoworthyModbus::INVALID_READ_FRAME) {
+      continue;
+    }
+    const int32_t slack = int32_t(slot.deadline - now) - int32_t(this->parent_->expected_duration_ms(slot.frame_id));
+    if (slack > 0) {
+      continue;
+    }
+    if (next == 0xFF || int32_t(slot.deadline - this->poll_slots_[next].deadline) < 0) {
+      next = i;
+    }
+  }
+  if (next == 0xFF) {
+    return false;
+  }
+
+  PollSlot &slot = this->poll_slots_[next];
+  if (next < MAX_BATTERIES) {
+    ESP_LOGD(TAG, "Requesting pack status for battery %d (address 0x%02X)", next + 1, this->address_ + next);
+    // The full read carries the fast values too, so the next fast read can wait a whole interval
+    PollSlot &fast = this->poll_slots_[FAST_SLOTS_START + next];
+    fast.deadline = now + fast.interval;
+  } else if (next < FAST_SLOTS_START) {
+    ESP_LOGD(TAG, "Polling %s", CONFIG_BLOCKS[next - MAX_BATTERIES].name);
+  } else {
+    ESP_LOGV(TAG, "Requesting fast pack status for battery %d", next - FAST_SLOTS_START + 1);
+  }
+  this->send_read(slot.frame_id);
+
+  // Keep the polling phase, unless a whole interval was missed: then there is no point catching up
+  const int32_t late = int32_t(now - slot.deadline);
+  if (late > int32_t(slot.interval)) {
+    ESP_LOGD(TAG, "Request was %d ms overdue; refresh intervals exceed what the bus can deliver", late);
+    slot.deadline = now + slot.interval;
+  } else {
+    slot.deadline += slot.interval;
+  }
+  return true;
+}
+
+void EcoworthyBms::on_modbus_data(const ecoworthy_modbus::FrameView &frame) {
+  uint8_t address = frame.address();
+  uint8_t function = frame.function();
 
   // Calculate battery index from address (0 = primary, 1+ = slaves)
   uint8_t battery_index = address - this->address_;
@@ -174,428 +677,305 @@ void EcoworthyBms::on_modbus_data(const std::vector<uint8_t> &data) {
     return;
   }
 
-  if (function == FUNCTION_INDIVIDUAL_PACK_STATUS) {
-    // Function 0x45: Individual pack status (non-aggregated CCL/DCL)
-    // Only available for primary (directly connected battery)
-    if (battery_index == 0) {
-      this->on_individual_pack_status_data_(data);
+  // Pack status comes from every battery, the config blocks from the primary only
+  const uint16_t start_addr = frame.start_address();
+  const bool pack_status = function == FUNCTION_READ && start_addr == REG_PACK_STATUS_START;
+  // Fast reads are shorter than the planned read and leave the rest of the snapshot as it was
+  const bool fast = pack_status && frame.data_length() < this->pack_status_lengths_[battery_index];
+  uint8_t step = CONFIG_BLOCK_COUNT;
+  if (!pack_status) {
+    for (uint8_t i = 0; i < CONFIG_BLOCK_COUNT; i++) {
+      if (CONFIG_BLOCKS[i].function == function && CONFIG_BLOCKS[i].start == start_addr) {
+        step = i;
+      }
+    }
+  }
+
+  if (this->publish_changes_only_) {
+    // Unknown blocks map past the last slot and are always published in full
+    if (fast) {
+      // A heartbeat republishes what the fast read covers, but is not used up before the full read
+      this->force_publish_ = this->published_epoch_[battery_index] != this->publish_epoch_;
+    } else {
+      this->begin_block_publish_(pack_status ? battery_index : MAX_BATTERIES + step);
     }
-    return;
   }
 
-  if (function != FUNCTION_READ) {
+  if (function != FUNCTION_READ && function != FUNCTION_INDIVIDUAL_PACK_STATUS) {
     ESP_LOGW(TAG, "Unexpected function code: 0x%02X", function);
     return;
   }
 
-  // Get start/end addresses from response
-  uint16_t start_addr = (uint16_t(data[2]) << 8) | uint16_t(data[3]);
-  uint16_t end_addr = (uint16_t(data[4]) << 8) | uint16_t(data[5]);
-  uint16_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
+  // Fast reads arrive several times per full read; logging each at debug level would flood the log
+  if (fast) {
+    ESP_LOGV(TAG, "Received fast pack status from battery %d (addr 0x%02X), len=%d", battery_index + 1, address,
+             frame.data_length());
+  } else {
+    ESP_LOGD(TAG, "Received response from battery %d (addr 0x%02X): function=0x%02X, start=0x%04X, end=0x%04X, len=%d",
+             battery_index + 1, address, function, start_addr, frame.end_address(), frame.data_length());
+  }
+
+  if (pack_status) {
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+    if (battery_index == 0 && !fast) {
+      this->publish_cycle_allocations_();
+    }
+#endif
+    this->on_pack_status_data_(frame, battery_index, fast);
+    return;
+  }
+  if (step == CONFIG_BLOCK_COUNT || battery_index != 0) {
+    return;
+  }
 
-  ESP_LOGD(TAG, "Received response from battery %d (addr 0x%02X): start=0x%04X, end=0x%04X, len=%d", 
-           battery_index + 1, address, start_addr, end_addr, data_length);
+  const ConfigBlock &block = CONFIG_BLOCKS[step];
+  if (block.function == FUNCTION_INDIVIDUAL_PACK_STATUS && frame.data_length() < INDIVIDUAL_STATUS_DATA_LEN) {
+    ESP_LOGW(TAG, "Individual pack status response too short: %d bytes (expected %u)", frame.data_length(),
+             INDIVIDUAL_STATUS_DATA_LEN);
+  }
+  this->pack_config_.timestamp = millis();
+  this->publish_fields_(frame, block.fields, block.field_count, this->param_sensors_, this->pack_config_.values);
+  if (block.start == REG_CONFIG_1C00_START) {
+    this->on_config_1c00_data_(frame);
+  } else if (block.start == REG_PRODUCT_INFO_START) {
+    this->on_product_info_data_(frame);
+  }
+}
 
-  if (start_addr == REG_PACK_STATUS_START) {
-    this->on_pack_status_data_(data, battery_index);
-  } else if (start_addr == REG_CONFIG_1C00_START) {
-    // Config blocks only for primary
-    if (battery_index == 0) {
-      this->on_config_1c00_data_(data);
+void EcoworthyBms::on_pack_status_data_(const ecoworthy_modbus::FrameView &frame, uint8_t battery_index,
+                                        bool fast) {
+  const size_t data_length = frame.data_length();
+  BatterySensors &bat = this->batteries_[battery_index];
+  PackStatus &status = this->pack_status_[battery_index];
+  status.timestamp = millis();
+  status.fast = fast;
+  if (!fast) {
+    status.data_length = data_length;
+  }
+
+  ESP_LOGV(TAG, "Processing %u bytes of pack status data for battery %d", (unsigned) data_length, battery_index + 1);
+
+  this->publish_fields_(frame, PACK_STATUS_FIELDS, PACK_FIELD_COUNT, bat.sensors, status.values, this->deadbands_);
+
+  // Values derived from several fields or decoded into text
+  if (has_field(frame, PACK_STATUS_FIELDS[PACK_CURRENT])) {
+    const float power = status.power();
+    this->publish_pack_state_(bat, BATTERY_POWER, power);
+    this->publish_pack_state_(bat, BATTERY_CHARGING_POWER, power > 0 ? power : 0.0f);
+    this->publish_pack_state_(bat, BATTERY_DISCHARGING_POWER, power < 0 ? -power : 0.0f);
+  }
+
+  // Text is decoded into this buffer, and only when its raw value changed
+  char text[TEXT_BUFFER_SIZE];
+
+  if (frame.has(PACK_STATUS_OPERATION_STATUS_OFFSET, 2)) {
+    status.operation_status = frame.get_u16(PACK_STATUS_OPERATION_STATUS_OFFSET);
+    if (this->text_changed_(bat, BATTERY_OPERATION_STATUS, status.operation_status)) {
+      bat.text_sensors[BATTERY_OPERATION_STATUS]->publish_state(decode_operation_status(status.operation_status));
     }
-  } else if (start_addr == REG_CONFIG_2000_START) {
-    if (battery_index == 0) {
-      this->on_config_2000_data_(data);
+    this->publish_state_(bat.binary_sensors[BATTERY_CHARGING], status.operation_status == 1);
+    this->publish_state_(bat.binary_sensors[BATTERY_DISCHARGING], status.operation_status == 2);
+  }
+
+  if (has_field(frame, PACK_STATUS_FIELDS[PACK_FAULT_BITMASK])) {
+    status.fault_bitmask = frame.get_u32(PACK_STATUS_FIELDS[PACK_FAULT_BITMASK].offset);
+    if (this->text_changed_(bat, BATTERY_FAULT, status.fault_bitmask)) {
+      bat.text_sensors[BATTERY_FAULT]->publish_state(decode_fault_bits(status.fault_bitmask, text, sizeof(text)));
     }
-  } else if (start_addr == REG_PRODUCT_INFO_START) {
-    if (battery_index == 0) {
-      this->on_product_info_data_(data);
+  }
+  if (has_field(frame, PACK_STATUS_FIELDS[PACK_ALARM_BITMASK])) {
+    status.alarm_bitmask = frame.get_u32(PACK_STATUS_FIELDS[PACK_ALARM_BITMASK].offset);
+    if (this->text_changed_(bat, BATTERY_ALARM, status.alarm_bitmask)) {
+      bat.text_sensors[BATTERY_ALARM]->publish_state(decode_alarm_bits(status.alarm_bitmask, text, sizeof(text)));
     }
-  } else if (start_addr == REG_PROTECTION_PARAMS_START) {
+  }
+
+  if (has_field(frame, PACK_STATUS_FIELDS[PACK_MOSFET_STATUS_BITMASK])) {
+    status.mosfet_status = frame.get_u16(PACK_STATUS_FIELDS[PACK_MOSFET_STATUS_BITMASK].offset);
+    const bool discharge_mos = (status.mosfet_status & 0x0001) != 0;
+    const bool charge_mos = (status.mosfet_status & 0x0002) != 0;
+    this->publish_state_(bat.binary_sensors[BATTERY_DISCHARGING_SWITCH], discharge_mos);
+    this->publish_state_(bat.binary_sensors[BATTERY_CHARGING_SWITCH], charge_mos);
+
+    // The MOS switches belong to the primary
     if (battery_index == 0) {
-      this->on_protection_params_data_(data);
+      this->discharge_mos_state_ = discharge_mos;
+      this->charge_mos_state_ = charge_mos;
+      if (this->charging_switch_ != nullptr) {
+        this->charging_switch_->publish_state(this->charge_mos_state_);
+      }
+      if (this->discharging_switch_ != nullptr) {
+        this->discharging_switch_->publish_state(this->discharge_mos_state_);
+      }
     }
   }
-}
 
-void EcoworthyBms::on_pack_status_data_(const std::vector<uint8_t> &data, uint8_t battery_index) {
-  // Data starts at offset 8 (after header: addr + func + start_addr + end_addr + data_len)
-  const uint8_t *payload = &data[8];
-  size_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
-
-  auto get_16bit = [&](size_t i) -> uint16_t {
-    if (i + 1 >= data_length) return 0;
-    return (uint16_t(payload[i]) << 8) | uint16_t(payload[i + 1]);
-  };
-
-  auto get_32bit = [&](size_t i) -> uint32_t {
-    if (i + 3 >= data_length) return 0;
-    return (uint32_t(payload[i]) << 24) | (uint32_t(payload[i + 1]) << 16) | 
-           (uint32_t(payload[i + 2]) << 8) | uint32_t(payload[i + 3]);
-  };
-
-  ESP_LOGV(TAG, "Processing %d bytes of pack status data for battery %d", data_length, battery_index + 1);
-
-  // Parse common values for both primary and secondary
-  float total_voltage = get_16bit(0) * 0.01f;
-  uint32_t current_raw = get_32bit(4);
-  float current = ((int32_t)current_raw - 300000) / 100.0f;
-  float power = total_voltage * current;
-  float soc = get_16bit(8) / 100.0f;
-  float soh = get_16bit(22);
-  float remaining_capacity = get_16bit(10) / 100.0f;
-  float power_tube_temp = (get_16bit(16) - 500) / 10.0f;
-  float ambient_temp = (get_16bit(18) - 500) / 10.0f;
-  uint16_t operation_status = get_16bit(20);
-  float max_cell_voltage = get_16bit(40) * 0.001f;
-  float min_cell_voltage = get_16bit(44) * 0.001f;
-  float delta_cell_voltage = max_cell_voltage - min_cell_voltage;
-  float min_temp = (get_16bit(54) - 500) / 10.0f;
-  float max_temp = (get_16bit(50) - 500) / 10.0f;
+  if (has_field(frame, PACK_STATUS_FIELDS[PACK_MIN_CELL_VOLTAGE])) {
+    this->publish_pack_state_(bat, BATTERY_DELTA_CELL_VOLTAGE,
+                              status.values[PACK_MAX_CELL_VOLTAGE] - status.values[PACK_MIN_CELL_VOLTAGE]);
+  }
 
-  if (battery_index == 0) {
-    // Primary battery - use all the original sensors
-    this->publish_state_(this->total_voltage_sensor_, total_voltage);
-    this->publish_state_(this->current_sensor_, current);
-    this->publish_state_(this->power_sensor_, power);
-    this->publish_state_(this->charging_power_sensor_, power > 0 ? power : 0);
-    this->publish_state_(this->discharging_power_sensor_, power < 0 ? -power : 0);
-    this->publish_state_(this->state_of_charge_sensor_, soc);
-    this->publish_state_(this->remaining_capacity_sensor_, remaining_capacity);
-    
-    float full_capacity = get_16bit(12) / 100.0f;
-    this->publish_state_(this->full_capacity_sensor_, full_capacity);
-    
-    float rated_capacity = get_16bit(14) / 100.0f;
-    this->publish_state_(this->rated_capacity_sensor_, rated_capacity);
-    
-    this->publish_state_(this->power_tube_temperature_sensor_, power_tube_temp);
-    this->publish_state_(this->ambient_temperature_sensor_, ambient_temp);
-    
-    this->publish_state_(this->operation_status_text_sensor_, this->decode_operation_status_(operation_status));
-    this->publish_state_(this->charging_binary_sensor_, operation_status == 1);
-    this->publish_state_(this->discharging_binary_sensor_, operation_status == 2);
-    
-    this->publish_state_(this->state_of_health_sensor_, soh);
-    
-    uint32_t fault = get_32bit(24);
-    this->publish_state_(this->fault_bitmask_sensor_, (float)fault);
-    this->publish_state_(this->fault_text_sensor_, this->decode_fault_(fault));
-    
-    uint32_t alarm = get_32bit(28);
-    this->publish_state_(this->alarm_bitmask_sensor_, (float)alarm);
-    this->publish_state_(this->alarm_text_sensor_, this->decode_alarm_(alarm));
-    
-    uint16_t mosfet_status = get_16bit(32);
-    this->publish_state_(this->mosfet_status_bitmask_sensor_, (float)mosfet_status);
-    
-    this->discharge_mos_state_ = (mosfet_status & 0x0001) != 0;
-    this->charge_mos_state_ = (mosfet_status & 0x0002) != 0;
-    
-    this->publish_state_(this->discharging_switch_binary_sensor_, this->discharge_mos_state_);
-    this->publish_state_(this->charging_switch_binary_sensor_, this->charge_mos_state_);
-    
-    if (this->charging_switch_ != nullptr) {
-      this->charging_switch_->publish_state(this->charge_mos_state_);
+  // Cell voltages
+  const uint16_t cell_count = frame.get_u16(PACK_STATUS_FIELDS[PACK_CELL_COUNT].offset);
+  for (uint8_t i = 0; i < std::min((uint16_t)16, cell_count); i++) {
+    if (!frame.has(PACK_STATUS_CELLS_OFFSET + i * 2, 2)) {
+      break;
     }
-    if (this->discharging_switch_ != nullptr) {
-      this->discharging_switch_->publish_state(this->discharge_mos_state_);
+    uint16_t cell_mv = frame.get_u16(PACK_STATUS_CELLS_OFFSET + i * 2);
+    if (cell_mv > 0 && cell_mv < 5000) {
+      status.cell_voltages_mv[i] = cell_mv;
+      this->publish_pack_state_(bat, BATTERY_CELL_VOLTAGES + i, cell_mv * 0.001f);
+    } else {
+      status.cell_voltages_mv[i] = 0;
     }
-    
-    uint16_t cycle_count = get_16bit(36);
-    this->publish_state_(this->cycle_count_sensor_, (float)cycle_count);
-    
-    uint16_t max_cell_num = get_16bit(38);
-    this->publish_state_(this->max_voltage_cell_sensor_, (float)max_cell_num);
-    this->publish_state_(this->max_cell_voltage_sensor_, max_cell_voltage);
-    
-    uint16_t min_cell_num = get_16bit(42);
-    this->publish_state_(this->min_voltage_cell_sensor_, (float)min_cell_num);
-    this->publish_state_(this->min_cell_voltage_sensor_, min_cell_voltage);
-    
-    float avg_cell_voltage = get_16bit(46) * 0.001f;
-    this->publish_state_(this->average_cell_voltage_sensor_, avg_cell_voltage);
-    this->publish_state_(this->delta_cell_voltage_sensor_, delta_cell_voltage);
-    
-    this->publish_state_(this->max_temperature_sensor_, max_temp);
-    this->publish_state_(this->min_temperature_sensor_, min_temp);
-    
-    float avg_temp = (get_16bit(56) - 500) / 10.0f;
-    this->publish_state_(this->avg_temperature_sensor_, avg_temp);
-    
-    float cvl = get_16bit(58) / 10.0f;
-    this->publish_state_(this->charge_voltage_limit_sensor_, cvl);
-    
-    float ccl = get_16bit(60) / 10.0f;
-    this->publish_state_(this->charge_current_limit_sensor_, ccl);
-    
-    float dvl = get_16bit(62) / 10.0f;
-    this->publish_state_(this->discharge_voltage_limit_sensor_, dvl);
-    
-    float dcl = get_16bit(64) / 10.0f;
-    this->publish_state_(this->discharge_current_limit_sensor_, dcl);
-    
-    uint16_t cell_count = get_16bit(66);
-    this->publish_state_(this->cell_count_sensor_, (float)cell_count);
-    
-    // Cell voltages
-    size_t cell_offset = 68;
-    for (uint8_t i = 0; i < std::min((uint16_t)16, cell_count); i++) {
-      uint16_t cell_mv = get_16bit(cell_offset + i * 2);
-      if (cell_mv > 0 && cell_mv < 5000) {
-        float cell_voltage = cell_mv * 0.001f;
-        this->publish_state_(this->cells_[i].cell_voltage_sensor_, cell_voltage);
+  }
+
+  // Temperature sensors
+  size_t temp_offset = PACK_STATUS_CELLS_OFFSET + cell_count * 2;
+  if (temp_offset + 2 <= data_length) {
+    uint16_t temp_count = frame.get_u16(temp_offset);
+    status.has_temperatures = true;
+    status.temperature_count = temp_count;
+    this->publish_pack_state_(bat, BATTERY_TEMPERATURE_SENSOR_COUNT, (float)temp_count);
+
+    size_t temp_values_offset = temp_offset + 2;
+    for (uint8_t i = 0; i < 4; i++) {
+      if (i < temp_count && temp_values_offset + i * 2 + 2 <= data_length) {
+        float temp = (frame.get_u16(temp_values_offset + i * 2) - 500) * 0.1f;
+        status.temperatures[i] = temp;
+        this->publish_pack_state_(bat, BATTERY_TEMPERATURE_SENSORS + i, temp);
+      } else {
+        status.temperatures[i] = NAN;
       }
     }
-    
-    // Temperature sensors
-    size_t temp_offset = cell_offset + cell_count * 2;
-    if (temp_offset + 2 <= data_length) {
-      uint16_t temp_count = get_16bit(temp_offset);
-      this->publish_state_(this->temperature_sensor_count_sensor_, (float)temp_count);
-      
-      size_t temp_values_offset = temp_offset + 2;
-      for (uint8_t i = 0; i < std::min((uint16_t)4, temp_count); i++) {
-        if (temp_values_offset + i * 2 + 2 <= data_length) {
-          float temp = (get_16bit(temp_values_offset + i * 2) - 500) / 10.0f;
-          this->publish_state_(this->temperatures_[i].temperature_sensor_, temp);
-        }
-      }
-      
-      size_t after_temps_offset = temp_values_offset + temp_count * 2;
-      
-      if (after_temps_offset + 4 <= data_length) {
-        uint16_t balance_status = get_16bit(after_temps_offset + 2);
-        this->publish_state_(this->balancing_bitmask_sensor_, (float)balance_status);
-        this->publish_state_(this->balancing_binary_sensor_, balance_status != 0);
-      }
-      
-      if (after_temps_offset + 6 <= data_length) {
-        uint16_t fw_raw = get_16bit(after_temps_offset + 4);
-        float fw_major = (fw_raw >> 8) & 0xFF;
-        float fw_minor = fw_raw & 0xFF;
-        char fw_str[16];
-        snprintf(fw_str, sizeof(fw_str), "%d.%d", (int)fw_major, (int)fw_minor);
-        this->publish_state_(this->firmware_text_sensor_, std::string(fw_str));
-      }
-      
-      if (after_temps_offset + 36 <= data_length) {
-        std::string serial((char *)&payload[after_temps_offset + 6], 30);
-        size_t end = serial.find('\0');
-        if (end != std::string::npos) {
-          serial = serial.substr(0, end);
-        }
-        this->publish_state_(this->serial_number_text_sensor_, serial);
-      }
+
+    size_t after_temps_offset = temp_values_offset + temp_count * 2;
+
+    // Balance status
+    if (after_temps_offset + 4 <= data_length) {
+      status.has_balancing = true;
+      status.balancing_bitmask = frame.get_u16(after_temps_offset + 2);
+      this->publish_pack_state_(bat, BATTERY_BALANCING_BITMASK, (float)status.balancing_bitmask);
+      this->publish_state_(bat.binary_sensors[BATTERY_BALANCING], status.balancing_bitmask != 0);
     }
-  } else {
-    // Secondary battery - use the per-battery sensors
-    // Same parsing as primary but publish to per-battery sensor structs
-    SecondaryBatterySensors &bat = this->secondary_batteries_[battery_index];
-    
-    // Basic voltage, current, power
-    this->publish_state_(bat.total_voltage, total_voltage);
-    this->publish_state_(bat.current, current);
-    this->publish_state_(bat.power, power);
-    this->publish_state_(bat.charging_power, power > 0 ? power : 0.0f);
-    this->publish_state_(bat.discharging_power, power < 0 ? -power : 0.0f);
-    
-    // State
-    this->publish_state_(bat.state_of_charge, soc);
-    this->publish_state_(bat.state_of_health, soh);
-    
-    // Capacity
-    this->publish_state_(bat.remaining_capacity, remaining_capacity);
-    float full_capacity = get_16bit(12) / 100.0f;
-    this->publish_state_(bat.full_capacity, full_capacity);
-    float rated_capacity = get_16bit(14) / 100.0f;
-    this->publish_state_(bat.rated_capacity, rated_capacity);
-    
-    // Temperature
-    this->publish_state_(bat.power_tube_temperature, power_tube_temp);
-    this->publish_state_(bat.ambient_temperature, ambient_temp);
-    this->publish_state_(bat.min_temperature, min_temp);
-    this->publish_state_(bat.max_temperature, max_temp);
-    float avg_temp = (get_16bit(56) - 500) / 10.0f;
-    this->publish_state_(bat.avg_temperature, avg_temp);
-    
-    // Cell voltages
-    this->publish_state_(bat.min_cell_voltage, min_cell_voltage);
-    this->publish_state_(bat.max_cell_voltage, max_cell_voltage);
-    this->publish_state_(bat.delta_cell_voltage, delta_cell_voltage);
-    float avg_cell_voltage = get_16bit(46) * 0.001f;
-    this->publish_state_(bat.average_cell_voltage, avg_cell_voltage);
-    
-    uint16_t max_cell_num = get_16bit(38);
-    this->publish_state_(bat.max_voltage_cell, (float)max_cell_num);
-    uint16_t min_cell_num = get_16bit(42);
-    this->publish_state_(bat.min_voltage_cell, (float)min_cell_num);
-    
-    // Operation status
-    this->publish_state_(bat.online_status, true);
-    this->publish_state_(bat.charging, operation_status == 1);
-    this->publish_state_(bat.discharging, operation_status == 2);
-    this->publish_state_(bat.operation_status, this->decode_operation_status_(operation_status));
-    
-    // Fault and alarm
-    uint32_t fault = get_32bit(24);
-    this->publish_state_(bat.fault_bitmask, (float)fault);
-    this->publish_state_(bat.fault, this->decode_fault_(fault));
-    
-    uint32_t alarm = get_32bit(28);
-    this->publish_state_(bat.alarm_bitmask, (float)alarm);
-    this->publish_state_(bat.alarm, this->decode_alarm_(alarm));
-    
-    // MOSFET status
-    uint16_t mosfet_status = get_16bit(32);
-    this->publish_state_(bat.mosfet_status_bitmask, (float)mosfet_status);
-    this->publish_state_(bat.discharging_switch, (mosfet_status & 0x0001) != 0);
-    this->publish_state_(bat.charging_switch, (mosfet_status & 0x0002) != 0);
-    
-    // Cycle count
-    uint16_t cycle_count = get_16bit(36);
-    this->publish_state_(bat.cycle_count, (float)cycle_count);
-    
-    // Limits (dynamic)
-    float cvl = get_16bit(58) / 10.0f;
-    this->publish_state_(bat.charge_voltage_limit, cvl);
-    float ccl = get_16bit(60) / 10.0f;
-    this->publish_state_(bat.charge_current_limit, ccl);
-    float dvl = get_16bit(62) / 10.0f;
-    this->publish_state_(bat.discharge_voltage_limit, dvl);
-    float dcl = get_16bit(64) / 10.0f;
-    this->publish_state_(bat.discharge_current_limit, dcl);
-    
-    // Cell count and individual cell voltages
-    uint16_t cell_count = get_16bit(66);
-    this->publish_state_(bat.cell_count, (float)cell_count);
-    
-    size_t cell_offset = 68;
-    for (uint8_t i = 0; i < std::min((uint16_t)16, cell_count); i++) {
-      uint16_t cell_mv = get_16bit(cell_offset + i * 2);
-      if (cell_mv > 0 && cell_mv < 5000) {
-        float cell_voltage = cell_mv * 0.001f;
-        this->publish_state_(bat.cell_voltages[i], cell_voltage);
+
+    // Firmware version
+    if (after_temps_offset + 6 <= data_length) {
+      status.has_firmware_version = true;
+      status.firmware_version = frame.get_u16(after_temps_offset + 4);
+      if (this->text_changed_(bat, BATTERY_FIRMWARE_VERSION, status.firmware_version)) {
+        snprintf(text, sizeof(text), "%d.%d", (status.firmware_version >> 8) & 0xFF, status.firmware_version & 0xFF);
+        bat.text_sensors[BATTERY_FIRMWARE_VERSION]->publish_state(text);
       }
     }
-    
-    // Temperature sensors
-    size_t temp_offset = cell_offset + cell_count * 2;
-    if (temp_offset + 2 <= data_length) {
-      uint16_t temp_count = get_16bit(temp_offset);
-      this->publish_state_(bat.temperature_sensor_count, (float)temp_count);
-      
-      size_t temp_values_offset = temp_offset + 2;
-      for (uint8_t i = 0; i < std::min((uint16_t)4, temp_count); i++) {
-        if (temp_values_offset + i * 2 + 2 <= data_length) {
-          float temp = (get_16bit(temp_values_offset + i * 2) - 500) / 10.0f;
-          this->publish_state_(bat.temperature_sensors[i], temp);
-        }
-      }
-      
-      size_t after_temps_offset = temp_values_offset + temp_count * 2;
-      
-      // Balance status
-      if (after_temps_offset + 4 <= data_length) {
-        uint16_t balance_status = get_16bit(after_temps_offset + 2);
-        this->publish_state_(bat.balancing_bitmask, (float)balance_status);
-        this->publish_state_(bat.balancing, balance_status != 0);
-      }
-      
-      // Firmware version
-      if (after_temps_offset + 6 <= data_length) {
-        uint16_t fw_raw = get_16bit(after_temps_offset + 4);
-        float fw_major = (fw_raw >> 8) & 0xFF;
-        float fw_minor = fw_raw & 0xFF;
-        char fw_str[16];
-        snprintf(fw_str, sizeof(fw_str), "%d.%d", (int)fw_major, (int)fw_minor);
-        this->publish_state_(bat.firmware_version, std::string(fw_str));
-      }
-      
-      // Serial number
-      if (after_temps_offset + 36 <= data_length) {
-        std::string serial((char *)&payload[after_temps_offset + 6], 30);
-        size_t end = serial.find('\0');
-        if (end != std::string::npos) {
-          serial = serial.substr(0, end);
-        }
-        this->publish_state_(bat.serial_number, serial);
+
+    // Serial number, copied straight from the frame so the snapshot needs no allocation
+    if (after_temps_offset + 36 <= data_length) {
+      status.has_serial_number = true;
+      const size_t serial_length = frame.get_string(after_temps_offset + 6, 30, status.serial_number);
+      if (serial_length > 0 &&
+          this->text_changed_(bat, BATTERY_SERIAL_NUMBER, fnv1a_hash(status.serial_number, serial_length))) {
+        bat.text_sensors[BATTERY_SERIAL_NUMBER]->publish_state(status.serial_number);
       }
     }
-    
-    ESP_LOGD(TAG, "Battery %d: %.2fV, %.2fA, %.1f%% SOC", 
-             battery_index + 1, total_voltage, current, soc);
   }
+
+  if (fast) {
+    ESP_LOGV(TAG, "Battery %d: %.2fV, %.2fA, %.1f%% SOC", battery_index + 1, status.values[PACK_TOTAL_VOLTAGE],
+             status.values[PACK_CURRENT], status.values[PACK_STATE_OF_CHARGE]);
+  } else {
+    ESP_LOGD(TAG, "Battery %d: %.2fV, %.2fA, %.1f%% SOC", battery_index + 1, status.values[PACK_TOTAL_VOLTAGE],
+             status.values[PACK_CURRENT], status.values[PACK_STATE_OF_CHARGE]);
+  }
+
+  // A fast read leaves the cells and temperatures as they were, so it would only repeat them
+  if (!fast && this->history_[battery_index].is_enabled()) {
+    this->add_history_sample_(battery_index, status);
+  }
+  this->pack_status_callback_.call(battery_index, status);
 }
 
-std::string EcoworthyBms::decode_operation_status_(uint16_t status) {
-  switch (status) {
-    case 0: return "Idle";
-    case 1: return "Charging";
-    case 2: return "Discharging";
-    default: return "Unknown";
+static int32_t history_value(float value, float scale) {
+  return std::isnan(value) ? PackHistory::ABSENT : int32_t(std::lround(value * scale));
+}
+
+void EcoworthyBms::add_history_sample_(uint8_t battery_index, const PackStatus &status) {
+  int32_t fields[HISTORY_FIELD_COUNT];
+  fields[HISTORY_TOTAL_VOLTAGE] = history_value(status.values[PACK_TOTAL_VOLTAGE], 100.0f);
+  fields[HISTORY_CURRENT] = history_value(status.values[PACK_CURRENT], 100.0f);
+  fields[HISTORY_STATE_OF_CHARGE] = history_value(status.values[PACK_STATE_OF_CHARGE], 100.0f);
+  for (uint8_t cell = 0; cell < 16; cell++) {
+    fields[HISTORY_CELL_VOLTAGES + cell] = status.cell_voltages_mv[cell];
+  }
+  for (uint8_t temp = 0; temp < 4; temp++) {
+    fields[HISTORY_TEMPERATURES + temp] = history_value(status.temperatures[temp], 10.0f);
   }
+  fields[HISTORY_POWER_TUBE_TEMPERATURE] = history_value(status.values[PACK_POWER_TUBE_TEMPERATURE], 10.0f);
+  this->history_[battery_index].add(status.timestamp, fields);
 }
 
-std::string EcoworthyBms::decode_fault_(uint32_t fault) {
-  if (fault == 0) return "None";
-  
-  std::string result;
-  if (fault & (1 << 0)) result += "Cell OV;";
-  if (fault & (1 << 1)) result += "Cell UV;";
-  if (fault & (1 << 2)) result += "Pack OV;";
-  if (fault & (1 << 3)) result += "Pack UV;";
-  if (fault & (1 << 4)) result += "Charge OC Slow;";
-  if (fault & (1 << 5)) result += "Charge OC Fast;";
-  if (fault & (1 << 6)) result += "Discharge OC Slow;";
-  if (fault & (1 << 7)) result += "Discharge OC Fast;";
-  if (fault & (1 << 8)) result += "Charge HT;";
-  if (fault & (1 << 9)) result += "Charge LT;";
-  if (fault & (1 << 10)) result += "Discharge HT;";
-  if (fault & (1 << 11)) result += "Discharge LT;";
-  if (fault & (1 << 12)) result += "MOS HT;";
-  if (fault & (1 << 13)) result += "Ambient HT;";
-  if (fault & (1 << 14)) result += "Ambient LT;";
-  if (fault & (1 << 15)) result += "Cell V Diff;";
-  if (fault & (1 << 16)) result += "Temp Diff;";
-  if (fault & (1 << 17)) result += "SOC Low;";
-  if (fault & (1 << 18)) result += "Short Circuit;";
-  if (fault & (1 << 19)) result += "Cell Offline;";
-  if (fault & (1 << 20)) result += "Temp Sensor Fail;";
-  if (fault & (1 << 21)) result += "Charge MOS Fault;";
-  if (fault & (1 << 22)) result += "Discharge MOS Fault;";
-  if (fault & (1 << 23)) result += "AFE Comm Error;";
-  
-  if (!result.empty() && result.back() == ';') result.pop_back();
-  return result;
+void EcoworthyBms::dump_history() {
+  if (this->dumping_history_) {
+    ESP_LOGW(TAG, "History dump already in progress");
+    return;
+  }
+  this->dumping_history_ = true;
+  this->dump_battery_started_ = false;
+  this->dump_battery_ = 0;
+  this->set_interval("dump_history", DUMP_HISTORY_INTERVAL, [this]() { this->dump_history_step_(); });
 }
 
-std::string EcoworthyBms::decode_alarm_(uint32_t alarm) {
-  if (alarm == 0) return "None";
-  
-  std::string result;
-  if (alarm & (1 << 0)) result += "Cell OV;";
-  if (alarm & (1 << 1)) result += "Cell UV;";
-  if (alarm & (1 << 2)) result += "Pack OV;";
-  if (alarm & (1 << 3)) result += "Pack UV;";
-  if (alarm & (1 << 4)) result += "Charge OC;";
-  if (alarm & (1 << 5)) result += "Discharge OC;";
-  if (alarm & (1 << 6)) result += "Charge HT;";
-  if (alarm & (1 << 7)) result += "Charge LT;";
-  if (alarm & (1 << 8)) result += "Discharge HT;";
-  if (alarm & (1 << 9)) result += "Discharge LT;";
-  if (alarm & (1 << 10)) result += "MOS HT;";
-  if (alarm & (1 << 11)) result += "Ambient HT;";
-  if (alarm & (1 << 12)) result += "Ambient LT;";
-  if (alarm & (1 << 13)) result += "Cell V Diff;";
-  if (alarm & (1 << 14)) result += "Temp Diff;";
-  if (alarm & (1 << 15)) result += "SOC Low;";
-  if (alarm & (1 << 16)) result += "EEP Fault;";
-  if (alarm & (1 << 17)) result += "RTC Abnormal;";
-  if (alarm & (1 << 18)) result += "Full Charge Prot;";
-  
-  if (!result.empty() && result.back() == ';') result.pop_back();
-  return result;
+// Logs the next block of the dump. Samples keep arriving in between, so blocks are tracked by
+// sequence number: the newest one may still grow, and the oldest ones may be overwritten first.
+void EcoworthyBms::dump_history_step_() {
+  // 32 bytes per line keeps each line well inside the logger's buffer
+  static const uint8_t BYTES_PER_LINE = 32;
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+  while (this->dump_battery_ < this->battery_count_ && !this->history_[this->dump_battery_].is_enabled()) {
+    this->dump_battery_++;
+  }
+  if (this->dump_battery_ == this->battery_count_) {
+    this->cancel_interval("dump_history");
+    this->dumping_history_ = false;
+    return;
+  }
+
+  const uint8_t battery = this->dump_battery_ + 1;
+  const PackHistory &history = this->history_[this->dump_battery_];
+  if (!this->dump_battery_started_) {
+    ESP_LOGI(TAG, "History battery %u: %u samples, %u of %u blocks, %u bytes, now %u ms", battery,
+             history.sample_count(), history.blocks_used(), history.block_count(), history.used_bytes(), millis());
+    this->dump_battery_started_ = true;
+    this->dump_sequence_ = history.first_sequence();
+  }
+  if (int32_t(this->dump_sequence_ - history.first_sequence()) < 0) {
+    ESP_LOGW(TAG, "History battery %u: %u blocks overwritten during the dump", battery,
+             history.first_sequence() - this->dump_sequence_);
+    this->dump_sequence_ = history.first_sequence();
+  }
+  const uint32_t index = this->dump_sequence_ - history.first_sequence();
+  if (index >= history.blocks_used()) {
+    ESP_LOGI(TAG, "History battery %u end", battery);
+    this->dump_battery_++;
+    this->dump_battery_started_ = false;
+    return;
+  }
+
+  const uint8_t *block = history.block(index);
+  const uint16_t length = PackHistory::block_length(block);
+  char line[BYTES_PER_LINE * 2 + 1];
+  for (uint16_t offset = 0; offset < length; offset += BYTES_PER_LINE) {
+    const uint16_t count = std::min<uint16_t>(BYTES_PER_LINE, length - offset);
+    for (uint16_t j = 0; j < count; j++) {
+      line[j * 2] = HEX_DIGITS[block[offset + j] >> 4];
+      line[j * 2 + 1] = HEX_DIGITS[block[offset + j] & 0x0F];
+    }
+    line[count * 2] = '\0';
+    // Sequence number and offset let the decoder drop blocks that lost a line on the way
+    ESP_LOGI(TAG, "H%u %u %u %s", battery, this->dump_sequence_, offset, line);
+  }
+  this->dump_sequence_++;
 }
 
 void EcoworthyBms::publish_state_(binary_sensor::BinarySensor *binary_sensor, const bool &state) {
@@ -604,16 +984,89 @@ void EcoworthyBms::publish_state_(binary_sensor::BinarySensor *binary_sensor, co
   }
 }
 
-void EcoworthyBms::publish_state_(sensor::Sensor *sensor, float value) {
-  if (sensor != nullptr && !std::isnan(value)) {
-    sensor->publish_state(value);
+// Decides whether the block about to be decoded is published in full, which happens for the first
+// response of each heartbeat epoch
+void EcoworthyBms::begin_block_publish_(uint8_t slot) {
+  if (slot >= MAX_BATTERIES + CONFIG_BLOCK_COUNT) {
+    this->force_publish_ = true;
+    return;
   }
+  this->force_publish_ = this->published_epoch_[slot] != this->publish_epoch_;
+  this->published_epoch_[slot] = this->publish_epoch_;
 }
 
-void EcoworthyBms::publish_state_(text_sensor::TextSensor *text_sensor, const std::string &state) {
-  if (text_sensor != nullptr && !state.empty()) {
-    text_sensor->publish_state(state);
+// Whether a pack text sensor needs publishing: it exists, and its raw value differs from the one
+// last published or a heartbeat is due. Unchanged values count as suppressed in changes-only mode.
+bool EcoworthyBms::text_changed_(BatterySensors &bat, BatteryTextSensor slot, uint32_t key) {
+  text_sensor::TextSensor *text_sensor = bat.text_sensors[slot];
+  if (text_sensor == nullptr) {
+    return false;
   }
+  if (text_sensor->has_state() && bat.text_keys[slot] == key && !this->force_publish_) {
+    if (this->publish_changes_only_) {
+      this->suppressed_publishes_++;
+    }
+    return false;
+  }
+  bat.text_keys[slot] = key;
+  return true;
+}
+
+// Decodes every field the frame covers into values and publishes those with a sensor; deadbands, if given,
+// are indexed like sensors
+void EcoworthyBms::publish_fields_(const ecoworthy_modbus::FrameView &frame, const RegisterField *fields,
+                                   size_t count, sensor::Sensor *const *sensors, float *values,
+                                   const float *deadbands) {
+  for (size_t i = 0; i < count; i++) {
+    const RegisterField &field = fields[i];
+    // Short reads only cover the fields planned for; anything past the end is left alone
+    if (!has_field(frame, field)) {
+      continue;
+    }
+    values[field.slot] = decode_field(frame, field);
+    this->publish_state_(sensors[field.slot], values[field.slot], deadbands != nullptr ? deadbands[field.slot] : 0.0f);
+  }
+}
+
+void EcoworthyBms::publish_state_(sensor::Sensor *sensor, float value, float deadband) {
+  if (sensor == nullptr || std::isnan(value)) {
+    return;
+  }
+  // A configured deadband suppresses values within it of the last published one. Without one the sensor's
+  // accuracy_decimals is its deadband: a value that rounds to the last published one would look identical
+  // downstream, so it is not sent.
+  if (this->publish_changes_only_ && !this->force_publish_ && sensor->has_state() &&
+      !std::isnan(sensor->raw_state)) {
+    bool unchanged;
+    if (deadband > 0.0f) {
+      unchanged = std::fabs(value - sensor->raw_state) <= deadband;
+    } else {
+      static const float SCALES[] = {1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f};
+      const int8_t decimals = std::min<int8_t>(std::max<int8_t>(sensor->get_accuracy_decimals(), 0), 4);
+      const float scale = SCALES[decimals];
+      unchanged = std::lround(value * scale) == std::lround(sensor->raw_state * scale);
+    }
+    if (unchanged) {
+      this->suppressed_publishes_++;
+      return;
+    }
+  }
+  sensor->publish_state(value);
+}
+
+// Text is only published when it changes, since TextSensor copies it into a std::string; in
+// publish_changes_only mode it is also republished on the heartbeat
+void EcoworthyBms::publish_state_(text_sensor::TextSensor *text_sensor, const char *state) {
+  if (text_sensor == nullptr || state[0] == '\0') {
+    return;
+  }
+  if (text_sensor->has_state() && text_sensor->raw_state == state && !this->force_publish_) {
+    if (this->publish_changes_only_) {
+      this->suppressed_publishes_++;
+    }
+    return;
+  }
+  text_sensor->publish_state(state);
 }
 
 void EcoworthyBms::reset_online_status_tracker_() {
@@ -623,8 +1076,8 @@ void EcoworthyBms::reset_online_status_tracker_() {
 
 void EcoworthyBms::reset_online_status_tracker_(uint8_t battery_index) {
   if (battery_index > 0 && battery_index < MAX_BATTERIES) {
-    this->secondary_batteries_[battery_index].no_response_count = 0;
-    this->publish_state_(this->secondary_batteries_[battery_index].online_status, true);
+    this->batteries_[battery_index].no_response_count = 0;
+    this->publish_state_(this->batteries_[battery_index].binary_sensors[BATTERY_ONLINE_STATUS], true);
   }
 }
 
@@ -636,8 +1089,8 @@ void EcoworthyBms::track_online_status_() {
 
 void EcoworthyBms::track_online_status_(uint8_t battery_index) {
   if (battery_index > 0 && battery_index < MAX_BATTERIES) {
-    if (this->secondary_batteries_[battery_index].no_response_count < MAX_NO_RESPONSE_COUNT) {
-      this->publish_state_(this->secondary_batteries_[battery_index].online_status, true);
+    if (this->batteries_[battery_index].no_response_count < MAX_NO_RESPONSE_COUNT) {
+      this->publish_state_(this->batteries_[battery_index].binary_sensors[BATTERY_ONLINE_STATUS], true);
     }
   }
 }
@@ -648,481 +1101,105 @@ void EcoworthyBms::publish_device_unavailable_() {
 
 void EcoworthyBms::publish_device_unavailable_(uint8_t battery_index) {
   if (battery_index > 0 && battery_index < MAX_BATTERIES) {
-    SecondaryBatterySensors &bat = this->secondary_batteries_[battery_index];
-    this->publish_state_(bat.online_status, false);
+    BatterySensors &bat = this->batteries_[battery_index];
+    this->publish_state_(bat.binary_sensors[BATTERY_ONLINE_STATUS], false);
     ESP_LOGW(TAG, "No response from battery %d (address 0x%02X)", 
              battery_index + 1, this->address_ + battery_index);
   }
 }
 
-// Setter implementations for secondary battery sensors
-void EcoworthyBms::set_secondary_battery_sensor(uint8_t battery_index, const std::string &sensor_type, sensor::Sensor *s) {
-  if (battery_index == 0 || battery_index >= MAX_BATTERIES) return;
-  SecondaryBatterySensors &bat = this->secondary_batteries_[battery_index];
-  
-  // Voltage sensors
-  if (sensor_type == "total_voltage") bat.total_voltage = s;
-  else if (sensor_type == "min_cell_voltage") bat.min_cell_voltage = s;
-  else if (sensor_type == "max_cell_voltage") bat.max_cell_voltage = s;
-  else if (sensor_type == "delta_cell_voltage") bat.delta_cell_voltage = s;
-  else if (sensor_type == "average_cell_voltage") bat.average_cell_voltage = s;
-  else if (sensor_type == "min_voltage_cell") bat.min_voltage_cell = s;
-  else if (sensor_type == "max_voltage_cell") bat.max_voltage_cell = s;
-  // Cell voltages
-  else if (sensor_type.rfind("cell_voltage_", 0) == 0) {
-    int cell_num = std::stoi(sensor_type.substr(13)) - 1;
-    if (cell_num >= 0 && cell_num < 16) bat.cell_voltages[cell_num] = s;
-  }
-  // Current and power
-  else if (sensor_type == "current") bat.current = s;
-  else if (sensor_type == "power") bat.power = s;
-  else if (sensor_type == "charging_power") bat.charging_power = s;
-  else if (sensor_type == "discharging_power") bat.discharging_power = s;
-  // Temperature sensors
-  else if (sensor_type == "power_tube_temperature") bat.power_tube_temperature = s;
-  else if (sensor_type == "ambient_temperature") bat.ambient_temperature = s;
-  else if (sensor_type == "min_temperature") bat.min_temperature = s;
-  else if (sensor_type == "max_temperature") bat.max_temperature = s;
-  else if (sensor_type == "avg_temperature") bat.avg_temperature = s;
-  else if (sensor_type.rfind("temperature_sensor_", 0) == 0) {
-    int temp_num = std::stoi(sensor_type.substr(19)) - 1;
-    if (temp_num >= 0 && temp_num < 4) bat.temperature_sensors[temp_num] = s;
-  }
-  // Capacity
-  else if (sensor_type == "state_of_charge") bat.state_of_charge = s;
-  else if (sensor_type == "state_of_health") bat.state_of_health = s;
-  else if (sensor_type == "remaining_capacity") bat.remaining_capacity = s;
-  else if (sensor_type == "full_capacity") bat.full_capacity = s;
-  else if (sensor_type == "rated_capacity") bat.rated_capacity = s;
-  else if (sensor_type == "cycle_count") bat.cycle_count = s;
-  // Limits
-  else if (sensor_type == "charge_voltage_limit") bat.charge_voltage_limit = s;
-  else if (sensor_type == "charge_current_limit") bat.charge_current_limit = s;
-  else if (sensor_type == "discharge_voltage_limit") bat.discharge_voltage_limit = s;
-  else if (sensor_type == "discharge_current_limit") bat.discharge_current_limit = s;
-  // Status
-  else if (sensor_type == "cell_count") bat.cell_count = s;
-  else if (sensor_type == "temperature_sensor_count") bat.temperature_sensor_count = s;
-  else if (sensor_type == "fault_bitmask") bat.fault_bitmask = s;
-  else if (sensor_type == "alarm_bitmask") bat.alarm_bitmask = s;
-  else if (sensor_type == "mosfet_status_bitmask") bat.mosfet_status_bitmask = s;
-  else if (sensor_type == "balancing_bitmask") bat.balancing_bitmask = s;
-}
-
-void EcoworthyBms::set_secondary_battery_binary_sensor(uint8_t battery_index, const std::string &sensor_type, binary_sensor::BinarySensor *bs) {
-  if (battery_index == 0 || battery_index >= MAX_BATTERIES) return;
-  SecondaryBatterySensors &bat = this->secondary_batteries_[battery_index];
-  
-  if (sensor_type == "online_status") bat.online_status = bs;
-  else if (sensor_type == "charging") bat.charging = bs;
-  else if (sensor_type == "discharging") bat.discharging = bs;
-  else if (sensor_type == "charging_switch") bat.charging_switch = bs;
-  else if (sensor_type == "discharging_switch") bat.discharging_switch = bs;
-  else if (sensor_type == "balancing") bat.balancing = bs;
-}
-
-void EcoworthyBms::set_secondary_battery_text_sensor(uint8_t battery_index, const std::string &sensor_type, text_sensor::TextSensor *ts) {
-  if (battery_index == 0 || battery_index >= MAX_BATTERIES) return;
-  SecondaryBatterySensors &bat = this->secondary_batteries_[battery_index];
-  
-  if (sensor_type == "operation_status") bat.operation_status = ts;
-  else if (sensor_type == "fault") bat.fault = ts;
-  else if (sensor_type == "alarm") bat.alarm = ts;
-  else if (sensor_type == "serial_number") bat.serial_number = ts;
-  else if (sensor_type == "firmware_version") bat.firmware_version = ts;
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+// Each primary pack status response starts a new poll cycle
+void EcoworthyBms::publish_cycle_allocations_() {
+  const uint32_t count = ecoworthy_modbus::heap_allocation_count();
+  if (this->cycle_started_ && this->heap_allocations_sensor_ != nullptr) {
+    const uint32_t allocations = count - this->cycle_allocations_;
+    ESP_LOGV(TAG, "Heap allocations in the last poll cycle: %u", allocations);
+    this->heap_allocations_sensor_->publish_state(allocations);
+  }
+  // Read again so that publishing this sensor is not counted
+  this->cycle_allocations_ = ecoworthy_modbus::heap_allocation_count();
+  this->cycle_started_ = true;
 }
+#endif
 
-// Config block 1 (0x1C00) parsing
-void EcoworthyBms::on_config_1c00_data_(const std::vector<uint8_t> &data) {
-  const uint8_t *payload = &data[8];
-  size_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
-
-  auto get_16bit = [&](size_t i) -> uint16_t {
-    if (i + 1 >= data_length) return 0;
-    return (uint16_t(payload[i]) << 8) | uint16_t(payload[i + 1]);
-  };
-
-  ESP_LOGV(TAG, "Processing %d bytes of config 0x1C00 data", data_length);
-
-  // Ecoworthy layout differs from EG4 - offsets are shifted by 4 bytes
-  // Offset 0-3: Unknown/unused (zeros)
-  // Offset 4: Balance open voltage (mV)
-  uint16_t raw_balance = get_16bit(4);
-  float balance_voltage = raw_balance * 0.001f;
-  ESP_LOGD(TAG, "Balance voltage: raw=%u (0x%04X), value=%.3fV", raw_balance, raw_balance, balance_voltage);
-  this->publish_state_(this->balance_voltage_sensor_, balance_voltage);
-
-  // Offset 6: Balance difference voltage (mV)
-  uint16_t raw_diff = get_16bit(6);
-  float balance_diff = raw_diff * 0.001f;
-  ESP_LOGD(TAG, "Balance diff: raw=%u (0x%04X), value=%.3fV", raw_diff, raw_diff, balance_diff);
-  this->publish_state_(this->balance_difference_sensor_, balance_diff);
-
-  // Offset 8: Heater start temp °C = (val - 500) / 10
-  uint16_t raw_heater_start = get_16bit(8);
-  float heater_start = (raw_heater_start - 500) / 10.0f;
-  ESP_LOGD(TAG, "Heater start: raw=%u, value=%.1f°C", raw_heater_start, heater_start);
-  this->publish_state_(this->heater_start_temp_sensor_, heater_start);
-
-  // Offset 10: Heater stop temp °C = (val - 500) / 10
-  uint16_t raw_heater_stop = get_16bit(10);
-  float heater_stop = (raw_heater_stop - 500) / 10.0f;
-  ESP_LOGD(TAG, "Heater stop: raw=%u, value=%.1f°C", raw_heater_stop, heater_stop);
-  this->publish_state_(this->heater_stop_temp_sensor_, heater_stop);
-
-  // Offset 12: Full charge voltage V = val / 100
-  uint16_t raw_full_chg_v = get_16bit(12);
-  float full_chg_v = raw_full_chg_v / 100.0f;
-  ESP_LOGD(TAG, "Full charge voltage: raw=%u, value=%.2fV", raw_full_chg_v, full_chg_v);
-  this->publish_state_(this->full_charge_voltage_sensor_, full_chg_v);
-
-  // Offset 14: Full charge current A = val / 100 (centiamps)
-  uint16_t raw_full_chg_a = get_16bit(14);
-  float full_chg_a = raw_full_chg_a / 100.0f;
-  ESP_LOGD(TAG, "Full charge current: raw=%u, value=%.2fA", raw_full_chg_a, full_chg_a);
-  this->publish_state_(this->full_charge_current_sensor_, full_chg_a);
+// Config block 1 (0x1C00) text fields; numeric fields come from CONFIG_1C00_FIELDS
+void EcoworthyBms::on_config_1c00_data_(const ecoworthy_modbus::FrameView &frame) {
+  const size_t data_length = frame.data_length();
 
   // Offset 16-41: Serial number (26 bytes)
   if (data_length >= 42) {
-    std::string serial((char *)&payload[16], 26);
-    size_t end = serial.find('\0');
-    if (end != std::string::npos) serial = serial.substr(0, end);
-    ESP_LOGD(TAG, "Serial number: '%s'", serial.c_str());
+    char serial[26 + 1];
+    frame.get_string(16, 26, serial);
+    ESP_LOGD(TAG, "Serial number: '%s'", serial);
     this->publish_state_(this->bms_serial_number_text_sensor_, serial);
   }
 
   // Offset 46-51: Manufacturing date (year, month, day)
   // Note: Ecoworthy stores mfg date here, EG4 stores pack SN at different offset
   if (data_length >= 52) {
-    uint16_t year = get_16bit(46);
-    uint16_t month = get_16bit(48);
-    uint16_t day = get_16bit(50);
-    char date_str[16];
-    snprintf(date_str, sizeof(date_str), "%04u-%02u-%02u", year, month, day);
+    uint16_t year = frame.get_u16(46);
+    uint16_t month = frame.get_u16(48);
+    uint16_t day = frame.get_u16(50);
+    // Publish to pack_serial_number sensor as "Mfg: YYYY-MM-DD", sized for three 5 digit fields
+    char mfg_str[5 + 18] = "Mfg: ";
+    char *date_str = mfg_str + 5;
+    snprintf(date_str, sizeof(mfg_str) - 5, "%04u-%02u-%02u", year, month, day);
     ESP_LOGD(TAG, "Manufacturing date: %s", date_str);
-    // Publish to pack_serial_number sensor as "Mfg: YYYY-MM-DD"
-    this->publish_state_(this->pack_serial_number_text_sensor_, std::string("Mfg: ") + date_str);
+    this->publish_state_(this->pack_serial_number_text_sensor_, mfg_str);
   }
 
   // Offset 52: Manufacturer/Model code (12+ bytes)
   if (data_length >= 64) {
-    std::string manufacturer((char *)&payload[52], 12);
-    size_t end = manufacturer.find('\0');
-    if (end != std::string::npos) manufacturer = manufacturer.substr(0, end);
-    ESP_LOGD(TAG, "Manufacturer: '%s'", manufacturer.c_str());
+    char manufacturer[12 + 1];
+    frame.get_string(52, 12, manufacturer);
+    ESP_LOGD(TAG, "Manufacturer: '%s'", manufacturer);
     this->publish_state_(this->manufacturer_text_sensor_, manufacturer);
   }
 
-  // Remaining fields may be at different offsets or not present
-  // CAN/RS485 protocol and sleep settings need further analysis
-  if (data_length >= 80) {
-    // Offset 64: Sleep voltage V = val / 100
-    uint16_t raw_sleep_v = get_16bit(64);
-    float sleep_v = raw_sleep_v / 100.0f;
-    ESP_LOGD(TAG, "Sleep voltage: raw=%u, value=%.2fV", raw_sleep_v, sleep_v);
-    this->publish_state_(this->sleep_voltage_sensor_, sleep_v);
-  }
-
-  // Offset 66: Sleep delay (minutes)
-  if (data_length >= 68) {
-    uint16_t sleep_delay = get_16bit(66);
-    ESP_LOGD(TAG, "Sleep delay: %u min", sleep_delay);
-    this->publish_state_(this->sleep_delay_sensor_, sleep_delay);
-  }
-
   // Offset 68: Balance mode (0: voltage, 1: SOC)
   if (data_length >= 70) {
-    uint16_t balance_mode = get_16bit(68);
+    uint16_t balance_mode = frame.get_u16(68);
     this->publish_state_(this->balance_mode_text_sensor_, this->decode_balance_mode_(balance_mode));
   }
 }
 
-// Config block 2 (0x2000) parsing
-void EcoworthyBms::on_config_2000_data_(const std::vector<uint8_t> &data) {
-  const uint8_t *payload = &data[8];
-  size_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
-
-  auto get_16bit = [&](size_t i) -> uint16_t {
-    if (i + 1 >= data_length) return 0;
-    return (uint16_t(payload[i]) << 8) | uint16_t(payload[i + 1]);
-  };
-
-  auto get_32bit = [&](size_t i) -> uint32_t {
-    if (i + 3 >= data_length) return 0;
-    return (uint32_t(payload[i]) << 24) | (uint32_t(payload[i + 1]) << 16) | 
-           (uint32_t(payload[i + 2]) << 8) | uint32_t(payload[i + 3]);
-  };
-
-  ESP_LOGV(TAG, "Processing %d bytes of config 0x2000 data", data_length);
-
-  // Offset 12: Total charge (4 bytes) Ah = val / 100
-  if (data_length >= 16) {
-    float total_charge = get_32bit(12) / 100.0f;
-    this->publish_state_(this->total_charge_sensor_, total_charge);
-  }
-
-  // Offset 16: Total discharge (4 bytes) Ah = val / 100
-  if (data_length >= 20) {
-    float total_discharge = get_32bit(16) / 100.0f;
-    this->publish_state_(this->total_discharge_sensor_, total_discharge);
-  }
-
-  // Offset 32: Configured CVL V = val / 10
-  if (data_length >= 34) {
-    float cvl = get_16bit(32) / 10.0f;
-    this->publish_state_(this->configured_cvl_sensor_, cvl);
-  }
-
-  // Offset 34: Configured CCL A = val / 10
-  if (data_length >= 36) {
-    float ccl = get_16bit(34) / 10.0f;
-    this->publish_state_(this->configured_ccl_sensor_, ccl);
-  }
-
-  // Offset 36: Configured DVL V = val / 10
-  if (data_length >= 38) {
-    float dvl = get_16bit(36) / 10.0f;
-    this->publish_state_(this->configured_dvl_sensor_, dvl);
-  }
-
-  // Offset 38: Configured DCL A = val / 10
-  if (data_length >= 40) {
-    float dcl = get_16bit(38) / 10.0f;
-    this->publish_state_(this->configured_dcl_sensor_, dcl);
-  }
-
-  // Offset 44: Shunt resistance (μΩ)
-  if (data_length >= 46) {
-    float rsns = get_16bit(44);
-    this->publish_state_(this->shunt_resistance_sensor_, rsns);
-  }
-}
-
 // Product info (0x2810) parsing
-void EcoworthyBms::on_product_info_data_(const std::vector<uint8_t> &data) {
-  const uint8_t *payload = &data[8];
-  size_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
+void EcoworthyBms::on_product_info_data_(const ecoworthy_modbus::FrameView &frame) {
+  const size_t data_length = frame.data_length();
 
-  auto get_16bit = [&](size_t i) -> uint16_t {
-    if (i + 1 >= data_length) return 0;
-    return (uint16_t(payload[i]) << 8) | uint16_t(payload[i + 1]);
-  };
-
-  ESP_LOGV(TAG, "Processing %d bytes of product info data", data_length);
+  ESP_LOGV(TAG, "Processing %u bytes of product info data", (unsigned) data_length);
 
   // Offset 4: Hardware version (as text)
   if (data_length >= 6) {
-    uint16_t hw_version = get_16bit(4);
+    uint16_t hw_version = frame.get_u16(4);
     char hw_str[16];
     snprintf(hw_str, sizeof(hw_str), "v%d.%d", hw_version / 10, hw_version % 10);
-    this->publish_state_(this->hardware_version_text_sensor_, std::string(hw_str));
+    this->publish_state_(this->hardware_version_text_sensor_, hw_str);
   }
 
   // Offset 6-8: Firmware version (major.minor.patch)
   if (data_length >= 12) {
-    uint16_t fw_major = get_16bit(6);
-    uint16_t fw_minor = get_16bit(8);
-    uint16_t fw_patch = get_16bit(10);
+    uint16_t fw_major = frame.get_u16(6);
+    uint16_t fw_minor = frame.get_u16(8);
+    uint16_t fw_patch = frame.get_u16(10);
     char fw_str[32];
     snprintf(fw_str, sizeof(fw_str), "%d.%d.%d", fw_major, fw_minor, fw_patch);
     // Only update firmware from product info if not already set
-    if (this->firmware_text_sensor_ != nullptr && !this->firmware_text_sensor_->has_state()) {
-      this->publish_state_(this->firmware_text_sensor_, std::string(fw_str));
+    text_sensor::TextSensor *firmware_version = this->batteries_[0].text_sensors[BATTERY_FIRMWARE_VERSION];
+    if (firmware_version != nullptr && !firmware_version->has_state()) {
+      this->publish_state_(firmware_version, fw_str);
     }
   }
 
   // Offset 12-27: BMS model (16 bytes)
   if (data_length >= 28) {
-    std::string model((char *)&payload[12], 16);
-    size_t end = model.find('\0');
-    if (end != std::string::npos) model = model.substr(0, end);
+    char model[16 + 1];
+    frame.get_string(12, 16, model);
     this->publish_state_(this->bms_model_text_sensor_, model);
   }
 }
 
-// Protection parameters (0x1800) parsing
-void EcoworthyBms::on_protection_params_data_(const std::vector<uint8_t> &data) {
-  const uint8_t *payload = &data[8];
-  size_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
-
-  auto get_16bit = [&](size_t i) -> uint16_t {
-    if (i + 1 >= data_length) return 0;
-    return (uint16_t(payload[i]) << 8) | uint16_t(payload[i + 1]);
-  };
-
-  ESP_LOGV(TAG, "Processing %d bytes of protection params (0x1800) data", data_length);
-
-  // The 0x1800 block contains protection thresholds
-  // Based on reverse engineering, the layout appears to be:
-  // Offset 0: Cell OVP trigger (mV)
-  // Offset 2: Cell OVP release (mV)
-  // Offset 4: Unknown
-  // Offset 6: Cell OVP hard limit (mV)
-  // ...
-  // Offset 12: Cell UVP trigger (mV)
-  // Offset 14: Cell UVP release (mV)
-  // ...
-  // Offset 24: Pack OVP trigger (cV, divide by 100 for V)
-  // Offset 26: Pack OVP release (cV)
-  // ...
-  // Offset 36: Pack UVP trigger (cV)
-  // Offset 38: Pack UVP release (cV)
-
-  if (data_length >= 40) {
-    // Cell voltage protection thresholds (in mV, publish as V)
-    float cell_ovp_trigger = get_16bit(0) / 1000.0f;  // mV to V
-    float cell_ovp_release = get_16bit(2) / 1000.0f;
-    float cell_uvp_trigger = get_16bit(12) / 1000.0f;
-    float cell_uvp_release = get_16bit(14) / 1000.0f;
-    
-    this->publish_state_(this->cell_ovp_trigger_sensor_, cell_ovp_trigger);
-    this->publish_state_(this->cell_ovp_release_sensor_, cell_ovp_release);
-    this->publish_state_(this->cell_uvp_trigger_sensor_, cell_uvp_trigger);
-    this->publish_state_(this->cell_uvp_release_sensor_, cell_uvp_release);
-
-    ESP_LOGD(TAG, "Cell OVP: trigger=%.3fV, release=%.3fV", cell_ovp_trigger, cell_ovp_release);
-    ESP_LOGD(TAG, "Cell UVP: trigger=%.3fV, release=%.3fV", cell_uvp_trigger, cell_uvp_release);
-  }
-
-  if (data_length >= 40) {
-    // Pack voltage protection thresholds (in cV, publish as V)
-    float pack_ovp_trigger = get_16bit(24) / 100.0f;  // cV to V
-    float pack_ovp_release = get_16bit(26) / 100.0f;
-    float pack_uvp_trigger = get_16bit(36) / 100.0f;
-    float pack_uvp_release = get_16bit(38) / 100.0f;
-    
-    this->publish_state_(this->pack_ovp_trigger_sensor_, pack_ovp_trigger);
-    this->publish_state_(this->pack_ovp_release_sensor_, pack_ovp_release);
-    this->publish_state_(this->pack_uvp_trigger_sensor_, pack_uvp_trigger);
-    this->publish_state_(this->pack_uvp_release_sensor_, pack_uvp_release);
-
-    ESP_LOGD(TAG, "Pack OVP: trigger=%.2fV, release=%.2fV", pack_ovp_trigger, pack_ovp_release);
-    ESP_LOGD(TAG, "Pack UVP: trigger=%.2fV, release=%.2fV", pack_uvp_trigger, pack_uvp_release);
-  }
-
-  // Temperature protection thresholds
-  // Formula: temp_celsius = (raw - 500) / 10.0, delay_seconds = raw / 1000.0
-  if (data_length >= 136) {
-    // Charge over-temperature (offset 94-99)
-    float charge_ot_trigger = (get_16bit(94) - 500) / 10.0f;
-    float charge_ot_release = (get_16bit(96) - 500) / 10.0f;
-    float charge_ot_delay = get_16bit(98) / 1000.0f;
-    this->publish_state_(this->charge_ot_trigger_sensor_, charge_ot_trigger);
-    this->publish_state_(this->charge_ot_release_sensor_, charge_ot_release);
-    this->publish_state_(this->charge_ot_delay_sensor_, charge_ot_delay);
-    ESP_LOGD(TAG, "Charge OT: trigger=%.1f°C, release=%.1f°C, delay=%.0fs", 
-             charge_ot_trigger, charge_ot_release, charge_ot_delay);
-
-    // Charge under-temperature (offset 106-111)
-    float charge_ut_trigger = (get_16bit(106) - 500) / 10.0f;
-    float charge_ut_release = (get_16bit(108) - 500) / 10.0f;
-    float charge_ut_delay = get_16bit(110) / 1000.0f;
-    this->publish_state_(this->charge_ut_trigger_sensor_, charge_ut_trigger);
-    this->publish_state_(this->charge_ut_release_sensor_, charge_ut_release);
-    this->publish_state_(this->charge_ut_delay_sensor_, charge_ut_delay);
-    ESP_LOGD(TAG, "Charge UT: trigger=%.1f°C, release=%.1f°C, delay=%.0fs", 
-             charge_ut_trigger, charge_ut_release, charge_ut_delay);
-
-    // Discharge over-temperature (offset 118-123)
-    float discharge_ot_trigger = (get_16bit(118) - 500) / 10.0f;
-    float discharge_ot_release = (get_16bit(120) - 500) / 10.0f;
-    float discharge_ot_delay = get_16bit(122) / 1000.0f;
-    this->publish_state_(this->discharge_ot_trigger_sensor_, discharge_ot_trigger);
-    this->publish_state_(this->discharge_ot_release_sensor_, discharge_ot_release);
-    this->publish_state_(this->discharge_ot_delay_sensor_, discharge_ot_delay);
-    ESP_LOGD(TAG, "Discharge OT: trigger=%.1f°C, release=%.1f°C, delay=%.0fs", 
-             discharge_ot_trigger, discharge_ot_release, discharge_ot_delay);
-
-    // Discharge under-temperature (offset 130-135)
-    float discharge_ut_trigger = (get_16bit(130) - 500) / 10.0f;
-    float discharge_ut_release = (get_16bit(132) - 500) / 10.0f;
-    float discharge_ut_delay = get_16bit(134) / 1000.0f;
-    this->publish_state_(this->discharge_ut_trigger_sensor_, discharge_ut_trigger);
-    this->publish_state_(this->discharge_ut_release_sensor_, discharge_ut_release);
-    this->publish_state_(this->discharge_ut_delay_sensor_, discharge_ut_delay);
-    ESP_LOGD(TAG, "Discharge UT: trigger=%.1f°C, release=%.1f°C, delay=%.0fs", 
-             discharge_ut_trigger, discharge_ut_release, discharge_ut_delay);
-  }
-
-  // Current protection thresholds (offsets 48-87)
-  // Values stored in deciamps (dA), divide by 10 for Amps
-  // Delays stored in milliseconds, divide by 1000 for seconds
-  if (data_length >= 88) {
-    // OCC - Charge over-current (offsets 48-67)
-    float charge_oc_alarm = get_16bit(48) / 10.0f;           // e1: OCC alarm (dA)
-    float charge_oc_alarm_delay = get_16bit(52) / 1000.0f;   // e3: OCC alarm delay (ms)
-    float charge_oc_trigger = get_16bit(54) / 10.0f;         // e4: OCC protect L1 (dA)
-    float charge_oc_delay = get_16bit(56) / 1000.0f;         // e5: OCC protect delay (ms)
-    float charge_oc_recover = get_16bit(58);                 // e6: OCC recover delay (s)
-    float charge_oc2_trigger = get_16bit(62) / 10.0f;        // f1: OCC2 protect L2 (dA)
-    float charge_oc2_delay = get_16bit(64);                  // f2: OCC2 delay (ms)
-    
-    this->publish_state_(this->charge_oc_alarm_sensor_, charge_oc_alarm);
-    this->publish_state_(this->charge_oc_alarm_delay_sensor_, charge_oc_alarm_delay);
-    this->publish_state_(this->charge_oc_trigger_sensor_, charge_oc_trigger);
-    this->publish_state_(this->charge_oc_delay_sensor_, charge_oc_delay);
-    this->publish_state_(this->charge_oc_recover_delay_sensor_, charge_oc_recover);
-    this->publish_state_(this->charge_oc2_trigger_sensor_, charge_oc2_trigger);
-    this->publish_state_(this->charge_oc2_delay_sensor_, charge_oc2_delay);
-    
-    ESP_LOGD(TAG, "Charge OC: alarm=%.1fA, L1=%.1fA (%.1fs), L2=%.1fA (%dms)", 
-             charge_oc_alarm, charge_oc_trigger, charge_oc_delay, 
-             charge_oc2_trigger, (int)charge_oc2_delay);
-
-    // OCD - Discharge over-current (offsets 68-87)
-    float discharge_oc_alarm = get_16bit(68) / 10.0f;           // g1: OCD alarm (dA)
-    float discharge_oc_alarm_delay = get_16bit(72) / 1000.0f;   // g3: OCD alarm delay (ms)
-    float discharge_oc_trigger = get_16bit(74) / 10.0f;         // g4: OCD protect L1 (dA)
-    float discharge_oc_delay = get_16bit(76) / 1000.0f;         // g5: OCD protect delay (ms)
-    float discharge_oc_recover = get_16bit(78);                 // g6: OCD recover delay (s)
-    float discharge_oc2_trigger = get_16bit(82) / 10.0f;        // h1: OCD2 protect L2 (dA)
-    float discharge_oc2_delay = get_16bit(84);                  // h2: OCD2 delay (ms)
-    
-    this->publish_state_(this->discharge_oc_alarm_sensor_, discharge_oc_alarm);
-    this->publish_state_(this->discharge_oc_alarm_delay_sensor_, discharge_oc_alarm_delay);
-    this->publish_state_(this->discharge_oc_trigger_sensor_, discharge_oc_trigger);
-    this->publish_state_(this->discharge_oc_delay_sensor_, discharge_oc_delay);
-    this->publish_state_(this->discharge_oc_recover_delay_sensor_, discharge_oc_recover);
-    this->publish_state_(this->discharge_oc2_trigger_sensor_, discharge_oc2_trigger);
-    this->publish_state_(this->discharge_oc2_delay_sensor_, discharge_oc2_delay);
-    
-    ESP_LOGD(TAG, "Discharge OC: alarm=%.1fA, L1=%.1fA (%.1fs), L2=%.1fA (%dms)", 
-             discharge_oc_alarm, discharge_oc_trigger, discharge_oc_delay, 
-             discharge_oc2_trigger, (int)discharge_oc2_delay);
-  }
-}
-
-// Individual Pack Status (0x45) parsing - non-aggregated CCL/DCL
-void EcoworthyBms::on_individual_pack_status_data_(const std::vector<uint8_t> &data) {
-  const uint8_t *payload = &data[8];
-  size_t data_length = (uint16_t(data[6]) << 8) | uint16_t(data[7]);
-
-  auto get_16bit = [&](size_t i) -> uint16_t {
-    if (i + 1 >= data_length) return 0;
-    return (uint16_t(payload[i]) << 8) | uint16_t(payload[i + 1]);
-  };
-
-  ESP_LOGV(TAG, "Processing %d bytes of individual pack status (0x45) data", data_length);
-
-  // According to the reference implementation, the response is 100 bytes:
-  // - First 96 bytes are unused (same as PackStatus but we already have that)
-  // - Offset 96: Charge current limit (non-aggregated) - 2 bytes
-  // - Offset 98: Discharge current limit (non-aggregated) - 2 bytes
-  if (data_length >= 100) {
-    // CCL/DCL at offsets 96 and 98, in deciamps (A/10)
-    float individual_ccl = get_16bit(96) / 10.0f;
-    float individual_dcl = get_16bit(98) / 10.0f;
-    
-    this->publish_state_(this->individual_charge_current_limit_sensor_, individual_ccl);
-    this->publish_state_(this->individual_discharge_current_limit_sensor_, individual_dcl);
-    
-    ESP_LOGD(TAG, "Individual pack status: CCL=%.1fA, DCL=%.1fA (non-aggregated)", 
-             individual_ccl, individual_dcl);
-  } else {
-    ESP_LOGW(TAG, "Individual pack status response too short: %d bytes (expected 100)", data_length);
-  }
-}
-
 // MOS control methods
 void EcoworthyBms::set_charge_mos(bool state) {
   // MOS control register: bit 1 = charge MOS, bit 0 = discharge MOS
@@ -1133,8 +1210,8 @@ void EcoworthyBms::set_charge_mos(bool state) {
   
   ESP_LOGI(TAG, "Setting charge MOS to %s (mos_value=0x%02X)", state ? "ON" : "OFF", mos_value);
   
-  std::vector<uint8_t> data = {0x00, mos_value};
-  this->send_write(REG_MOS_CONTROL, REG_MOS_CONTROL, data);
+  const uint8_t data[] = {0x00, mos_value};
+  this->send_write(REG_MOS_CONTROL, REG_MOS_CONTROL, data, sizeof(data));
 }
 
 void EcoworthyBms::set_discharge_mos(bool state) {
@@ -1146,8 +1223,8 @@ void EcoworthyBms::set_discharge_mos(bool state) {
   
   ESP_LOGI(TAG, "Setting discharge MOS to %s (mos_value=0x%02X)", state ? "ON" : "OFF", mos_value);
   
-  std::vector<uint8_t> data = {0x00, mos_value};
-  this->send_write(REG_MOS_CONTROL, REG_MOS_CONTROL, data);
+  const uint8_t data[] = {0x00, mos_value};
+  this->send_write(REG_MOS_CONTROL, REG_MOS_CONTROL, data, sizeof(data));
 }
 
 void EcoworthyBms::set_sleep_mode(uint8_t mode) {
@@ -1155,8 +1232,8 @@ void EcoworthyBms::set_sleep_mode(uint8_t mode) {
   uint16_t command = 0xA500 | mode;
   ESP_LOGI(TAG, "Setting sleep mode to %s (0x%04X)", mode == 1 ? "standby" : "deep", command);
   
-  std::vector<uint8_t> data = {(uint8_t)(command >> 8), (uint8_t)(command & 0xFF)};
-  this->send_write(REG_SLEEP_MODE, REG_SLEEP_MODE, data);
+  const uint8_t data[] = {(uint8_t)(command >> 8), (uint8_t)(command & 0xFF)};
+  this->send_write(REG_SLEEP_MODE, REG_SLEEP_MODE, data, sizeof(data));
 }
 
 void EcoworthyBms::trip_breaker() {
@@ -1165,8 +1242,8 @@ void EcoworthyBms::trip_breaker() {
   // Value 0x0008 = trip the breaker (trips all attached batteries)
   ESP_LOGW(TAG, "TRIPPING BREAKER - emergency disconnect!");
   
-  std::vector<uint8_t> data = {0x00, 0x08};  // Trip bit (bit 3) set
-  this->send_write(REG_DRY_CONTACT, REG_DRY_CONTACT + 2, data);
+  const uint8_t data[] = {0x00, 0x08};  // Trip bit (bit 3) set
+  this->send_write(REG_DRY_CONTACT, REG_DRY_CONTACT + 2, data, sizeof(data));
 }
 
 // Switch implementations (JK-BMS naming convention)
@@ -1203,8 +1280,14 @@ void TripButton::press_action() {
   }
 }
 
+void DumpHistoryButton::press_action() {
+  if (this->parent_ != nullptr) {
+    this->parent_->dump_history();
+  }
+}
+
 // Decoder methods
-std::string EcoworthyBms::decode_balance_mode_(uint16_t mode) {
+const char *EcoworthyBms::decode_balance_mode_(uint16_t mode) {
   switch (mode) {
     case 0: return "Voltage";
     case 1: return "SOC";
@@ -1212,7 +1295,7 @@ std::string EcoworthyBms::decode_balance_mode_(uint16_t mode) {
   }
 }
 
-std::string EcoworthyBms::decode_can_protocol_(uint16_t protocol) {
+const char *EcoworthyBms::decode_can_protocol_(uint16_t protocol) {
   switch (protocol) {
     case 0: return "PYLON";
     case 1: return "SMA";
@@ -1222,15 +1305,15 @@ std::string EcoworthyBms::decode_can_protocol_(uint16_t protocol) {
     case 5: return "Deye";
     case 6: return "Sofar";
     case 7: return "Solis";
-    default: return "Unknown (" + std::to_string(protocol) + ")";
+    default: return "Unknown";
   }
 }
 
-std::string EcoworthyBms::decode_rs485_protocol_(uint16_t protocol) {
+const char *EcoworthyBms::decode_rs485_protocol_(uint16_t protocol) {
   switch (protocol) {
     case 0: return "Standard Modbus";
     case 1: return "PACE";
-    default: return "Unknown (" + std::to_string(protocol) + ")";
+    default: return "Unknown";
   }
 }
 
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
 #include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"
 #include "esphome/components/switch/switch.h"
 #include "esphome/components/button/button.h"
 #include "esphome/components/ecoworthy_modbus/ecoworthy_modbus.h"
+#include "pack_history.h"
 
 namespace esphome {
 namespace ecoworthy_bms {
@@ -55,225 +61,428 @@ class TripButton : public button::Button, public Component {
   EcoworthyBms *parent_;
 };
 
-// Structure to hold per-battery sensors for secondary batteries
-struct SecondaryBatterySensors {
-  // Voltage sensors
-  sensor::Sensor *total_voltage{nullptr};
-  sensor::Sensor *min_cell_voltage{nullptr};
-  sensor::Sensor *max_cell_voltage{nullptr};
-  sensor::Sensor *delta_cell_voltage{nullptr};
-  sensor::Sensor *average_cell_voltage{nullptr};
-  sensor::Sensor *min_voltage_cell{nullptr};
-  sensor::Sensor *max_voltage_cell{nullptr};
-  sensor::Sensor *cell_voltages[16]{nullptr};
-  
-  // Current and power
-  sensor::Sensor *current{nullptr};
-  sensor::Sensor *power{nullptr};
-  sensor::Sensor *charging_power{nullptr};
-  sensor::Sensor *discharging_power{nullptr};
-  
-  // Temperature sensors
-  sensor::Sensor *power_tube_temperature{nullptr};
-  sensor::Sensor *ambient_temperature{nullptr};
-  sensor::Sensor *min_temperature{nullptr};
-  sensor::Sensor *max_temperature{nullptr};
-  sensor::Sensor *avg_temperature{nullptr};
-  sensor::Sensor *temperature_sensors[4]{nullptr};
-  
-  // Capacity
-  sensor::Sensor *state_of_charge{nullptr};
-  sensor::Sensor *state_of_health{nullptr};
-  sensor::Sensor *remaining_capacity{nullptr};
-  sensor::Sensor *full_capacity{nullptr};
-  sensor::Sensor *rated_capacity{nullptr};
-  sensor::Sensor *cycle_count{nullptr};
-  
-  // Limits (dynamic from Pack Status)
-  sensor::Sensor *charge_voltage_limit{nullptr};
-  sensor::Sensor *charge_current_limit{nullptr};
-  sensor::Sensor *discharge_voltage_limit{nullptr};
-  sensor::Sensor *discharge_current_limit{nullptr};
-  
-  // Status
-  sensor::Sensor *cell_count{nullptr};
-  sensor::Sensor *temperature_sensor_count{nullptr};
-  sensor::Sensor *fault_bitmask{nullptr};
-  sensor::Sensor *alarm_bitmask{nullptr};
-  sensor::Sensor *mosfet_status_bitmask{nullptr};
-  sensor::Sensor *balancing_bitmask{nullptr};
-  
-  // Binary sensors
-  binary_sensor::BinarySensor *online_status{nullptr};
-  binary_sensor::BinarySensor *charging{nullptr};
-  binary_sensor::BinarySensor *discharging{nullptr};
-  binary_sensor::BinarySensor *charging_switch{nullptr};
-  binary_sensor::BinarySensor *discharging_switch{nullptr};
-  binary_sensor::BinarySensor *balancing{nullptr};
-  
-  // Text sensors
-  text_sensor::TextSensor *operation_status{nullptr};
-  text_sensor::TextSensor *fault{nullptr};
-  text_sensor::TextSensor *alarm{nullptr};
-  text_sensor::TextSensor *serial_number{nullptr};
-  text_sensor::TextSensor *firmware_version{nullptr};
-  
-  uint8_t no_response_count{0};
+class DumpHistoryButton : public button::Button, public Component {
+ public:
+  void set_parent(EcoworthyBms *parent) { this->parent_ = parent; }
+  void press_action() override;
+ protected:
+  EcoworthyBms *parent_;
+};
+
+// Numeric pack status fields decoded straight from a register, in the order of the pack status
+// field table
+enum PackField : uint8_t {
+  PACK_TOTAL_VOLTAGE,
+  PACK_CURRENT,
+  PACK_STATE_OF_CHARGE,
+  PACK_REMAINING_CAPACITY,
+  PACK_FULL_CAPACITY,
+  PACK_RATED_CAPACITY,
+  PACK_POWER_TUBE_TEMPERATURE,
+  PACK_AMBIENT_TEMPERATURE,
+  PACK_STATE_OF_HEALTH,
+  PACK_FAULT_BITMASK,
+  PACK_ALARM_BITMASK,
+  PACK_MOSFET_STATUS_BITMASK,
+  PACK_CYCLE_COUNT,
+  PACK_MAX_VOLTAGE_CELL,
+  PACK_MAX_CELL_VOLTAGE,
+  PACK_MIN_VOLTAGE_CELL,
+  PACK_MIN_CELL_VOLTAGE,
+  PACK_AVERAGE_CELL_VOLTAGE,
+  PACK_MAX_TEMPERATURE,
+  PACK_MIN_TEMPERATURE,
+  PACK_AVG_TEMPERATURE,
+  PACK_CHARGE_VOLTAGE_LIMIT,
+  PACK_CHARGE_CURRENT_LIMIT,
+  PACK_DISCHARGE_VOLTAGE_LIMIT,
+  PACK_DISCHARGE_CURRENT_LIMIT,
+  PACK_CELL_COUNT,
+  PACK_FIELD_COUNT,
+};
+
+// Numeric fields of the primary's config blocks (0x1C00, 0x2000, 0x1800) and of 0x45
+enum ParamField : uint8_t {
+  // 0x1C00
+  PARAM_BALANCE_VOLTAGE,
+  PARAM_BALANCE_DIFFERENCE,
+  PARAM_HEATER_START_TEMP,
+  PARAM_HEATER_STOP_TEMP,
+  PARAM_FULL_CHARGE_VOLTAGE,
+  PARAM_FULL_CHARGE_CURRENT,
+  PARAM_SLEEP_VOLTAGE,
+  PARAM_SLEEP_DELAY,
+  // 0x2000
+  PARAM_TOTAL_CHARGE,
+  PARAM_TOTAL_DISCHARGE,
+  PARAM_CONFIGURED_CVL,
+  PARAM_CONFIGURED_CCL,
+  PARAM_CONFIGURED_DVL,
+  PARAM_CONFIGURED_DCL,
+  PARAM_SHUNT_RESISTANCE,
+  // 0x1800
+  PARAM_CELL_OVP_TRIGGER,
+  PARAM_CELL_OVP_RELEASE,
+  PARAM_CELL_UVP_TRIGGER,
+  PARAM_CELL_UVP_RELEASE,
+  PARAM_PACK_OVP_TRIGGER,
+  PARAM_PACK_OVP_RELEASE,
+  PARAM_PACK_UVP_TRIGGER,
+  PARAM_PACK_UVP_RELEASE,
+  PARAM_CHARGE_OC_ALARM,
+  PARAM_CHARGE_OC_ALARM_DELAY,
+  PARAM_CHARGE_OC_TRIGGER,
+  PARAM_CHARGE_OC_DELAY,
+  PARAM_CHARGE_OC_RECOVER_DELAY,
+  PARAM_CHARGE_OC2_TRIGGER,
+  PARAM_CHARGE_OC2_DELAY,
+  PARAM_DISCHARGE_OC_ALARM,
+  PARAM_DISCHARGE_OC_ALARM_DELAY,
+  PARAM_DISCHARGE_OC_TRIGGER,
+  PARAM_DISCHARGE_OC_DELAY,
+  PARAM_DISCHARGE_OC_RECOVER_DELAY,
+  PARAM_DISCHARGE_OC2_TRIGGER,
+  PARAM_DISCHARGE_OC2_DELAY,
+  PARAM_CHARGE_OT_TRIGGER,
+  PARAM_CHARGE_OT_RELEASE,
+  PARAM_CHARGE_OT_DELAY,
+  PARAM_CHARGE_UT_TRIGGER,
+  PARAM_CHARGE_UT_RELEASE,
+  PARAM_CHARGE_UT_DELAY,
+  PARAM_DISCHARGE_OT_TRIGGER,
+  PARAM_DISCHARGE_OT_RELEASE,
+  PARAM_DISCHARGE_OT_DELAY,
+  PARAM_DISCHARGE_UT_TRIGGER,
+  PARAM_DISCHARGE_UT_RELEASE,
+  PARAM_DISCHARGE_UT_DELAY,
+  // 0x45
+  PARAM_INDIVIDUAL_CHARGE_CURRENT_LIMIT,
+  PARAM_INDIVIDUAL_DISCHARGE_CURRENT_LIMIT,
+  PARAM_FIELD_COUNT,
 };
 
+// Describes one register field; defined with the field tables in ecoworthy_bms.cpp
+struct RegisterField;
+
+// Pack status sensors that are not a single register field. They continue the PackField
+// numbering, so one array per battery holds every sensor.
+enum BatterySensorSlot : uint8_t {
+  // Derived from several fields
+  BATTERY_POWER = PACK_FIELD_COUNT,
+  BATTERY_CHARGING_POWER,
+  BATTERY_DISCHARGING_POWER,
+  BATTERY_DELTA_CELL_VOLTAGE,
+  // Behind the cell voltages, so their position depends on the cell count
+  BATTERY_TEMPERATURE_SENSOR_COUNT,
+  BATTERY_BALANCING_BITMASK,
+  BATTERY_CELL_VOLTAGES,                                      // 16 slots
+  BATTERY_TEMPERATURE_SENSORS = BATTERY_CELL_VOLTAGES + 16,  // 4 slots
+  BATTERY_SENSOR_COUNT = BATTERY_TEMPERATURE_SENSORS + 4,
+};
+
+enum BatteryBinarySensor : uint8_t {
+  BATTERY_ONLINE_STATUS,  // Secondaries only
+  BATTERY_CHARGING,
+  BATTERY_DISCHARGING,
+  BATTERY_CHARGING_SWITCH,
+  BATTERY_DISCHARGING_SWITCH,
+  BATTERY_BALANCING,
+  BATTERY_BINARY_SENSOR_COUNT,
+};
+
+enum BatteryTextSensor : uint8_t {
+  BATTERY_OPERATION_STATUS,
+  BATTERY_FAULT,
+  BATTERY_ALARM,
+  BATTERY_SERIAL_NUMBER,
+  BATTERY_FIRMWARE_VERSION,
+  BATTERY_TEXT_SENSOR_COUNT,
+};
+
+// Pack status sensors of one battery. The primary and the secondaries share this layout, so one
+// decoder serves them all.
+struct BatterySensors {
+  sensor::Sensor *sensors[BATTERY_SENSOR_COUNT]{};  // Indexed by PackField and BatterySensorSlot
+  binary_sensor::BinarySensor *binary_sensors[BATTERY_BINARY_SENSOR_COUNT]{};
+  text_sensor::TextSensor *text_sensors[BATTERY_TEXT_SENSOR_COUNT]{};
+  // Raw value (status code, bitmask, firmware word or serial hash) behind each text sensor's last
+  // publish, so text is only decoded and published again when it changes
+  uint32_t text_keys[BATTERY_TEXT_SENSOR_COUNT]{};
+
+  uint8_t no_response_count{0};  // Secondaries only
+};
+
+// Last decoded pack status of one battery, for lambdas and other components that want the values
+// without going through sensor entities. Fields a response did not cover keep their previous value.
+struct PackStatus {
+  uint32_t timestamp{0};    // millis() of the last response
+  uint16_t data_length{0};  // Data bytes of the last full response; 0 until the first one arrives
+  bool fast{false};         // The last response was a fast read, which only updates the first fields
+
+  float values[PACK_FIELD_COUNT];  // Indexed by PackField, in sensor units; NaN until read
+  uint16_t operation_status{0};    // 0 idle, 1 charging, 2 discharging
+  uint32_t fault_bitmask{0};
+  uint32_t alarm_bitmask{0};
+  uint16_t mosfet_status{0};        // Bit 0 discharge MOS, bit 1 charge MOS
+  uint16_t cell_voltages_mv[16]{};  // Out-of-range readings are stored as 0
+
+  // Behind the cell voltages; each flag is set once a response reached that part
+  bool has_temperatures{false};
+  bool has_balancing{false};
+  bool has_firmware_version{false};
+  bool has_serial_number{false};
+  uint16_t temperature_count{0};
+  float temperatures[4];  // NaN for sensors the pack does not report
+  uint16_t balancing_bitmask{0};
+  uint16_t firmware_version{0};  // Major version in the high byte
+  char serial_number[31]{};
+
+  PackStatus() {
+    std::fill(std::begin(this->values), std::end(this->values), NAN);
+    std::fill(std::begin(this->temperatures), std::end(this->temperatures), NAN);
+  }
+  bool has_data() const { return this->data_length != 0; }
+  float get(PackField field) const { return this->values[field]; }
+  float power() const { return this->values[PACK_TOTAL_VOLTAGE] * this->values[PACK_CURRENT]; }
+};
+
+// Last decoded config blocks of the primary
+struct PackConfig {
+  uint32_t timestamp{0};  // millis() of the last config block response
+  float values[PARAM_FIELD_COUNT];  // Indexed by ParamField; NaN until its block was read
+
+  PackConfig() { std::fill(std::begin(this->values), std::end(this->values), NAN); }
+  float get(ParamField field) const { return this->values[field]; }
+};
+
+enum PollMode : uint8_t {
+  POLL_MODE_INTERVAL = 0,    // One request per update_interval
+  POLL_MODE_CONTINUOUS = 1,  // Next request as soon as the bus is idle
+};
+
+// Writes the names of the set fault or alarm bits into buffer and returns it, or returns "None" if no bit
+// is set. 320 bytes hold every name.
+const char *decode_fault_bits(uint32_t bits, char *buffer, size_t size);
+const char *decode_alarm_bits(uint32_t bits, char *buffer, size_t size);
+
 class EcoworthyBms : public PollingComponent, public ecoworthy_modbus::EcoworthyModbusDevice {
  public:
   static constexpr uint8_t MAX_BATTERIES = 16;
+  static constexpr uint8_t CONFIG_BLOCK_SLOTS = 5;  // Config blocks read from the primary
   
   // Battery count configuration
-  void set_battery_count(uint8_t count) { battery_count_ = count; }
+  void set_battery_count(uint8_t count) {
+    battery_count_ = count;
+    this->set_address_count(count);
+  }
   uint8_t get_battery_count() const { return battery_count_; }
+  // Always request complete register blocks instead of only the part configured sensors need
+  void set_read_full_blocks(bool read_full_blocks) { this->read_full_blocks_ = read_full_blocks; }
+  void set_poll_mode(PollMode poll_mode) { this->poll_mode_ = poll_mode; }
+  // Target refresh intervals in ms. Config blocks are indexed 0x1C00, 0x2000, product info, 0x1800,
+  // individual pack status.
+  void set_pack_status_interval(uint32_t interval) { this->pack_status_interval_ = interval; }
+  // Short reads of total voltage, current and SOC in between the pack status reads; 0 disables them
+  void set_fast_pack_status_interval(uint32_t interval) { this->fast_pack_status_interval_ = interval; }
+  void set_config_block_interval(uint8_t block, uint32_t interval) { this->config_intervals_[block] = interval; }
+  // Skip publishing values that did not change at the sensor's accuracy; every block is still
+  // published in full once per heartbeat interval
+  void set_publish_changes_only(bool publish_changes_only) { this->publish_changes_only_ = publish_changes_only; }
+  void set_heartbeat_interval(uint32_t heartbeat_interval) { this->heartbeat_interval_ = heartbeat_interval; }
+  // With publish_changes_only, publish the pack status sensors in slots first .. first + count - 1 only once
+  // they moved more than deadband from the last published value, instead of comparing at accuracy_decimals.
+  // Applies to every battery.
+  void set_deadband(uint8_t first, uint8_t count, float deadband) {
+    for (uint8_t slot = first; slot < first + count && slot < BATTERY_SENSOR_COUNT; slot++)
+      this->deadbands_[slot] = deadband;
+  }
+  void set_suppressed_publishes_sensor(sensor::Sensor *s) { suppressed_publishes_sensor_ = s; }
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+  // Heap allocations between two primary pack status responses, i.e. per poll cycle
+  void set_heap_allocations_sensor(sensor::Sensor *s) { heap_allocations_sensor_ = s; }
+#endif
+
+  // Decoded data. get_pack_status() returns nullptr for indices past the battery count; the callback
+  // runs after each pack status response has been decoded and published. Registering a callback makes
+  // every pack status read cover the whole block, even if it happens after setup().
+  const PackStatus *get_pack_status(uint8_t battery_index) const {
+    return battery_index < this->battery_count_ ? &this->pack_status_[battery_index] : nullptr;
+  }
+  const PackConfig &get_pack_config() const { return this->pack_config_; }
+  void add_on_pack_status_callback(std::function<void(uint8_t, const PackStatus &)> &&callback);
   
-  // Secondary battery sensor setters (battery_index is 0-based, 0=primary uses main sensors)
-  void set_secondary_battery_sensor(uint8_t battery_index, const std::string &sensor_type, sensor::Sensor *s);
-  void set_secondary_battery_binary_sensor(uint8_t battery_index, const std::string &sensor_type, binary_sensor::BinarySensor *bs);
-  void set_secondary_battery_text_sensor(uint8_t battery_index, const std::string &sensor_type, text_sensor::TextSensor *ts);
-  
+  // Secondary battery sensor setters, generated with slot ids (battery_index is 0-based; 0 is the
+  // primary, which uses the named setters below)
+  void set_secondary_battery_sensor(uint8_t battery_index, uint8_t slot, sensor::Sensor *s) {
+    if (battery_index > 0 && battery_index < MAX_BATTERIES && slot < BATTERY_SENSOR_COUNT)
+      this->batteries_[battery_index].sensors[slot] = s;
+  }
+  void set_secondary_cell_voltage_sensor(uint8_t battery_index, uint8_t cell, sensor::Sensor *s) {
+    if (cell < 16)
+      this->set_secondary_battery_sensor(battery_index, BATTERY_CELL_VOLTAGES + cell, s);
+  }
+  void set_secondary_temperature_sensor(uint8_t battery_index, uint8_t temp, sensor::Sensor *s) {
+    if (temp < 4)
+      this->set_secondary_battery_sensor(battery_index, BATTERY_TEMPERATURE_SENSORS + temp, s);
+  }
+  void set_secondary_battery_binary_sensor(uint8_t battery_index, BatteryBinarySensor slot,
+                                           binary_sensor::BinarySensor *bs) {
+    if (battery_index > 0 && battery_index < MAX_BATTERIES && slot < BATTERY_BINARY_SENSOR_COUNT)
+      this->batteries_[battery_index].binary_sensors[slot] = bs;
+  }
+  void set_secondary_battery_text_sensor(uint8_t battery_index, BatteryTextSensor slot, text_sensor::TextSensor *ts) {
+    if (battery_index > 0 && battery_index < MAX_BATTERIES && slot < BATTERY_TEXT_SENSOR_COUNT)
+      this->batteries_[battery_index].text_sensors[slot] = ts;
+  }
+
   // Binary sensors
   void set_online_status_binary_sensor(binary_sensor::BinarySensor *online_status) {
     online_status_binary_sensor_ = online_status;
   }
-  void set_charging_binary_sensor(binary_sensor::BinarySensor *charging) { charging_binary_sensor_ = charging; }
-  void set_discharging_binary_sensor(binary_sensor::BinarySensor *discharging) {
-    discharging_binary_sensor_ = discharging;
+  void set_charging_binary_sensor(binary_sensor::BinarySensor *charging) {
+    this->batteries_[0].binary_sensors[BATTERY_CHARGING] = charging;
   }
-  void set_charging_switch_binary_sensor(binary_sensor::BinarySensor *charging_switch) { charging_switch_binary_sensor_ = charging_switch; }
-  void set_discharging_switch_binary_sensor(binary_sensor::BinarySensor *discharging_switch) { discharging_switch_binary_sensor_ = discharging_switch; }
-  void set_balancing_binary_sensor(binary_sensor::BinarySensor *balancing) { balancing_binary_sensor_ = balancing; }
-
-  // Voltage sensors
-  void set_total_voltage_sensor(sensor::Sensor *total_voltage) { total_voltage_sensor_ = total_voltage; }
-  void set_cell_voltage_sensor(uint8_t cell, sensor::Sensor *cell_voltage) {
-    this->cells_[cell].cell_voltage_sensor_ = cell_voltage;
+  void set_discharging_binary_sensor(binary_sensor::BinarySensor *discharging) {
+    this->batteries_[0].binary_sensors[BATTERY_DISCHARGING] = discharging;
   }
-  void set_min_cell_voltage_sensor(sensor::Sensor *min_cell_voltage) { min_cell_voltage_sensor_ = min_cell_voltage; }
-  void set_max_cell_voltage_sensor(sensor::Sensor *max_cell_voltage) { max_cell_voltage_sensor_ = max_cell_voltage; }
-  void set_delta_cell_voltage_sensor(sensor::Sensor *delta_cell_voltage) {
-    delta_cell_voltage_sensor_ = delta_cell_voltage;
+  void set_charging_switch_binary_sensor(binary_sensor::BinarySensor *charging_switch) {
+    this->batteries_[0].binary_sensors[BATTERY_CHARGING_SWITCH] = charging_switch;
   }
-  void set_average_cell_voltage_sensor(sensor::Sensor *average_cell_voltage) {
-    average_cell_voltage_sensor_ = average_cell_voltage;
+  void set_discharging_switch_binary_sensor(binary_sensor::BinarySensor *discharging_switch) {
+    this->batteries_[0].binary_sensors[BATTERY_DISCHARGING_SWITCH] = discharging_switch;
   }
-  void set_min_voltage_cell_sensor(sensor::Sensor *min_voltage_cell) {
-    min_voltage_cell_sensor_ = min_voltage_cell;
+  void set_balancing_binary_sensor(binary_sensor::BinarySensor *balancing) {
+    this->batteries_[0].binary_sensors[BATTERY_BALANCING] = balancing;
   }
-  void set_max_voltage_cell_sensor(sensor::Sensor *max_voltage_cell) {
-    max_voltage_cell_sensor_ = max_voltage_cell;
+
+  // Pack status sensors of the primary
+  void set_pack_sensor(uint8_t slot, sensor::Sensor *s) { this->batteries_[0].sensors[slot] = s; }
+  void set_total_voltage_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_TOTAL_VOLTAGE, s); }
+  void set_cell_voltage_sensor(uint8_t cell, sensor::Sensor *cell_voltage) {
+    this->set_pack_sensor(BATTERY_CELL_VOLTAGES + cell, cell_voltage);
   }
+  void set_min_cell_voltage_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MIN_CELL_VOLTAGE, s); }
+  void set_max_cell_voltage_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MAX_CELL_VOLTAGE, s); }
+  void set_delta_cell_voltage_sensor(sensor::Sensor *s) { this->set_pack_sensor(BATTERY_DELTA_CELL_VOLTAGE, s); }
+  void set_average_cell_voltage_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_AVERAGE_CELL_VOLTAGE, s); }
+  void set_min_voltage_cell_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MIN_VOLTAGE_CELL, s); }
+  void set_max_voltage_cell_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MAX_VOLTAGE_CELL, s); }
 
   // Current and power sensors
-  void set_current_sensor(sensor::Sensor *current) { current_sensor_ = current; }
-  void set_power_sensor(sensor::Sensor *power) { power_sensor_ = power; }
-  void set_charging_power_sensor(sensor::Sensor *charging_power) { charging_power_sensor_ = charging_power; }
-  void set_discharging_power_sensor(sensor::Sensor *discharging_power) {
-    discharging_power_sensor_ = discharging_power;
-  }
+  void set_current_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_CURRENT, s); }
+  void set_power_sensor(sensor::Sensor *s) { this->set_pack_sensor(BATTERY_POWER, s); }
+  void set_charging_power_sensor(sensor::Sensor *s) { this->set_pack_sensor(BATTERY_CHARGING_POWER, s); }
+  void set_discharging_power_sensor(sensor::Sensor *s) { this->set_pack_sensor(BATTERY_DISCHARGING_POWER, s); }
 
   // Temperature sensors
   void set_temperature_sensor(uint8_t temp, sensor::Sensor *temperature) {
-    this->temperatures_[temp].temperature_sensor_ = temperature;
+    this->set_pack_sensor(BATTERY_TEMPERATURE_SENSORS + temp, temperature);
   }
-  void set_power_tube_temperature_sensor(sensor::Sensor *power_tube_temp) { power_tube_temperature_sensor_ = power_tube_temp; }
-  void set_ambient_temperature_sensor(sensor::Sensor *ambient_temp) { ambient_temperature_sensor_ = ambient_temp; }
-  void set_min_temperature_sensor(sensor::Sensor *min_temp) { min_temperature_sensor_ = min_temp; }
-  void set_max_temperature_sensor(sensor::Sensor *max_temp) { max_temperature_sensor_ = max_temp; }
-  void set_avg_temperature_sensor(sensor::Sensor *avg_temp) { avg_temperature_sensor_ = avg_temp; }
+  void set_power_tube_temperature_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_POWER_TUBE_TEMPERATURE, s); }
+  void set_ambient_temperature_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_AMBIENT_TEMPERATURE, s); }
+  void set_min_temperature_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MIN_TEMPERATURE, s); }
+  void set_max_temperature_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MAX_TEMPERATURE, s); }
+  void set_avg_temperature_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_AVG_TEMPERATURE, s); }
 
   // Capacity sensors
-  void set_remaining_capacity_sensor(sensor::Sensor *remaining_capacity) {
-    remaining_capacity_sensor_ = remaining_capacity;
-  }
-  void set_full_capacity_sensor(sensor::Sensor *full_capacity) { full_capacity_sensor_ = full_capacity; }
-  void set_rated_capacity_sensor(sensor::Sensor *rated_capacity) { rated_capacity_sensor_ = rated_capacity; }
+  void set_remaining_capacity_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_REMAINING_CAPACITY, s); }
+  void set_full_capacity_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_FULL_CAPACITY, s); }
+  void set_rated_capacity_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_RATED_CAPACITY, s); }
 
   // State sensors
-  void set_state_of_charge_sensor(sensor::Sensor *soc) { state_of_charge_sensor_ = soc; }
-  void set_state_of_health_sensor(sensor::Sensor *soh) { state_of_health_sensor_ = soh; }
-  void set_cycle_count_sensor(sensor::Sensor *cycle_count) { cycle_count_sensor_ = cycle_count; }
-  void set_cell_count_sensor(sensor::Sensor *cell_count) { cell_count_sensor_ = cell_count; }
-  void set_temperature_sensor_count_sensor(sensor::Sensor *temp_count) { temperature_sensor_count_sensor_ = temp_count; }
+  void set_state_of_charge_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_STATE_OF_CHARGE, s); }
+  void set_state_of_health_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_STATE_OF_HEALTH, s); }
+  void set_cycle_count_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_CYCLE_COUNT, s); }
+  void set_cell_count_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_CELL_COUNT, s); }
+  void set_temperature_sensor_count_sensor(sensor::Sensor *s) {
+    this->set_pack_sensor(BATTERY_TEMPERATURE_SENSOR_COUNT, s);
+  }
 
   // Charge/Discharge limits
-  void set_charge_voltage_limit_sensor(sensor::Sensor *cvl) { charge_voltage_limit_sensor_ = cvl; }
-  void set_charge_current_limit_sensor(sensor::Sensor *ccl) { charge_current_limit_sensor_ = ccl; }
-  void set_discharge_voltage_limit_sensor(sensor::Sensor *dvl) { discharge_voltage_limit_sensor_ = dvl; }
-  void set_discharge_current_limit_sensor(sensor::Sensor *dcl) { discharge_current_limit_sensor_ = dcl; }
+  void set_charge_voltage_limit_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_CHARGE_VOLTAGE_LIMIT, s); }
+  void set_charge_current_limit_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_CHARGE_CURRENT_LIMIT, s); }
+  void set_discharge_voltage_limit_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_DISCHARGE_VOLTAGE_LIMIT, s); }
+  void set_discharge_current_limit_sensor(sensor::Sensor *s) {
+    this->set_pack_sensor(PACK_DISCHARGE_CURRENT_LIMIT, s);
+  }
 
   // Bitmask sensors
-  void set_fault_bitmask_sensor(sensor::Sensor *fault_bitmask) { fault_bitmask_sensor_ = fault_bitmask; }
-  void set_alarm_bitmask_sensor(sensor::Sensor *alarm_bitmask) { alarm_bitmask_sensor_ = alarm_bitmask; }
-  void set_mosfet_status_bitmask_sensor(sensor::Sensor *mosfet_bitmask) { mosfet_status_bitmask_sensor_ = mosfet_bitmask; }
-  void set_balancing_bitmask_sensor(sensor::Sensor *balancing_bitmask) { balancing_bitmask_sensor_ = balancing_bitmask; }
+  void set_fault_bitmask_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_FAULT_BITMASK, s); }
+  void set_alarm_bitmask_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_ALARM_BITMASK, s); }
+  void set_mosfet_status_bitmask_sensor(sensor::Sensor *s) { this->set_pack_sensor(PACK_MOSFET_STATUS_BITMASK, s); }
+  void set_balancing_bitmask_sensor(sensor::Sensor *s) { this->set_pack_sensor(BATTERY_BALANCING_BITMASK, s); }
 
   // Configuration sensors (from 0x1C00 and 0x2000 blocks)
-  void set_balance_voltage_sensor(sensor::Sensor *s) { balance_voltage_sensor_ = s; }
-  void set_balance_difference_sensor(sensor::Sensor *s) { balance_difference_sensor_ = s; }
-  void set_heater_start_temp_sensor(sensor::Sensor *s) { heater_start_temp_sensor_ = s; }
-  void set_heater_stop_temp_sensor(sensor::Sensor *s) { heater_stop_temp_sensor_ = s; }
-  void set_full_charge_voltage_sensor(sensor::Sensor *s) { full_charge_voltage_sensor_ = s; }
-  void set_full_charge_current_sensor(sensor::Sensor *s) { full_charge_current_sensor_ = s; }
-  void set_sleep_voltage_sensor(sensor::Sensor *s) { sleep_voltage_sensor_ = s; }
-  void set_sleep_delay_sensor(sensor::Sensor *s) { sleep_delay_sensor_ = s; }
-  void set_total_charge_sensor(sensor::Sensor *s) { total_charge_sensor_ = s; }
-  void set_total_discharge_sensor(sensor::Sensor *s) { total_discharge_sensor_ = s; }
-  void set_configured_cvl_sensor(sensor::Sensor *s) { configured_cvl_sensor_ = s; }
-  void set_configured_ccl_sensor(sensor::Sensor *s) { configured_ccl_sensor_ = s; }
-  void set_configured_dvl_sensor(sensor::Sensor *s) { configured_dvl_sensor_ = s; }
-  void set_configured_dcl_sensor(sensor::Sensor *s) { configured_dcl_sensor_ = s; }
-  void set_shunt_resistance_sensor(sensor::Sensor *s) { shunt_resistance_sensor_ = s; }
+  void set_param_sensor(ParamField field, sensor::Sensor *s) { this->param_sensors_[field] = s; }
+  void set_balance_voltage_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_BALANCE_VOLTAGE, s); }
+  void set_balance_difference_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_BALANCE_DIFFERENCE, s); }
+  void set_heater_start_temp_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_HEATER_START_TEMP, s); }
+  void set_heater_stop_temp_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_HEATER_STOP_TEMP, s); }
+  void set_full_charge_voltage_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_FULL_CHARGE_VOLTAGE, s); }
+  void set_full_charge_current_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_FULL_CHARGE_CURRENT, s); }
+  void set_sleep_voltage_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_SLEEP_VOLTAGE, s); }
+  void set_sleep_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_SLEEP_DELAY, s); }
+  void set_total_charge_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_TOTAL_CHARGE, s); }
+  void set_total_discharge_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_TOTAL_DISCHARGE, s); }
+  void set_configured_cvl_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CONFIGURED_CVL, s); }
+  void set_configured_ccl_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CONFIGURED_CCL, s); }
+  void set_configured_dvl_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CONFIGURED_DVL, s); }
+  void set_configured_dcl_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CONFIGURED_DCL, s); }
+  void set_shunt_resistance_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_SHUNT_RESISTANCE, s); }
 
   // Protection parameter sensors (from 0x1800 block)
-  void set_cell_ovp_trigger_sensor(sensor::Sensor *s) { cell_ovp_trigger_sensor_ = s; }
-  void set_cell_ovp_release_sensor(sensor::Sensor *s) { cell_ovp_release_sensor_ = s; }
-  void set_cell_uvp_trigger_sensor(sensor::Sensor *s) { cell_uvp_trigger_sensor_ = s; }
-  void set_cell_uvp_release_sensor(sensor::Sensor *s) { cell_uvp_release_sensor_ = s; }
-  void set_pack_ovp_trigger_sensor(sensor::Sensor *s) { pack_ovp_trigger_sensor_ = s; }
-  void set_pack_ovp_release_sensor(sensor::Sensor *s) { pack_ovp_release_sensor_ = s; }
-  void set_pack_uvp_trigger_sensor(sensor::Sensor *s) { pack_uvp_trigger_sensor_ = s; }
-  void set_pack_uvp_release_sensor(sensor::Sensor *s) { pack_uvp_release_sensor_ = s; }
+  void set_cell_ovp_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CELL_OVP_TRIGGER, s); }
+  void set_cell_ovp_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CELL_OVP_RELEASE, s); }
+  void set_cell_uvp_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CELL_UVP_TRIGGER, s); }
+  void set_cell_uvp_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CELL_UVP_RELEASE, s); }
+  void set_pack_ovp_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_PACK_OVP_TRIGGER, s); }
+  void set_pack_ovp_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_PACK_OVP_RELEASE, s); }
+  void set_pack_uvp_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_PACK_UVP_TRIGGER, s); }
+  void set_pack_uvp_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_PACK_UVP_RELEASE, s); }
   // Temperature protection sensors
-  void set_charge_ot_trigger_sensor(sensor::Sensor *s) { charge_ot_trigger_sensor_ = s; }
-  void set_charge_ot_release_sensor(sensor::Sensor *s) { charge_ot_release_sensor_ = s; }
-  void set_charge_ot_delay_sensor(sensor::Sensor *s) { charge_ot_delay_sensor_ = s; }
-  void set_charge_ut_trigger_sensor(sensor::Sensor *s) { charge_ut_trigger_sensor_ = s; }
-  void set_charge_ut_release_sensor(sensor::Sensor *s) { charge_ut_release_sensor_ = s; }
-  void set_charge_ut_delay_sensor(sensor::Sensor *s) { charge_ut_delay_sensor_ = s; }
-  void set_discharge_ot_trigger_sensor(sensor::Sensor *s) { discharge_ot_trigger_sensor_ = s; }
-  void set_discharge_ot_release_sensor(sensor::Sensor *s) { discharge_ot_release_sensor_ = s; }
-  void set_discharge_ot_delay_sensor(sensor::Sensor *s) { discharge_ot_delay_sensor_ = s; }
-  void set_discharge_ut_trigger_sensor(sensor::Sensor *s) { discharge_ut_trigger_sensor_ = s; }
-  void set_discharge_ut_release_sensor(sensor::Sensor *s) { discharge_ut_release_sensor_ = s; }
-  void set_discharge_ut_delay_sensor(sensor::Sensor *s) { discharge_ut_delay_sensor_ = s; }
+  void set_charge_ot_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OT_TRIGGER, s); }
+  void set_charge_ot_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OT_RELEASE, s); }
+  void set_charge_ot_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OT_DELAY, s); }
+  void set_charge_ut_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_UT_TRIGGER, s); }
+  void set_charge_ut_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_UT_RELEASE, s); }
+  void set_charge_ut_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_UT_DELAY, s); }
+  void set_discharge_ot_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OT_TRIGGER, s); }
+  void set_discharge_ot_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OT_RELEASE, s); }
+  void set_discharge_ot_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OT_DELAY, s); }
+  void set_discharge_ut_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_UT_TRIGGER, s); }
+  void set_discharge_ut_release_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_UT_RELEASE, s); }
+  void set_discharge_ut_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_UT_DELAY, s); }
   // Current protection sensors
-  void set_charge_oc_alarm_sensor(sensor::Sensor *s) { charge_oc_alarm_sensor_ = s; }
-  void set_charge_oc_alarm_delay_sensor(sensor::Sensor *s) { charge_oc_alarm_delay_sensor_ = s; }
-  void set_charge_oc_trigger_sensor(sensor::Sensor *s) { charge_oc_trigger_sensor_ = s; }
-  void set_charge_oc_delay_sensor(sensor::Sensor *s) { charge_oc_delay_sensor_ = s; }
-  void set_charge_oc_recover_delay_sensor(sensor::Sensor *s) { charge_oc_recover_delay_sensor_ = s; }
-  void set_charge_oc2_trigger_sensor(sensor::Sensor *s) { charge_oc2_trigger_sensor_ = s; }
-  void set_charge_oc2_delay_sensor(sensor::Sensor *s) { charge_oc2_delay_sensor_ = s; }
-  void set_discharge_oc_alarm_sensor(sensor::Sensor *s) { discharge_oc_alarm_sensor_ = s; }
-  void set_discharge_oc_alarm_delay_sensor(sensor::Sensor *s) { discharge_oc_alarm_delay_sensor_ = s; }
-  void set_discharge_oc_trigger_sensor(sensor::Sensor *s) { discharge_oc_trigger_sensor_ = s; }
-  void set_discharge_oc_delay_sensor(sensor::Sensor *s) { discharge_oc_delay_sensor_ = s; }
-  void set_discharge_oc_recover_delay_sensor(sensor::Sensor *s) { discharge_oc_recover_delay_sensor_ = s; }
-  void set_discharge_oc2_trigger_sensor(sensor::Sensor *s) { discharge_oc2_trigger_sensor_ = s; }
-  void set_discharge_oc2_delay_sensor(sensor::Sensor *s) { discharge_oc2_delay_sensor_ = s; }
+  void set_charge_oc_alarm_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC_ALARM, s); }
+  void set_charge_oc_alarm_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC_ALARM_DELAY, s); }
+  void set_charge_oc_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC_TRIGGER, s); }
+  void set_charge_oc_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC_DELAY, s); }
+  void set_charge_oc_recover_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC_RECOVER_DELAY, s); }
+  void set_charge_oc2_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC2_TRIGGER, s); }
+  void set_charge_oc2_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_CHARGE_OC2_DELAY, s); }
+  void set_discharge_oc_alarm_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC_ALARM, s); }
+  void set_discharge_oc_alarm_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC_ALARM_DELAY, s); }
+  void set_discharge_oc_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC_TRIGGER, s); }
+  void set_discharge_oc_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC_DELAY, s); }
+  void set_discharge_oc_recover_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC_RECOVER_DELAY, s); }
+  void set_discharge_oc2_trigger_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC2_TRIGGER, s); }
+  void set_discharge_oc2_delay_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_DISCHARGE_OC2_DELAY, s); }
   // Individual pack status (function 0x45) - non-aggregated current limits
-  void set_individual_charge_current_limit_sensor(sensor::Sensor *s) { individual_charge_current_limit_sensor_ = s; }
-  void set_individual_discharge_current_limit_sensor(sensor::Sensor *s) { individual_discharge_current_limit_sensor_ = s; }
+  void set_individual_charge_current_limit_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_INDIVIDUAL_CHARGE_CURRENT_LIMIT, s); }
+  void set_individual_discharge_current_limit_sensor(sensor::Sensor *s) { this->set_param_sensor(PARAM_INDIVIDUAL_DISCHARGE_CURRENT_LIMIT, s); }
 
   // Text sensors
-  void set_operation_status_text_sensor(text_sensor::TextSensor *operation_status) { operation_status_text_sensor_ = operation_status; }
-  void set_fault_text_sensor(text_sensor::TextSensor *fault) { fault_text_sensor_ = fault; }
-  void set_alarm_text_sensor(text_sensor::TextSensor *alarm) { alarm_text_sensor_ = alarm; }
-  void set_serial_number_text_sensor(text_sensor::TextSensor *serial) { serial_number_text_sensor_ = serial; }
-  void set_firmware_version_text_sensor(text_sensor::TextSensor *firmware) { firmware_text_sensor_ = firmware; }
+  void set_operation_status_text_sensor(text_sensor::TextSensor *s) {
+    this->batteries_[0].text_sensors[BATTERY_OPERATION_STATUS] = s;
+  }
+  void set_fault_text_sensor(text_sensor::TextSensor *s) { this->batteries_[0].text_sensors[BATTERY_FAULT] = s; }
+  void set_alarm_text_sensor(text_sensor::TextSensor *s) { this->batteries_[0].text_sensors[BATTERY_ALARM] = s; }
+  void set_serial_number_text_sensor(text_sensor::TextSensor *s) {
+    this->batteries_[0].text_sensors[BATTERY_SERIAL_NUMBER] = s;
+  }
+  void set_firmware_version_text_sensor(text_sensor::TextSensor *s) {
+    this->batteries_[0].text_sensors[BATTERY_FIRMWARE_VERSION] = s;
+  }
   void set_bms_serial_number_text_sensor(text_sensor::TextSensor *s) { bms_serial_number_text_sensor_ = s; }
   void set_pack_serial_number_text_sensor(text_sensor::TextSensor *s) { pack_serial_number_text_sensor_ = s; }
   void set_manufacturer_text_sensor(text_sensor::TextSensor *s) { manufacturer_text_sensor_ = s; }
@@ -291,11 +500,14 @@ class EcoworthyBms : public PollingComponent, public ecoworthy_modbus::Ecoworthy
   void set_standby_sleep_button(StandbySleepButton *b) { standby_sleep_button_ = b; }
   void set_deep_sleep_button(DeepSleepButton *b) { deep_sleep_button_ = b; }
   void set_trip_button(TripButton *b) { trip_button_ = b; }
+  void set_dump_history_button(DumpHistoryButton *b) { dump_history_button_ = b; }
 
-  void on_modbus_data(const std::vector<uint8_t> &data) override;
+  void on_modbus_data(const ecoworthy_modbus::FrameView &frame) override;
+  bool on_bus_idle() override;
 
   void dump_config() override;
   void update() override;
+  void setup() override;
   float get_setup_priority() const override;
 
   // MOS control methods (called by switches)
@@ -304,129 +516,39 @@ class EcoworthyBms : public PollingComponent, public ecoworthy_modbus::Ecoworthy
   void set_sleep_mode(uint8_t mode);  // 0xA501 = standby, 0xA502 = deep
   void trip_breaker();  // Emergency disconnect (trips all attached batteries)
 
+  // Compressed pack status history, history_size bytes per battery; 0 disables it
+  void set_history_size(uint32_t history_size) { this->history_size_ = history_size; }
+  const PackHistory *get_history(uint8_t battery_index) const {
+    return battery_index < this->battery_count_ ? &this->history_[battery_index] : nullptr;
+  }
+  // Logs every battery's history as hex lines for tools/decode_history.py, one block per
+  // 50 ms so the logger and the API log stream keep up
+  void dump_history();
+
   // Current MOS state (for switches)
   bool get_charge_mos_state() const { return charge_mos_state_; }
   bool get_discharge_mos_state() const { return discharge_mos_state_; }
 
  protected:
-  // Binary sensors
   binary_sensor::BinarySensor *online_status_binary_sensor_{nullptr};
-  binary_sensor::BinarySensor *charging_binary_sensor_{nullptr};
-  binary_sensor::BinarySensor *discharging_binary_sensor_{nullptr};
-  binary_sensor::BinarySensor *charging_switch_binary_sensor_{nullptr};
-  binary_sensor::BinarySensor *discharging_switch_binary_sensor_{nullptr};
-  binary_sensor::BinarySensor *balancing_binary_sensor_{nullptr};
-
-  // Voltage sensors
-  sensor::Sensor *total_voltage_sensor_{nullptr};
-  sensor::Sensor *min_cell_voltage_sensor_{nullptr};
-  sensor::Sensor *max_cell_voltage_sensor_{nullptr};
-  sensor::Sensor *delta_cell_voltage_sensor_{nullptr};
-  sensor::Sensor *average_cell_voltage_sensor_{nullptr};
-  sensor::Sensor *min_voltage_cell_sensor_{nullptr};
-  sensor::Sensor *max_voltage_cell_sensor_{nullptr};
-
-  // Current and power sensors
-  sensor::Sensor *current_sensor_{nullptr};
-  sensor::Sensor *power_sensor_{nullptr};
-  sensor::Sensor *charging_power_sensor_{nullptr};
-  sensor::Sensor *discharging_power_sensor_{nullptr};
-
-  // Temperature sensors
-  sensor::Sensor *power_tube_temperature_sensor_{nullptr};
-  sensor::Sensor *ambient_temperature_sensor_{nullptr};
-  sensor::Sensor *min_temperature_sensor_{nullptr};
-  sensor::Sensor *max_temperature_sensor_{nullptr};
-  sensor::Sensor *avg_temperature_sensor_{nullptr};
-
-  // Capacity sensors
-  sensor::Sensor *remaining_capacity_sensor_{nullptr};
-  sensor::Sensor *full_capacity_sensor_{nullptr};
-  sensor::Sensor *rated_capacity_sensor_{nullptr};
-
-  // State sensors
-  sensor::Sensor *state_of_charge_sensor_{nullptr};
-  sensor::Sensor *state_of_health_sensor_{nullptr};
-  sensor::Sensor *cycle_count_sensor_{nullptr};
-  sensor::Sensor *cell_count_sensor_{nullptr};
-  sensor::Sensor *temperature_sensor_count_sensor_{nullptr};
 
-  // Charge/Discharge limits
-  sensor::Sensor *charge_voltage_limit_sensor_{nullptr};
-  sensor::Sensor *charge_current_limit_sensor_{nullptr};
-  sensor::Sensor *discharge_voltage_limit_sensor_{nullptr};
-  sensor::Sensor *discharge_current_limit_sensor_{nullptr};
+  // Index 0 is the primary, 1+ the secondaries
+  BatterySensors batteries_[MAX_BATTERIES];
+  // Config block sensors, read from the primary only
+  sensor::Sensor *param_sensors_[PARAM_FIELD_COUNT]{};
 
-  // Bitmask sensors
-  sensor::Sensor *fault_bitmask_sensor_{nullptr};
-  sensor::Sensor *alarm_bitmask_sensor_{nullptr};
-  sensor::Sensor *mosfet_status_bitmask_sensor_{nullptr};
-  sensor::Sensor *balancing_bitmask_sensor_{nullptr};
+  PackStatus pack_status_[MAX_BATTERIES];
+  PackConfig pack_config_;
+  CallbackManager<void(uint8_t, const PackStatus &)> pack_status_callback_;
 
-  // Protection parameter sensors (from 0x1800 block)
-  sensor::Sensor *cell_ovp_trigger_sensor_{nullptr};
-  sensor::Sensor *cell_ovp_release_sensor_{nullptr};
-  sensor::Sensor *cell_uvp_trigger_sensor_{nullptr};
-  sensor::Sensor *cell_uvp_release_sensor_{nullptr};
-  sensor::Sensor *pack_ovp_trigger_sensor_{nullptr};
-  sensor::Sensor *pack_ovp_release_sensor_{nullptr};
-  sensor::Sensor *pack_uvp_trigger_sensor_{nullptr};
-  sensor::Sensor *pack_uvp_release_sensor_{nullptr};
-  // Temperature protection sensors
-  sensor::Sensor *charge_ot_trigger_sensor_{nullptr};
-  sensor::Sensor *charge_ot_release_sensor_{nullptr};
-  sensor::Sensor *charge_ot_delay_sensor_{nullptr};
-  sensor::Sensor *charge_ut_trigger_sensor_{nullptr};
-  sensor::Sensor *charge_ut_release_sensor_{nullptr};
-  sensor::Sensor *charge_ut_delay_sensor_{nullptr};
-  sensor::Sensor *discharge_ot_trigger_sensor_{nullptr};
-  sensor::Sensor *discharge_ot_release_sensor_{nullptr};
-  sensor::Sensor *discharge_ot_delay_sensor_{nullptr};
-  sensor::Sensor *discharge_ut_trigger_sensor_{nullptr};
-  sensor::Sensor *discharge_ut_release_sensor_{nullptr};
-  sensor::Sensor *discharge_ut_delay_sensor_{nullptr};
-  // Current protection sensors
-  sensor::Sensor *charge_oc_alarm_sensor_{nullptr};
-  sensor::Sensor *charge_oc_alarm_delay_sensor_{nullptr};
-  sensor::Sensor *charge_oc_trigger_sensor_{nullptr};
-  sensor::Sensor *charge_oc_delay_sensor_{nullptr};
-  sensor::Sensor *charge_oc_recover_delay_sensor_{nullptr};
-  sensor::Sensor *charge_oc2_trigger_sensor_{nullptr};
-  sensor::Sensor *charge_oc2_delay_sensor_{nullptr};
-  sensor::Sensor *discharge_oc_alarm_sensor_{nullptr};
-  sensor::Sensor *discharge_oc_alarm_delay_sensor_{nullptr};
-  sensor::Sensor *discharge_oc_trigger_sensor_{nullptr};
-  sensor::Sensor *discharge_oc_delay_sensor_{nullptr};
-  sensor::Sensor *discharge_oc_recover_delay_sensor_{nullptr};
-  sensor::Sensor *discharge_oc2_trigger_sensor_{nullptr};
-  sensor::Sensor *discharge_oc2_delay_sensor_{nullptr};
-  // Individual pack status (function 0x45) - non-aggregated current limits
-  sensor::Sensor *individual_charge_current_limit_sensor_{nullptr};
-  sensor::Sensor *individual_discharge_current_limit_sensor_{nullptr};
-
-  // Configuration sensors
-  sensor::Sensor *balance_voltage_sensor_{nullptr};
-  sensor::Sensor *balance_difference_sensor_{nullptr};
-  sensor::Sensor *heater_start_temp_sensor_{nullptr};
-  sensor::Sensor *heater_stop_temp_sensor_{nullptr};
-  sensor::Sensor *full_charge_voltage_sensor_{nullptr};
-  sensor::Sensor *full_charge_current_sensor_{nullptr};
-  sensor::Sensor *sleep_voltage_sensor_{nullptr};
-  sensor::Sensor *sleep_delay_sensor_{nullptr};
-  sensor::Sensor *total_charge_sensor_{nullptr};
-  sensor::Sensor *total_discharge_sensor_{nullptr};
-  sensor::Sensor *configured_cvl_sensor_{nullptr};
-  sensor::Sensor *configured_ccl_sensor_{nullptr};
-  sensor::Sensor *configured_dvl_sensor_{nullptr};
-  sensor::Sensor *configured_dcl_sensor_{nullptr};
-  sensor::Sensor *shunt_resistance_sensor_{nullptr};
+  sensor::Sensor *suppressed_publishes_sensor_{nullptr};
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+  sensor::Sensor *heap_allocations_sensor_{nullptr};
+  uint32_t cycle_allocations_{0};  // heap_allocation_count() at the start of the current poll cycle
+  bool cycle_started_{false};
+#endif
 
   // Text sensors
-  text_sensor::TextSensor *operation_status_text_sensor_{nullptr};
-  text_sensor::TextSensor *fault_text_sensor_{nullptr};
-  text_sensor::TextSensor *alarm_text_sensor_{nullptr};
-  text_sensor::TextSensor *serial_number_text_sensor_{nullptr};
-  text_sensor::TextSensor *firmware_text_sensor_{nullptr};
   text_sensor::TextSensor *bms_serial_number_text_sensor_{nullptr};
   text_sensor::TextSensor *pack_serial_number_text_sensor_{nullptr};
   text_sensor::TextSensor *manufacturer_text_sensor_{nullptr};
@@ -444,52 +566,90 @@ class EcoworthyBms : public PollingComponent, public ecoworthy_modbus::Ecoworthy
   StandbySleepButton *standby_sleep_button_{nullptr};
   DeepSleepButton *deep_sleep_button_{nullptr};
   TripButton *trip_button_{nullptr};
-
-  struct Cell {
-    sensor::Sensor *cell_voltage_sensor_{nullptr};
-  } cells_[16];
-
-  struct Temperature {
-    sensor::Sensor *temperature_sensor_{nullptr};
-  } temperatures_[4];
+  DumpHistoryButton *dump_history_button_{nullptr};
 
   uint8_t no_response_count_{0};
-  uint32_t update_counter_{0};
-  uint8_t request_step_{0};
   
   // Multi-battery support
   uint8_t battery_count_{1};
-  uint8_t current_battery_index_{0};  // Which battery we're currently polling (0 = primary)
-  SecondaryBatterySensors secondary_batteries_[MAX_BATTERIES];  // Index 0 unused (primary uses main sensors)
+  PollMode poll_mode_{POLL_MODE_INTERVAL};
+
+  // Earliest-deadline-first polling: one slot per battery's pack status, the primary's config blocks,
+  // then one fast pack status slot per battery. Each slot holds its precomputed request frame and
+  // when its data is next due.
+  struct PollSlot {
+    uint8_t frame_id{ecoworthy_modbus::EcoworthyModbus::INVALID_READ_FRAME};
+    uint32_t interval{0};
+    uint32_t deadline{0};
+  };
+  static constexpr uint8_t FAST_SLOTS_START = MAX_BATTERIES + CONFIG_BLOCK_SLOTS;
+  PollSlot poll_slots_[FAST_SLOTS_START + MAX_BATTERIES];
+  uint32_t pack_status_interval_{10000};
+  uint32_t fast_pack_status_interval_{0};
+  uint32_t config_intervals_[CONFIG_BLOCK_SLOTS]{60000, 120000, 720000, 360000, 30000};
+  // Planned data bytes per block; 0 means the block is skipped
+  uint16_t pack_status_lengths_[MAX_BATTERIES]{};
+  bool full_pack_status_{false};  // A pack status callback wants the whole snapshot
+
+  uint32_t history_size_{0};
+  PackHistory history_[MAX_BATTERIES];
+  // Dump in progress: battery and block sequence number logged next
+  bool dumping_history_{false};
+  bool dump_battery_started_{false};
+  uint8_t dump_battery_{0};
+  uint32_t dump_sequence_{0};
+  uint16_t config_lengths_[CONFIG_BLOCK_SLOTS]{};
+  bool read_full_blocks_{false};
+
+  // Change-gated publishing. The heartbeat bumps the epoch; a block whose last publish happened in an
+  // older epoch is published unconditionally once.
+  bool publish_changes_only_{false};
+  uint32_t heartbeat_interval_{60000};
+  uint8_t publish_epoch_{0};
+  uint8_t published_epoch_[MAX_BATTERIES + CONFIG_BLOCK_SLOTS]{};
+  bool force_publish_{false};
+  uint32_t suppressed_publishes_{0};
+  float deadbands_[BATTERY_SENSOR_COUNT]{};  // Indexed like BatterySensors::sensors; 0 compares rounded values
 
   // Current MOS states
   bool charge_mos_state_{false};
   bool discharge_mos_state_{false};
 
   void publish_state_(binary_sensor::BinarySensor *binary_sensor, const bool &state);
-  void publish_state_(sensor::Sensor *sensor, float value);
-  void publish_state_(text_sensor::TextSensor *text_sensor, const std::string &state);
+  void publish_state_(sensor::Sensor *sensor, float value, float deadband = 0.0f);
+  void publish_pack_state_(BatterySensors &bat, uint8_t slot, float value) {
+    this->publish_state_(bat.sensors[slot], value, this->deadbands_[slot]);
+  }
+  void publish_state_(text_sensor::TextSensor *text_sensor, const char *state);
   
-  void on_pack_status_data_(const std::vector<uint8_t> &data, uint8_t battery_index);
-  void on_config_1c00_data_(const std::vector<uint8_t> &data);
-  void on_config_2000_data_(const std::vector<uint8_t> &data);
-  void on_product_info_data_(const std::vector<uint8_t> &data);
-  void on_protection_params_data_(const std::vector<uint8_t> &data);
-  void on_individual_pack_status_data_(const std::vector<uint8_t> &data);
+  void begin_block_publish_(uint8_t slot);
+  bool text_changed_(BatterySensors &bat, BatteryTextSensor slot, uint32_t key);
+  void publish_fields_(const ecoworthy_modbus::FrameView &frame, const RegisterField *fields, size_t count,
+                       sensor::Sensor *const *sensors, float *values, const float *deadbands = nullptr);
+  void on_pack_status_data_(const ecoworthy_modbus::FrameView &frame, uint8_t battery_index, bool fast);
+  void add_history_sample_(uint8_t battery_index, const PackStatus &status);
+  void dump_history_step_();
+  void on_config_1c00_data_(const ecoworthy_modbus::FrameView &frame);
+  void on_product_info_data_(const ecoworthy_modbus::FrameView &frame);
   
+  bool poll_next_();
+  void plan_reads_();
+  uint16_t plan_pack_status_length_(uint8_t battery_index) const;
+  void setup_pack_status_slots_(uint32_t now);
+
   void reset_online_status_tracker_();
   void reset_online_status_tracker_(uint8_t battery_index);
   void track_online_status_();
   void track_online_status_(uint8_t battery_index);
   void publish_device_unavailable_();
   void publish_device_unavailable_(uint8_t battery_index);
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+  void publish_cycle_allocations_();
+#endif
   
-  std::string decode_operation_status_(uint16_t status);
-  std::string decode_fault_(uint32_t fault);
-  std::string decode_alarm_(uint32_t alarm);
-  std::string decode_balance_mode_(uint16_t mode);
-  std::string decode_can_protocol_(uint16_t protocol);
-  std::string decode_rs485_protocol_(uint16_t protocol);
+  const char *decode_balance_mode_(uint16_t mode);
+  const char *decode_can_protocol_(uint16_t protocol);
+  const char *decode_rs485_protocol_(uint16_t protocol);
 };
 
 }  // namespace ecoworthy_bms
@@ -0,0 +1,116 @@
+#include "pack_history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace esphome {
+namespace ecoworthy_bms {
+
+static const uint32_t TIME_STEP_MS = 100;
+
+static size_t put_varint(uint8_t *out, uint32_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  out[length++] = uint8_t(value);
+  return length;
+}
+
+static uint32_t zigzag(int32_t value) { return (uint32_t(value) << 1) ^ uint32_t(value >> 31); }
+
+static void put_u16(uint8_t *out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+}
+
+bool PackHistory::init(size_t size) {
+  const size_t blocks = std::min<size_t>(size / BLOCK_SIZE, UINT16_MAX);
+  if (blocks < 2) {
+    return true;
+  }
+  this->buffer_.reset(new (std::nothrow) uint8_t[blocks * BLOCK_SIZE]);
+  if (!this->buffer_) {
+    return false;
+  }
+  this->block_count_ = blocks;
+  return true;
+}
+
+const uint8_t *PackHistory::block(uint16_t index) const {
+  return &this->buffer_[((this->first_block_ + index) % this->block_count_) * BLOCK_SIZE];
+}
+
+uint8_t *PackHistory::newest_block_() {
+  return &this->buffer_[((this->first_block_ + this->blocks_used_ - 1) % this->block_count_) * BLOCK_SIZE];
+}
+
+size_t PackHistory::encode_(uint8_t *out, uint32_t steps, const int32_t (&fields)[HISTORY_FIELD_COUNT]) const {
+  size_t length = put_varint(out, steps);
+  uint8_t *mask = out + length;
+  memset(mask, 0, MASK_SIZE);
+  length += MASK_SIZE;
+  for (uint8_t field = 0; field < HISTORY_FIELD_COUNT; field++) {
+    const int32_t delta = fields[field] - this->previous_[field];
+    if (delta != 0) {
+      mask[field / 8] |= 1 << (field % 8);
+      length += put_varint(out + length, zigzag(delta));
+    }
+  }
+  return length;
+}
+
+void PackHistory::start_block_(uint32_t now) {
+  if (this->blocks_used_ == this->block_count_) {
+    // Overwrite the oldest block
+    const uint8_t *oldest = this->block(0);
+    this->sample_count_ -= oldest[6] | (oldest[7] << 8);
+    this->used_bytes_ -= block_length(oldest);
+    this->first_block_ = (this->first_block_ + 1) % this->block_count_;
+    this->blocks_used_--;
+  }
+  this->blocks_used_++;
+  this->blocks_started_++;
+  uint8_t *block = this->newest_block_();
+  block[0] = now & 0xFF;
+  block[1] = (now >> 8) & 0xFF;
+  block[2] = (now >> 16) & 0xFF;
+  block[3] = now >> 24;
+  put_u16(block + 4, HEADER_SIZE);
+  put_u16(block + 6, 0);
+  this->used_bytes_ += HEADER_SIZE;
+  memset(this->previous_, 0, sizeof(this->previous_));
+  this->previous_time_ = now;
+}
+
+void PackHistory::add(uint32_t now, const int32_t (&fields)[HISTORY_FIELD_COUNT]) {
+  if (!this->is_enabled()) {
+    return;
+  }
+  uint8_t sample[MAX_SAMPLE_SIZE];
+  size_t length = 0;
+  uint32_t steps = (now - this->previous_time_) / TIME_STEP_MS;
+  if (this->blocks_used_ > 0) {
+    length = this->encode_(sample, steps, fields);
+  }
+  if (this->blocks_used_ == 0 || block_length(this->newest_block_()) + length > BLOCK_SIZE) {
+    this->start_block_(now);
+    steps = 0;
+    length = this->encode_(sample, steps, fields);
+  }
+
+  uint8_t *block = this->newest_block_();
+  const uint16_t used = block_length(block);
+  memcpy(block + used, sample, length);
+  put_u16(block + 4, used + length);
+  put_u16(block + 6, (block[6] | (block[7] << 8)) + 1);
+  this->used_bytes_ += length;
+  this->sample_count_++;
+  memcpy(this->previous_, fields, sizeof(this->previous_));
+  this->previous_time_ += steps * TIME_STEP_MS;
+}
+
+}  // namespace ecoworthy_bms
+}  // namespace esphome
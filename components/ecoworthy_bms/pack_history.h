@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace esphome {
+namespace ecoworthy_bms {
+
+// Fixed-point pack status fields kept in the history, in encoding order
+enum HistoryField : uint8_t {
+  HISTORY_TOTAL_VOLTAGE,                                      // 10 mV
+  HISTORY_CURRENT,                                            // 10 mA
+  HISTORY_STATE_OF_CHARGE,                                    // 0.01 %
+  HISTORY_CELL_VOLTAGES,                                      // 16 cells, mV
+  HISTORY_TEMPERATURES = HISTORY_CELL_VOLTAGES + 16,          // 4 sensors, 0.1 °C
+  HISTORY_POWER_TUBE_TEMPERATURE = HISTORY_TEMPERATURES + 4,  // 0.1 °C
+  HISTORY_FIELD_COUNT,
+};
+
+// Compressed history of one battery: a ring of fixed-size blocks, allocated once by init().
+//
+// Block layout, little endian: start time in ms (u32), bytes used including this header (u16), sample
+// count (u16), then the samples. A sample is the time since the previous one in 100 ms steps (varint),
+// a bitmask of the fields that changed (3 bytes, field 0 in bit 0) and the zigzag varint delta of each
+// changed field. The first sample of a block is encoded against zeros, so every block decodes on its
+// own and the oldest one can be overwritten. tools/decode_history.py decodes dumps of this format.
+class PackHistory {
+ public:
+  static const uint16_t BLOCK_SIZE = 256;
+  static const uint8_t HEADER_SIZE = 8;
+  static const uint8_t MASK_SIZE = (HISTORY_FIELD_COUNT + 7) / 8;
+  static const uint8_t MAX_SAMPLE_SIZE = 5 + MASK_SIZE + HISTORY_FIELD_COUNT * 5;
+  // Stored for fields the pack did not report
+  static const int32_t ABSENT = -32768;
+
+  // Rounds size down to whole blocks; less than two blocks leaves the history disabled. Returns false
+  // if the buffer could not be allocated.
+  bool init(size_t size);
+  bool is_enabled() const { return this->block_count_ > 0; }
+
+  void add(uint32_t now, const int32_t (&fields)[HISTORY_FIELD_COUNT]);
+
+  uint16_t block_count() const { return this->block_count_; }
+  // Blocks holding samples; index 0 is the oldest
+  uint16_t blocks_used() const { return this->blocks_used_; }
+  const uint8_t *block(uint16_t index) const;
+  // Blocks are numbered in the order they were started, so a reader can tell which ones were
+  // overwritten while it was busy; this is the number of block(0)
+  uint32_t first_sequence() const { return this->blocks_started_ - this->blocks_used_; }
+  static uint16_t block_length(const uint8_t *block) { return block[4] | (block[5] << 8); }
+  uint32_t sample_count() const { return this->sample_count_; }
+  uint32_t used_bytes() const { return this->used_bytes_; }
+
+ protected:
+  size_t encode_(uint8_t *out, uint32_t steps, const int32_t (&fields)[HISTORY_FIELD_COUNT]) const;
+  uint8_t *newest_block_();
+  void start_block_(uint32_t now);
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  uint16_t block_count_{0};
+  uint16_t first_block_{0};  // Ring position of the oldest block
+  uint16_t blocks_used_{0};
+  uint32_t blocks_started_{0};
+  uint32_t sample_count_{0};  // Samples in the ring
+  uint32_t used_bytes_{0};    // Bytes used by the blocks in the ring, headers included
+  int32_t previous_[HISTORY_FIELD_COUNT]{};
+  uint32_t previous_time_{0};  // ms, advanced by whole 100 ms steps so rounding does not add up
+};
+
+}  // namespace ecoworthy_bms
+}  // namespace esphome
@@ -1,6 +1,7 @@
 import esphome.codegen as cg
 from esphome.components import sensor
 import esphome.config_validation as cv
+from esphome.core import CORE
 from esphome.const import (
     CONF_CURRENT,
     CONF_ID,
@@ -12,7 +13,12 @@ from esphome.const import (
     DEVICE_CLASS_POWER,
     DEVICE_CLASS_TEMPERATURE,
     DEVICE_CLASS_VOLTAGE,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    PLATFORM_ESP32,
+    PLATFORM_ESP8266,
+    PLATFORM_HOST,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
     UNIT_AMPERE,
     UNIT_CELSIUS,
     UNIT_PERCENT,
@@ -20,7 +26,7 @@ from esphome.const import (
     UNIT_WATT,
 )
 
-from . import ECOWORTHY_BMS_COMPONENT_SCHEMA, CONF_ECOWORTHY_BMS_ID
+from . import ECOWORTHY_BMS_COMPONENT_SCHEMA, CONF_ECOWORTHY_BMS_ID, BatterySensorSlot, PackField
 
 DEPENDENCIES = ["ecoworthy_bms"]
 
@@ -148,6 +154,10 @@ CONF_DISCHARGE_OC2_DELAY = "discharge_oc2_delay"
 CONF_INDIVIDUAL_CHARGE_CURRENT_LIMIT = "individual_charge_current_limit"
 CONF_INDIVIDUAL_DISCHARGE_CURRENT_LIMIT = "individual_discharge_current_limit"
 
+# Diagnostics
+CONF_SUPPRESSED_PUBLISHES = "suppressed_publishes"
+CONF_HEAP_ALLOCATIONS = "heap_allocations"
+
 UNIT_AMPERE_HOURS = "Ah"
 UNIT_MINUTES = "min"
 UNIT_MICROOHM = "μΩ"
@@ -155,6 +165,43 @@ UNIT_MICROOHM = "μΩ"
 # Secondary battery sensor configs (subset of main sensors)
 CONF_BATTERIES = "batteries"
 
+
+# Slot of each secondary battery sensor; cell voltages and temperature sensors are bound by number
+BATTERY_SENSOR_SLOTS = {
+    CONF_TOTAL_VOLTAGE: PackField.PACK_TOTAL_VOLTAGE,
+    CONF_MIN_CELL_VOLTAGE: PackField.PACK_MIN_CELL_VOLTAGE,
+    CONF_MAX_CELL_VOLTAGE: PackField.PACK_MAX_CELL_VOLTAGE,
+    CONF_DELTA_CELL_VOLTAGE: BatterySensorSlot.BATTERY_DELTA_CELL_VOLTAGE,
+    CONF_AVERAGE_CELL_VOLTAGE: PackField.PACK_AVERAGE_CELL_VOLTAGE,
+    CONF_MIN_VOLTAGE_CELL: PackField.PACK_MIN_VOLTAGE_CELL,
+    CONF_MAX_VOLTAGE_CELL: PackField.PACK_MAX_VOLTAGE_CELL,
+    CONF_CURRENT: PackField.PACK_CURRENT,
+    CONF_POWER: BatterySensorSlot.BATTERY_POWER,
+    CONF_CHARGING_POWER: BatterySensorSlot.BATTERY_CHARGING_POWER,
+    CONF_DISCHARGING_POWER: BatterySensorSlot.BATTERY_DISCHARGING_POWER,
+    CONF_POWER_TUBE_TEMPERATURE: PackField.PACK_POWER_TUBE_TEMPERATURE,
+    CONF_AMBIENT_TEMPERATURE: PackField.PACK_AMBIENT_TEMPERATURE,
+    CONF_MIN_TEMPERATURE: PackField.PACK_MIN_TEMPERATURE,
+    CONF_MAX_TEMPERATURE: PackField.PACK_MAX_TEMPERATURE,
+    CONF_AVG_TEMPERATURE: PackField.PACK_AVG_TEMPERATURE,
+    CONF_STATE_OF_CHARGE: PackField.PACK_STATE_OF_CHARGE,
+    CONF_STATE_OF_HEALTH: PackField.PACK_STATE_OF_HEALTH,
+    CONF_REMAINING_CAPACITY: PackField.PACK_REMAINING_CAPACITY,
+    CONF_FULL_CAPACITY: PackField.PACK_FULL_CAPACITY,
+    CONF_RATED_CAPACITY: PackField.PACK_RATED_CAPACITY,
+    CONF_CYCLE_COUNT: PackField.PACK_CYCLE_COUNT,
+    CONF_CHARGE_VOLTAGE_LIMIT: PackField.PACK_CHARGE_VOLTAGE_LIMIT,
+    CONF_CHARGE_CURRENT_LIMIT: PackField.PACK_CHARGE_CURRENT_LIMIT,
+    CONF_DISCHARGE_VOLTAGE_LIMIT: PackField.PACK_DISCHARGE_VOLTAGE_LIMIT,
+    CONF_DISCHARGE_CURRENT_LIMIT: PackField.PACK_DISCHARGE_CURRENT_LIMIT,
+    CONF_CELL_COUNT: PackField.PACK_CELL_COUNT,
+    CONF_TEMPERATURE_SENSOR_COUNT: BatterySensorSlot.BATTERY_TEMPERATURE_SENSOR_COUNT,
+    CONF_FAULT_BITMASK: PackField.PACK_FAULT_BITMASK,
+    CONF_ALARM_BITMASK: PackField.PACK_ALARM_BITMASK,
+    CONF_MOSFET_STATUS_BITMASK: PackField.PACK_MOSFET_STATUS_BITMASK,
+    CONF_BALANCING_BITMASK: BatterySensorSlot.BATTERY_BALANCING_BITMASK,
+}
+
 CELL_VOLTAGE_SCHEMA = sensor.sensor_schema(
     unit_of_measurement=UNIT_VOLT,
     accuracy_decimals=3,
@@ -787,6 +834,24 @@ CONFIG_SCHEMA = ECOWORTHY_BMS_COMPONENT_SCHEMA.extend(
             state_class=STATE_CLASS_MEASUREMENT,
             icon="mdi:current-dc",
         ),
+        # Diagnostics
+        cv.Optional(CONF_SUPPRESSED_PUBLISHES): sensor.sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            icon="mdi:filter-outline",
+        ),
+        # Heap allocations per poll cycle. Wraps malloc(), calloc() and realloc() on the ESP32 and
+        # ESP8266 and replaces operator new on host builds.
+        cv.Optional(CONF_HEAP_ALLOCATIONS): cv.All(
+            sensor.sensor_schema(
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+                icon="mdi:memory",
+            ),
+            cv.only_on([PLATFORM_ESP32, PLATFORM_ESP8266, PLATFORM_HOST]),
+        ),
         # Per-battery sensors for secondary batteries (battery_2, battery_3, etc.)
         # Use battery index as key (2-16)
         cv.Optional(CONF_BATTERIES): cv.Schema({
@@ -1131,123 +1196,36 @@ async def to_code(config):
         sens = await sensor.new_sensor(config[CONF_INDIVIDUAL_DISCHARGE_CURRENT_LIMIT])
         cg.add(hub.set_individual_discharge_current_limit_sensor(sens))
 
+    # Diagnostics
+    if CONF_SUPPRESSED_PUBLISHES in config:
+        sens = await sensor.new_sensor(config[CONF_SUPPRESSED_PUBLISHES])
+        cg.add(hub.set_suppressed_publishes_sensor(sens))
+    if CONF_HEAP_ALLOCATIONS in config:
+        cg.add_define("USE_ECOWORTHY_ALLOCATION_COUNTER")
+        if CORE.is_esp32 or CORE.is_esp8266:
+            # Route the C allocator through the counting wrappers in ecoworthy_modbus.cpp
+            for function in ("malloc", "calloc", "realloc"):
+                cg.add_build_flag(f"-Wl,--wrap={function}")
+        sens = await sensor.new_sensor(config[CONF_HEAP_ALLOCATIONS])
+        cg.add(hub.set_heap_allocations_sensor(sens))
+
     # Per-battery sensors for secondary batteries
     if CONF_BATTERIES in config:
         for battery_index, battery_config in config[CONF_BATTERIES].items():
             # YAML key is 1-based (secondary_battery_number: 2,3,...) but C++ battery_index
             # from address offset is 0-based (primary=0, secondary1=1, secondary2=2,...)
             cpp_index = battery_index - 1
-            # Voltage sensors
-            if CONF_TOTAL_VOLTAGE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_TOTAL_VOLTAGE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "total_voltage", sens))
-            if CONF_MIN_CELL_VOLTAGE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MIN_CELL_VOLTAGE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "min_cell_voltage", sens))
-            if CONF_MAX_CELL_VOLTAGE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MAX_CELL_VOLTAGE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "max_cell_voltage", sens))
-            if CONF_DELTA_CELL_VOLTAGE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_DELTA_CELL_VOLTAGE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "delta_cell_voltage", sens))
-            if CONF_AVERAGE_CELL_VOLTAGE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_AVERAGE_CELL_VOLTAGE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "average_cell_voltage", sens))
-            if CONF_MIN_VOLTAGE_CELL in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MIN_VOLTAGE_CELL])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "min_voltage_cell", sens))
-            if CONF_MAX_VOLTAGE_CELL in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MAX_VOLTAGE_CELL])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "max_voltage_cell", sens))
-            # Cell voltages
+            for key, slot in BATTERY_SENSOR_SLOTS.items():
+                if key in battery_config:
+                    sens = await sensor.new_sensor(battery_config[key])
+                    cg.add(hub.set_secondary_battery_sensor(cpp_index, slot, sens))
             for i in range(1, 17):
                 conf_name = f"cell_voltage_{i}"
                 if conf_name in battery_config:
                     sens = await sensor.new_sensor(battery_config[conf_name])
-                    cg.add(hub.set_secondary_battery_sensor(cpp_index, conf_name, sens))
-            # Current and power
-            if CONF_CURRENT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_CURRENT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "current", sens))
-            if CONF_POWER in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_POWER])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "power", sens))
-            if CONF_CHARGING_POWER in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_CHARGING_POWER])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "charging_power", sens))
-            if CONF_DISCHARGING_POWER in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_DISCHARGING_POWER])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "discharging_power", sens))
-            # Temperature sensors
-            if CONF_POWER_TUBE_TEMPERATURE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_POWER_TUBE_TEMPERATURE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "power_tube_temperature", sens))
-            if CONF_AMBIENT_TEMPERATURE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_AMBIENT_TEMPERATURE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "ambient_temperature", sens))
-            if CONF_MIN_TEMPERATURE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MIN_TEMPERATURE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "min_temperature", sens))
-            if CONF_MAX_TEMPERATURE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MAX_TEMPERATURE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "max_temperature", sens))
-            if CONF_AVG_TEMPERATURE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_AVG_TEMPERATURE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "avg_temperature", sens))
+                    cg.add(hub.set_secondary_cell_voltage_sensor(cpp_index, i - 1, sens))
             for i in range(1, 5):
                 conf_name = f"temperature_sensor_{i}"
                 if conf_name in battery_config:
                     sens = await sensor.new_sensor(battery_config[conf_name])
-                    cg.add(hub.set_secondary_battery_sensor(cpp_index, conf_name, sens))
-            # Capacity
-            if CONF_STATE_OF_CHARGE in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_STATE_OF_CHARGE])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "state_of_charge", sens))
-            if CONF_STATE_OF_HEALTH in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_STATE_OF_HEALTH])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "state_of_health", sens))
-            if CONF_REMAINING_CAPACITY in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_REMAINING_CAPACITY])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "remaining_capacity", sens))
-            if CONF_FULL_CAPACITY in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_FULL_CAPACITY])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "full_capacity", sens))
-            if CONF_RATED_CAPACITY in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_RATED_CAPACITY])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "rated_capacity", sens))
-            if CONF_CYCLE_COUNT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_CYCLE_COUNT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "cycle_count", sens))
-            # Limits
-            if CONF_CHARGE_VOLTAGE_LIMIT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_CHARGE_VOLTAGE_LIMIT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "charge_voltage_limit", sens))
-            if CONF_CHARGE_CURRENT_LIMIT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_CHARGE_CURRENT_LIMIT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "charge_current_limit", sens))
-            if CONF_DISCHARGE_VOLTAGE_LIMIT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_DISCHARGE_VOLTAGE_LIMIT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "discharge_voltage_limit", sens))
-            if CONF_DISCHARGE_CURRENT_LIMIT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_DISCHARGE_CURRENT_LIMIT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "discharge_current_limit", sens))
-            # Status
-            if CONF_CELL_COUNT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_CELL_COUNT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "cell_count", sens))
-            if CONF_TEMPERATURE_SENSOR_COUNT in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_TEMPERATURE_SENSOR_COUNT])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "temperature_sensor_count", sens))
-            if CONF_FAULT_BITMASK in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_FAULT_BITMASK])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "fault_bitmask", sens))
-            if CONF_ALARM_BITMASK in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_ALARM_BITMASK])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "alarm_bitmask", sens))
-            if CONF_MOSFET_STATUS_BITMASK in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_MOSFET_STATUS_BITMASK])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "mosfet_status_bitmask", sens))
-            if CONF_BALANCING_BITMASK in battery_config:
-                sens = await sensor.new_sensor(battery_config[CONF_BALANCING_BITMASK])
-                cg.add(hub.set_secondary_battery_sensor(cpp_index, "balancing_bitmask", sens))
-
+                    cg.add(hub.set_secondary_temperature_sensor(cpp_index, i - 1, sens))
@@ -2,7 +2,7 @@ import esphome.codegen as cg
 from esphome.components import text_sensor
 import esphome.config_validation as cv
 
-from . import ECOWORTHY_BMS_COMPONENT_SCHEMA, CONF_ECOWORTHY_BMS_ID
+from . import ECOWORTHY_BMS_COMPONENT_SCHEMA, CONF_ECOWORTHY_BMS_ID, ecoworthy_bms_ns
 
 DEPENDENCIES = ["ecoworthy_bms"]
 
@@ -21,6 +21,17 @@ CONF_RS485_PROTOCOL = "rs485_protocol"
 CONF_HARDWARE_VERSION = "hardware_version"
 CONF_BATTERIES = "batteries"
 
+BatteryTextSensor = ecoworthy_bms_ns.enum("BatteryTextSensor")
+
+# Slot of each secondary battery text sensor
+BATTERY_TEXT_SENSOR_SLOTS = {
+    CONF_OPERATION_STATUS: BatteryTextSensor.BATTERY_OPERATION_STATUS,
+    CONF_FAULT: BatteryTextSensor.BATTERY_FAULT,
+    CONF_ALARM: BatteryTextSensor.BATTERY_ALARM,
+    CONF_SERIAL_NUMBER: BatteryTextSensor.BATTERY_SERIAL_NUMBER,
+    CONF_FIRMWARE_VERSION: BatteryTextSensor.BATTERY_FIRMWARE_VERSION,
+}
+
 # Schema for per-battery text sensors (secondary batteries - all text sensors from Pack Status)
 BATTERY_TEXT_SENSOR_SCHEMA = cv.Schema(
     {
@@ -152,18 +163,7 @@ async def to_code(config):
             # YAML key is 1-based (secondary_battery_number: 2,3,...) but C++ battery_index
             # from address offset is 0-based (primary=0, secondary1=1, secondary2=2,...)
             cpp_index = battery_index - 1
-            if CONF_OPERATION_STATUS in battery_config:
-                sens = await text_sensor.new_text_sensor(battery_config[CONF_OPERATION_STATUS])
-                cg.add(hub.set_secondary_battery_text_sensor(cpp_index, "operation_status", sens))
-            if CONF_FAULT in battery_config:
-                sens = await text_sensor.new_text_sensor(battery_config[CONF_FAULT])
-                cg.add(hub.set_secondary_battery_text_sensor(cpp_index, "fault", sens))
-            if CONF_ALARM in battery_config:
-                sens = await text_sensor.new_text_sensor(battery_config[CONF_ALARM])
-                cg.add(hub.set_secondary_battery_text_sensor(cpp_index, "alarm", sens))
-            if CONF_SERIAL_NUMBER in battery_config:
-                sens = await text_sensor.new_text_sensor(battery_config[CONF_SERIAL_NUMBER])
-                cg.add(hub.set_secondary_battery_text_sensor(cpp_index, "serial_number", sens))
-            if CONF_FIRMWARE_VERSION in battery_config:
-                sens = await text_sensor.new_text_sensor(battery_config[CONF_FIRMWARE_VERSION])
-                cg.add(hub.set_secondary_battery_text_sensor(cpp_index, "firmware_version", sens))
+            for key, slot in BATTERY_TEXT_SENSOR_SLOTS.items():
+                if key in battery_config:
+                    sens = await text_sensor.new_text_sensor(battery_config[key])
+                    cg.add(hub.set_secondary_battery_text_sensor(cpp_index, slot, sens))
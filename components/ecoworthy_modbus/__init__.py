@@ -1,28 +1,186 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome import pins
-from esphome.components import uart
-from esphome.const import CONF_FLOW_CONTROL_PIN, CONF_ID
+from esphome.components import sensor, uart
+from esphome.const import (
+    CONF_ADDRESS,
+    CONF_FLOW_CONTROL_PIN,
+    CONF_ID,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
+)
 
 CODEOWNERS = ["@rar"]
 DEPENDENCIES = ["uart"]
+AUTO_LOAD = ["sensor"]
 MULTI_CONF = True
 
 CONF_ECOWORTHY_MODBUS_ID = "ecoworthy_modbus_id"
+CONF_DROPPED_REQUESTS = "dropped_requests"
+CONF_RESPONSE_TIMEOUT = "response_timeout"
+CONF_MIN_RESPONSE_TIMEOUT = "min_response_timeout"
+CONF_MAX_RESPONSE_TIMEOUT = "max_response_timeout"
+CONF_METRICS_INTERVAL = "metrics_interval"
+CONF_REQUEST_GAP = "request_gap"
+CONF_PASSIVE = "passive"
+CONF_SNIFFED_FRAMES = "sniffed_frames"
+CONF_LISTEN_BEFORE_TALK = "listen_before_talk"
+CONF_GUARD_TIME = "guard_time"
+CONF_COLLISION_BACKOFF = "collision_backoff"
+CONF_COLLISIONS = "collisions"
+CONF_DEFERRALS = "deferrals"
+CONF_LATENCY_P50 = "latency_p50"
+CONF_LATENCY_P95 = "latency_p95"
+CONF_LATENCY_MAX = "latency_max"
+CONF_ADDRESS_LATENCY = "address_latency"
+CONF_CRC_ERRORS = "crc_errors"
+CONF_TIMEOUTS = "timeouts"
+CONF_PARTIAL_FRAMES = "partial_frames"
+CONF_TX_RATE = "tx_rate"
+CONF_RX_RATE = "rx_rate"
+CONF_BUS_UTILIZATION = "bus_utilization"
+CONF_QUEUE_DEPTH = "queue_depth"
+CONF_PEAK_QUEUE_DEPTH = "peak_queue_depth"
+
+UNIT_BYTES_PER_SECOND = "B/s"
 
 ecoworthy_modbus_ns = cg.esphome_ns.namespace("ecoworthy_modbus")
 EcoworthyModbus = ecoworthy_modbus_ns.class_("EcoworthyModbus", cg.Component, uart.UARTDevice)
 EcoworthyModbusDevice = ecoworthy_modbus_ns.class_("EcoworthyModbusDevice")
 
-CONFIG_SCHEMA = (
+LATENCY_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_MILLISECOND,
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    icon="mdi:timer-outline",
+)
+ERROR_COUNT_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_TOTAL_INCREASING,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    icon="mdi:alert-circle-outline",
+)
+BYTE_RATE_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_BYTES_PER_SECOND,
+    accuracy_decimals=1,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    icon="mdi:swap-horizontal",
+)
+QUEUE_DEPTH_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    icon="mdi:tray-full",
+)
+
+
+def validate_response_timeouts(config):
+    if config[CONF_MIN_RESPONSE_TIMEOUT] > config[CONF_MAX_RESPONSE_TIMEOUT]:
+        raise cv.Invalid(
+            f"{CONF_MIN_RESPONSE_TIMEOUT} must not be greater than {CONF_MAX_RESPONSE_TIMEOUT}"
+        )
+    return config
+
+
+def validate_passive(config):
+    if config[CONF_PASSIVE] and CONF_LISTEN_BEFORE_TALK in config:
+        raise cv.Invalid(f"{CONF_LISTEN_BEFORE_TALK} has no effect with {CONF_PASSIVE}, which never transmits")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(EcoworthyModbus),
             cv.Optional(CONF_FLOW_CONTROL_PIN): pins.gpio_output_pin_schema,
+            # Used until a round-trip time has been measured; afterwards the timeout adapts
+            # per address and block size, bounded by the min/max values
+            cv.Optional(
+                CONF_RESPONSE_TIMEOUT, default="2000ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_MIN_RESPONSE_TIMEOUT, default="150ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_MAX_RESPONSE_TIMEOUT, default="2000ms"
+            ): cv.positive_time_period_milliseconds,
+            # Quiet time between a response (or timeout) and the next request
+            cv.Optional(
+                CONF_REQUEST_GAP, default="0ms"
+            ): cv.positive_time_period_milliseconds,
+            # Never transmit; decode the requests of another master and the responses to them
+            cv.Optional(CONF_PASSIVE, default=False): cv.boolean,
+            # Share the bus with another master: transmit only in predicted idle windows
+            cv.Optional(CONF_LISTEN_BEFORE_TALK): cv.Schema(
+                {
+                    cv.Optional(
+                        CONF_GUARD_TIME, default="20ms"
+                    ): cv.positive_time_period_milliseconds,
+                    cv.Optional(
+                        CONF_COLLISION_BACKOFF, default="200ms"
+                    ): cv.positive_time_period_milliseconds,
+                }
+            ),
+            # Requests dropped or rejected because the bounded request queue was full
+            cv.Optional(CONF_DROPPED_REQUESTS): sensor.sensor_schema(
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_TOTAL_INCREASING,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+                icon="mdi:tray-remove",
+            ),
+            # Latency, byte rates and peak queue depth cover one metrics interval;
+            # error counters are totals since boot
+            cv.Optional(
+                CONF_METRICS_INTERVAL, default="60s"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_LATENCY_P50): LATENCY_SCHEMA,
+            cv.Optional(CONF_LATENCY_P95): LATENCY_SCHEMA,
+            cv.Optional(CONF_LATENCY_MAX): LATENCY_SCHEMA,
+            # The same percentiles for single battery addresses
+            cv.Optional(CONF_ADDRESS_LATENCY): cv.ensure_list(
+                cv.Schema(
+                    {
+                        cv.Required(CONF_ADDRESS): cv.hex_uint8_t,
+                        cv.Optional(CONF_LATENCY_P50): LATENCY_SCHEMA,
+                        cv.Optional(CONF_LATENCY_P95): LATENCY_SCHEMA,
+                        cv.Optional(CONF_LATENCY_MAX): LATENCY_SCHEMA,
+                    }
+                )
+            ),
+            cv.Optional(CONF_CRC_ERRORS): ERROR_COUNT_SCHEMA,
+            cv.Optional(CONF_TIMEOUTS): ERROR_COUNT_SCHEMA,
+            cv.Optional(CONF_PARTIAL_FRAMES): ERROR_COUNT_SCHEMA,
+            cv.Optional(CONF_TX_RATE): BYTE_RATE_SCHEMA,
+            cv.Optional(CONF_RX_RATE): BYTE_RATE_SCHEMA,
+            cv.Optional(CONF_BUS_UTILIZATION): sensor.sensor_schema(
+                unit_of_measurement=UNIT_PERCENT,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+                icon="mdi:gauge",
+            ),
+            cv.Optional(CONF_QUEUE_DEPTH): QUEUE_DEPTH_SCHEMA,
+            cv.Optional(CONF_PEAK_QUEUE_DEPTH): QUEUE_DEPTH_SCHEMA,
+            cv.Optional(CONF_COLLISIONS): ERROR_COUNT_SCHEMA,
+            cv.Optional(CONF_DEFERRALS): ERROR_COUNT_SCHEMA,
+            # Responses decoded in passive mode since boot
+            cv.Optional(CONF_SNIFFED_FRAMES): sensor.sensor_schema(
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_TOTAL_INCREASING,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+                icon="mdi:ear-hearing",
+            ),
         }
     )
     .extend(cv.COMPONENT_SCHEMA)
-    .extend(uart.UART_DEVICE_SCHEMA)
+    .extend(uart.UART_DEVICE_SCHEMA),
+    validate_response_timeouts,
+    validate_passive,
 )
 
 
@@ -35,6 +193,88 @@ async def to_code(config):
         pin = await cg.gpio_pin_expression(config[CONF_FLOW_CONTROL_PIN])
         cg.add(var.set_flow_control_pin(pin))
 
+    cg.add(var.set_response_timeout(config[CONF_RESPONSE_TIMEOUT]))
+    cg.add(var.set_min_response_timeout(config[CONF_MIN_RESPONSE_TIMEOUT]))
+    cg.add(var.set_max_response_timeout(config[CONF_MAX_RESPONSE_TIMEOUT]))
+
+    cg.add(var.set_request_gap(config[CONF_REQUEST_GAP]))
+    cg.add(var.set_passive(config[CONF_PASSIVE]))
+    if CONF_LISTEN_BEFORE_TALK in config:
+        lbt = config[CONF_LISTEN_BEFORE_TALK]
+        cg.add(var.set_listen_before_talk(True))
+        cg.add(var.set_guard_time(lbt[CONF_GUARD_TIME]))
+        cg.add(var.set_collision_backoff(lbt[CONF_COLLISION_BACKOFF]))
+    cg.add(var.set_metrics_interval(config[CONF_METRICS_INTERVAL]))
+
+    if CONF_DROPPED_REQUESTS in config:
+        sens = await sensor.new_sensor(config[CONF_DROPPED_REQUESTS])
+        cg.add(var.set_dropped_requests_sensor(sens))
+
+    if CONF_LATENCY_P50 in config:
+        sens = await sensor.new_sensor(config[CONF_LATENCY_P50])
+        cg.add(var.set_latency_p50_sensor(sens))
+
+    if CONF_LATENCY_P95 in config:
+        sens = await sensor.new_sensor(config[CONF_LATENCY_P95])
+        cg.add(var.set_latency_p95_sensor(sens))
+
+    if CONF_LATENCY_MAX in config:
+        sens = await sensor.new_sensor(config[CONF_LATENCY_MAX])
+        cg.add(var.set_latency_max_sensor(sens))
+
+    for address_config in config.get(CONF_ADDRESS_LATENCY, []):
+        sensors = []
+        for key in (CONF_LATENCY_P50, CONF_LATENCY_P95, CONF_LATENCY_MAX):
+            if key in address_config:
+                sensors.append(await sensor.new_sensor(address_config[key]))
+            else:
+                sensors.append(cg.nullptr)
+        cg.add(var.add_address_latency_sensors(address_config[CONF_ADDRESS], *sensors))
+
+    if CONF_CRC_ERRORS in config:
+        sens = await sensor.new_sensor(config[CONF_CRC_ERRORS])
+        cg.add(var.set_crc_errors_sensor(sens))
+
+    if CONF_TIMEOUTS in config:
+        sens = await sensor.new_sensor(config[CONF_TIMEOUTS])
+        cg.add(var.set_timeouts_sensor(sens))
+
+    if CONF_PARTIAL_FRAMES in config:
+        sens = await sensor.new_sensor(config[CONF_PARTIAL_FRAMES])
+        cg.add(var.set_partial_frames_sensor(sens))
+
+    if CONF_TX_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_TX_RATE])
+        cg.add(var.set_tx_rate_sensor(sens))
+
+    if CONF_RX_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_RX_RATE])
+        cg.add(var.set_rx_rate_sensor(sens))
+
+    if CONF_BUS_UTILIZATION in config:
+        sens = await sensor.new_sensor(config[CONF_BUS_UTILIZATION])
+        cg.add(var.set_bus_utilization_sensor(sens))
+
+    if CONF_QUEUE_DEPTH in config:
+        sens = await sensor.new_sensor(config[CONF_QUEUE_DEPTH])
+        cg.add(var.set_queue_depth_sensor(sens))
+
+    if CONF_PEAK_QUEUE_DEPTH in config:
+        sens = await sensor.new_sensor(config[CONF_PEAK_QUEUE_DEPTH])
+        cg.add(var.set_peak_queue_depth_sensor(sens))
+
+    if CONF_COLLISIONS in config:
+        sens = await sensor.new_sensor(config[CONF_COLLISIONS])
+        cg.add(var.set_collisions_sensor(sens))
+
+    if CONF_DEFERRALS in config:
+        sens = await sensor.new_sensor(config[CONF_DEFERRALS])
+        cg.add(var.set_deferrals_sensor(sens))
+
+    if CONF_SNIFFED_FRAMES in config:
+        sens = await sensor.new_sensor(config[CONF_SNIFFED_FRAMES])
+        cg.add(var.set_sniffed_frames_sensor(sens))
+
 
 def ecoworthy_modbus_device_schema(default_address):
     schema = {
@@ -2,62 +2,354 @@
 #include "esphome/core/log.h"
 #include "esphome/core/helpers.h"
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(USE_ECOWORTHY_ALLOCATION_COUNTER) && !defined(USE_ESP8266)
+#include <atomic>
+#endif
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+#ifdef USE_HOST
+#include <cstdlib>
+#include <new>
+#endif
+#endif
+
 namespace esphome {
 namespace ecoworthy_modbus {
 
 static const char *const TAG = "ecoworthy_modbus";
 
 // Ecoworthy/JBD custom function codes
+static const uint8_t FUNCTION_INDIVIDUAL_PACK_STATUS = 0x45;
 static const uint8_t FUNCTION_READ = 0x78;
 static const uint8_t FUNCTION_WRITE = 0x79;
 
-static const uint16_t ECOWORTHY_RESPONSE_TIMEOUT = 2000;
-static const uint16_t ECOWORTHY_MIN_MSG_LEN = 10;  // addr + func + start(2) + end(2) + len(2) + crc(2)
+static const uint16_t ECOWORTHY_FRAME_GAP = 100;  // Line silence that ends a partial frame
+static const uint16_t ECOWORTHY_HEADER_LEN = 8;     // addr + func + start(2) + end(2) + len(2)
+static const uint16_t ECOWORTHY_MAX_DATA_LEN = 512;
+static const uint16_t ECOWORTHY_MAX_FRAME_LEN = ECOWORTHY_HEADER_LEN + ECOWORTHY_MAX_DATA_LEN + 2;
+
+static_assert(EcoworthyModbus::RX_RING_SIZE >= ECOWORTHY_MAX_FRAME_LEN, "RX ring must hold a full frame");
+static_assert((EcoworthyModbus::RX_RING_SIZE & (EcoworthyModbus::RX_RING_SIZE - 1)) == 0,
+              "RX ring size must be a power of two");
+
+// CRC16/0xA001 lookup table, generated at compile time
+struct Crc16Table {
+  uint16_t values[256];
+};
+
+static constexpr Crc16Table make_crc16_table() {
+  Crc16Table table{};
+  for (uint16_t i = 0; i < 256; i++) {
+    uint16_t crc = i;
+    for (uint8_t j = 0; j < 8; j++) {
+      crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    table.values[i] = crc;
+  }
+  return table;
+}
+
+static constexpr Crc16Table CRC16_TABLE = make_crc16_table();
+
+static_assert(CRC16_TABLE.values[1] == 0xC0C1, "CRC16 table mismatch");
+static_assert(CRC16_TABLE.values[255] == 0x4040, "CRC16 table mismatch");
+
+static inline uint16_t crc16_ecoworthy_update(uint16_t crc, uint8_t byte) {
+  return (crc >> 8) ^ CRC16_TABLE.values[(crc ^ byte) & 0xFF];
+}
+
+static inline bool is_valid_function(uint8_t function) {
+  return function == FUNCTION_READ || function == FUNCTION_WRITE || function == FUNCTION_INDIVIDUAL_PACK_STATUS;
+}
+
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_DEBUG
+// Frames are logged as "01.78.10.00 (10)", at most this many bytes of them
+static const uint16_t LOG_HEX_MAX_BYTES = 32;
+static const size_t LOG_HEX_BUFFER_SIZE = LOG_HEX_MAX_BYTES * 3 + 8;
+
+// format_hex_pretty() into a stack buffer, so logging a frame does not allocate
+static const char *format_frame_hex(const uint8_t *data, uint16_t len, char *buffer) {
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+  const uint16_t shown = std::min(len, LOG_HEX_MAX_BYTES);
+  char *out = buffer;
+  for (uint16_t i = 0; i < shown; i++) {
+    if (i > 0) {
+      *out++ = '.';
+    }
+    *out++ = HEX_DIGITS[data[i] >> 4];
+    *out++ = HEX_DIGITS[data[i] & 0x0F];
+  }
+  snprintf(out, LOG_HEX_BUFFER_SIZE - (out - buffer), " (%u)", len);
+  return buffer;
+}
+#endif
 
 void EcoworthyModbus::setup() {
   if (this->flow_control_pin_ != nullptr) {
     this->flow_control_pin_->setup();
   }
+
+  // Address -> device lookup, used for dispatch and to find frame starts when resynchronizing
+  memset(this->device_index_, NO_DEVICE, sizeof(this->device_index_));
+  for (size_t index = 0; index < this->devices_.size(); index++) {
+    auto *device = this->devices_[index];
+    for (uint16_t i = 0; i < device->address_count_; i++) {
+      uint8_t address = device->address_ + i;
+      if (this->device_index_[address] != NO_DEVICE) {
+        ESP_LOGW(TAG, "Address 0x%02X is claimed by more than one device", address);
+      }
+      this->device_index_[address] = index;
+    }
+  }
+
+  uint16_t slot_count = 0;
+  for (auto *device : this->devices_) {
+    this->device_slot_base_.push_back(slot_count);
+    slot_count += device->address_count_;
+  }
+  // One more slot, shared by the addresses no device owns (e.g. one-off reads from a lambda)
+  this->unowned_slot_ = slot_count;
+  this->rtt_.resize((slot_count + 1) * RTT_CLASSES);
+  this->latency_.resize(slot_count + 1);
+  if (this->passive_) {
+    this->sniffed_frames_.resize(slot_count + 1);
+  }
+  for (const auto &sensors : this->address_latency_sensors_) {
+    if (this->device_index_[sensors.address] == NO_DEVICE) {
+      ESP_LOGW(TAG, "Latency sensors for address 0x%02X: no device polls this address", sensors.address);
+    }
+  }
+
+  if (this->parent_ != nullptr) {
+    this->bits_per_byte_ = 1 + this->parent_->get_data_bits() + this->parent_->get_stop_bits() +
+                           (this->parent_->get_parity() != uart::UART_CONFIG_PARITY_NONE ? 1 : 0);
+    this->byte_time_us_ = (this->bits_per_byte_ * 1000000UL + this->parent_->get_baud_rate() - 1) /
+                          this->parent_->get_baud_rate();
+  }
+
+  if (this->dropped_requests_sensor_ != nullptr) {
+    this->dropped_requests_sensor_->publish_state(0);
+  }
+
+  this->last_metrics_ = millis();
+  this->set_interval("metrics", this->metrics_interval_, [this]() { this->publish_metrics_(); });
 }
 
 void EcoworthyModbus::loop() {
+  const uint32_t start_us = micros();
+  this->release_tx_(start_us);
   const uint32_t now = millis();
 
   // Read incoming bytes
   while (this->available()) {
     uint8_t byte;
     this->read_byte(&byte);
-    if (this->parse_modbus_byte_(byte)) {
-      this->last_modbus_byte_ = now;
-    } else {
-      this->rx_buffer_.clear();
-    }
+    this->push_rx_byte_(byte);
+    this->last_modbus_byte_ = now;
+    this->rx_bytes_++;
   }
+  this->process_rx_();
 
-  // Check for timeout on current response
-  if (this->waiting_for_response_ && !this->rx_buffer_.empty() && 
-      (now - this->last_modbus_byte_ > ECOWORTHY_RESPONSE_TIMEOUT)) {
-    ESP_LOGW(TAG, "Response timeout");
-    this->rx_buffer_.clear();
-    this->waiting_for_response_ = false;
+  // A partial frame followed by line silence will never complete. Resync past it rather than
+  // discarding the buffer, since its bogus length may have swallowed the start of a valid frame.
+  if (this->rx_count_ > 0 && (now - this->last_modbus_byte_ > ECOWORTHY_FRAME_GAP)) {
+    ESP_LOGW(TAG, "Response timeout, discarding %u byte partial frame", this->rx_count_);
+    this->partial_frames_++;
+    while (this->rx_count_ > 0) {
+      this->resync_rx_();
+      this->process_rx_();
+    }
   }
 
   // Check for complete timeout (no response at all)
-  if (this->waiting_for_response_ && this->rx_buffer_.empty() && 
-      (now - this->last_send_ > ECOWORTHY_RESPONSE_TIMEOUT)) {
-    ESP_LOGW(TAG, "No response received");
-    this->waiting_for_response_ = false;
+  if (this->waiting_for_response_ && this->rx_count_ == 0 && (now - this->last_send_ > this->in_flight_timeout_)) {
+    this->on_timeout_();
   }
 
   // Send next request if not waiting for a response
-  if (!this->waiting_for_response_) {
+  if (!this->passive_ && !this->waiting_for_response_ && now - this->last_complete_ >= this->request_gap_) {
+    if (this->request_queue_.empty()) {
+      this->poll_idle_devices_();
+    }
     this->send_next_request_();
   }
+
+  this->max_loop_us_ = std::max(this->max_loop_us_, micros() - start_us);
 }
 
 void EcoworthyModbus::dump_config() {
   ESP_LOGCONFIG(TAG, "Ecoworthy Modbus:");
   ESP_LOGCONFIG(TAG, "  Flow control pin: %s", YESNO(this->flow_control_pin_ != nullptr));
+  ESP_LOGCONFIG(TAG, "  Request queue: %u reads, %u writes", ModbusRequestQueue::MAX_READS,
+                ModbusRequestQueue::MAX_WRITES);
+  ESP_LOGCONFIG(TAG, "  Response timeout: %u ms (adaptive, %u-%u ms)", this->response_timeout_,
+                this->min_response_timeout_, this->max_response_timeout_);
+  ESP_LOGCONFIG(TAG, "  Request gap: %u ms", this->request_gap_);
+  ESP_LOGCONFIG(TAG, "  Passive: %s", YESNO(this->passive_));
+  if (this->listen_before_talk_) {
+    ESP_LOGCONFIG(TAG, "  Listen before talk: guard time %u ms, collision backoff %u ms", this->guard_time_,
+                  this->collision_backoff_);
+  }
+  ESP_LOGCONFIG(TAG, "  Metrics interval: %u ms", this->metrics_interval_);
+  LOG_SENSOR("  ", "Dropped Requests", this->dropped_requests_sensor_);
+  LOG_SENSOR("  ", "Latency P50", this->latency_p50_sensor_);
+  LOG_SENSOR("  ", "Latency P95", this->latency_p95_sensor_);
+  LOG_SENSOR("  ", "Latency Max", this->latency_max_sensor_);
+  LOG_SENSOR("  ", "CRC Errors", this->crc_errors_sensor_);
+  LOG_SENSOR("  ", "Timeouts", this->timeouts_sensor_);
+  LOG_SENSOR("  ", "Partial Frames", this->partial_frames_sensor_);
+  LOG_SENSOR("  ", "TX Rate", this->tx_rate_sensor_);
+  LOG_SENSOR("  ", "RX Rate", this->rx_rate_sensor_);
+  LOG_SENSOR("  ", "Bus Utilization", this->bus_utilization_sensor_);
+  LOG_SENSOR("  ", "Queue Depth", this->queue_depth_sensor_);
+  LOG_SENSOR("  ", "Peak Queue Depth", this->peak_queue_depth_sensor_);
+  LOG_SENSOR("  ", "Sniffed Frames", this->sniffed_frames_sensor_);
+  LOG_SENSOR("  ", "Collisions", this->collisions_sensor_);
+  LOG_SENSOR("  ", "Deferrals", this->deferrals_sensor_);
+  for (const auto &sensors : this->address_latency_sensors_) {
+    ESP_LOGCONFIG(TAG, "  Latency of address 0x%02X:", sensors.address);
+    LOG_SENSOR("    ", "P50", sensors.p50);
+    LOG_SENSOR("    ", "P95", sensors.p95);
+    LOG_SENSOR("    ", "Max", sensors.max);
+  }
+}
+
+const uint16_t LatencyHistogram::BUCKET_LIMITS[LatencyHistogram::BUCKETS] = {
+    25, 50, 75, 100, 150, 200, 250, 300, 400, 500, 750, 1000, 1500, 2000, 3000, 0xFFFF,
+};
+
+void LatencyHistogram::add(uint32_t latency_ms) {
+  const uint16_t latency = std::min<uint32_t>(latency_ms, 0xFFFF);
+  uint8_t bucket = 0;
+  while (latency > BUCKET_LIMITS[bucket]) {
+    bucket++;
+  }
+  if (this->count == 0xFFFF) {
+    return;  // Saturated; only possible with a very long metrics interval
+  }
+  this->counts[bucket]++;
+  this->count++;
+  this->max_ms = std::max(this->max_ms, latency);
+}
+
+uint16_t LatencyHistogram::percentile(uint8_t percent) const {
+  // Rank of the sample at the given percentile, rounded up
+  const uint32_t rank = (uint32_t(this->count) * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t bucket = 0; bucket < BUCKETS; bucket++) {
+    seen += this->counts[bucket];
+    if (seen >= rank && seen > 0) {
+      return std::min(BUCKET_LIMITS[bucket], this->max_ms);
+    }
+  }
+  return this->max_ms;
+}
+
+void EcoworthyModbus::publish_metrics_() {
+  const uint32_t now = millis();
+  const float window_s = (now - this->last_metrics_) / 1000.0f;
+  this->last_metrics_ = now;
+
+  for (size_t index = 0; index < this->devices_.size(); index++) {
+    const auto *device = this->devices_[index];
+    for (uint16_t i = 0; i < device->address_count_; i++) {
+      const LatencyHistogram &latency = this->latency_[this->device_slot_base_[index] + i];
+      if (latency.count > 0) {
+        ESP_LOGD(TAG, "Latency 0x%02X: p50 %u ms, p95 %u ms, max %u ms (%u responses)", device->address_ + i,
+                 latency.percentile(50), latency.percentile(95), latency.max_ms, latency.count);
+      }
+    }
+  }
+
+  if (this->passive_) {
+    this->log_sniff_stats_();
+  }
+  ESP_LOGD(TAG, "Longest loop() call: %u us, longest transmit call: %u us", this->max_loop_us_,
+           this->max_transmit_us_);
+  this->max_loop_us_ = 0;
+  this->max_transmit_us_ = 0;
+  if (this->decode_frames_ > 0) {
+    ESP_LOGD(TAG, "Decoded %u frames: avg %u us, max %u us", this->decode_frames_,
+             this->decode_us_ / this->decode_frames_, this->max_decode_us_);
+  }
+  this->decode_frames_ = 0;
+  this->decode_us_ = 0;
+  this->max_decode_us_ = 0;
+
+  if (this->bus_latency_.count > 0) {
+    if (this->latency_p50_sensor_ != nullptr) {
+      this->latency_p50_sensor_->publish_state(this->bus_latency_.percentile(50));
+    }
+    if (this->latency_p95_sensor_ != nullptr) {
+      this->latency_p95_sensor_->publish_state(this->bus_latency_.percentile(95));
+    }
+    if (this->latency_max_sensor_ != nullptr) {
+      this->latency_max_sensor_->publish_state(this->bus_latency_.max_ms);
+    }
+  }
+  for (const auto &sensors : this->address_latency_sensors_) {
+    const LatencyHistogram &latency = this->latency_[this->address_slot_(sensors.address)];
+    if (latency.count == 0) {
+      continue;
+    }
+    if (sensors.p50 != nullptr) {
+      sensors.p50->publish_state(latency.percentile(50));
+    }
+    if (sensors.p95 != nullptr) {
+      sensors.p95->publish_state(latency.percentile(95));
+    }
+    if (sensors.max != nullptr) {
+      sensors.max->publish_state(latency.max_ms);
+    }
+  }
+  if (this->crc_errors_sensor_ != nullptr) {
+    this->crc_errors_sensor_->publish_state(this->crc_errors_);
+  }
+  if (this->timeouts_sensor_ != nullptr) {
+    this->timeouts_sensor_->publish_state(this->timeouts_);
+  }
+  if (this->partial_frames_sensor_ != nullptr) {
+    this->partial_frames_sensor_->publish_state(this->partial_frames_);
+  }
+  if (window_s > 0.0f) {
+    if (this->tx_rate_sensor_ != nullptr) {
+      this->tx_rate_sensor_->publish_state(this->tx_bytes_ / window_s);
+    }
+    if (this->rx_rate_sensor_ != nullptr) {
+      this->rx_rate_sensor_->publish_state(this->rx_bytes_ / window_s);
+    }
+    if (this->bus_utilization_sensor_ != nullptr && this->parent_ != nullptr) {
+      // Half duplex: time on the wire in either direction over the interval
+      const float wire_s = float(this->tx_bytes_ + this->rx_bytes_) * this->bits_per_byte_ /
+                           this->parent_->get_baud_rate();
+      this->bus_utilization_sensor_->publish_state(std::min(100.0f, wire_s / window_s * 100.0f));
+    }
+  }
+  if (this->queue_depth_sensor_ != nullptr) {
+    this->queue_depth_sensor_->publish_state(this->request_queue_.size());
+  }
+  if (this->peak_queue_depth_sensor_ != nullptr) {
+    this->peak_queue_depth_sensor_->publish_state(this->peak_queue_depth_);
+  }
+  if (this->sniffed_frames_sensor_ != nullptr) {
+    this->sniffed_frames_sensor_->publish_state(this->sniffed_responses_);
+  }
+  if (this->collisions_sensor_ != nullptr) {
+    this->collisions_sensor_->publish_state(this->collisions_);
+  }
+  if (this->deferrals_sensor_ != nullptr) {
+    this->deferrals_sensor_->publish_state(this->deferrals_);
+  }
+
+  for (auto &latency : this->latency_) {
+    latency.reset();
+  }
+  this->bus_latency_.reset();
+  this->tx_bytes_ = 0;
+  this->rx_bytes_ = 0;
+  this->peak_queue_depth_ = this->request_queue_.size();
 }
 
 float EcoworthyModbus::get_setup_priority() const { return setup_priority::DATA; }
@@ -66,200 +358,796 @@ float EcoworthyModbus::get_setup_priority() const { return setup_priority::DATA;
 uint16_t crc16_ecoworthy(const uint8_t *data, uint16_t len) {
   uint16_t crc = 0xFFFF;
   for (uint16_t i = 0; i < len; i++) {
-    crc ^= data[i];
-    for (uint8_t j = 0; j < 8; j++) {
-      if (crc & 0x0001) {
-        crc = (crc >> 1) ^ 0xA001;
-      } else {
-        crc >>= 1;
-      }
-    }
+    crc = crc16_ecoworthy_update(crc, data[i]);
   }
   return crc;
 }
 
-void EcoworthyModbus::send(uint8_t address, uint8_t function, uint16_t start_address, uint16_t end_address) {
-  // Add request to queue instead of sending immediately
+ModbusRequestQueue::PushResult ModbusRequestQueue::push(const ModbusRequest &request) {
+  if (request.is_write) {
+    if (this->write_count_ == MAX_WRITES) {
+      return PushResult::REJECTED;
+    }
+    this->writes_[(this->write_head_ + this->write_count_) % MAX_WRITES] = request;
+    this->write_count_++;
+    return PushResult::QUEUED;
+  }
+
+  for (uint8_t i = 0; i < this->read_count_; i++) {
+    if (this->reads_[(this->read_head_ + i) % MAX_READS].same_target(request)) {
+      return PushResult::COALESCED;
+    }
+  }
+
+  PushResult result = PushResult::QUEUED;
+  if (this->read_count_ == MAX_READS) {
+    this->read_head_ = (this->read_head_ + 1) % MAX_READS;
+    this->read_count_--;
+    result = PushResult::DROPPED_OLDEST;
+  }
+  this->reads_[(this->read_head_ + this->read_count_) % MAX_READS] = request;
+  this->read_count_++;
+  return result;
+}
+
+const ModbusRequest *ModbusRequestQueue::front() const {
+  if (this->write_count_ > 0) {
+    return &this->writes_[this->write_head_];
+  }
+  if (this->read_count_ > 0) {
+    return &this->reads_[this->read_head_];
+  }
+  return nullptr;
+}
+
+bool ModbusRequestQueue::pop(ModbusRequest &request) {
+  if (this->write_count_ > 0) {
+    request = this->writes_[this->write_head_];
+    this->write_head_ = (this->write_head_ + 1) % MAX_WRITES;
+    this->write_count_--;
+    return true;
+  }
+  if (this->read_count_ > 0) {
+    request = this->reads_[this->read_head_];
+    this->read_head_ = (this->read_head_ + 1) % MAX_READS;
+    this->read_count_--;
+    return true;
+  }
+  return false;
+}
+
+void EcoworthyModbus::queue_request_(const ModbusRequest &request) {
+  if (this->passive_) {
+    if (request.is_write) {
+      ESP_LOGW(TAG, "Passive mode, not sending write to address 0x%02X, register 0x%04X", request.address,
+               request.start_address);
+    }
+    return;
+  }
+
+  const auto result = this->request_queue_.push(request);
+  this->peak_queue_depth_ = std::max(this->peak_queue_depth_, this->request_queue_.size());
+
+  switch (result) {
+    case ModbusRequestQueue::PushResult::QUEUED:
+      ESP_LOGV(TAG, "Queued %s request for address 0x%02X, start=0x%04X, end=0x%04X, queue size: %u",
+               request.is_write ? "write" : "read", request.address, request.start_address, request.end_address,
+               this->request_queue_.size());
+      return;
+    case ModbusRequestQueue::PushResult::COALESCED:
+      ESP_LOGV(TAG, "Read request for address 0x%02X, start=0x%04X already pending", request.address,
+               request.start_address);
+      return;
+    case ModbusRequestQueue::PushResult::DROPPED_OLDEST:
+      ESP_LOGW(TAG, "Request queue full, dropped oldest pending read");
+      break;
+    case ModbusRequestQueue::PushResult::REJECTED:
+      ESP_LOGW(TAG, "Request queue full, rejected write to address 0x%02X, register 0x%04X", request.address,
+               request.start_address);
+      break;
+  }
+
+  this->dropped_requests_++;
+  if (this->dropped_requests_sensor_ != nullptr) {
+    this->dropped_requests_sensor_->publish_state(this->dropped_requests_);
+  }
+}
+
+// Header shared by read and write requests: addr(1) + func(1) + start_addr(2) + end_addr(2) + data_len(2)
+static void build_request_header(uint8_t *frame, uint8_t address, uint8_t function, uint16_t start_address,
+                                 uint16_t end_address, uint16_t data_len) {
+  frame[0] = address;
+  frame[1] = function;
+  frame[2] = start_address >> 8;
+  frame[3] = start_address & 0xFF;
+  frame[4] = end_address >> 8;
+  frame[5] = end_address & 0xFF;
+  frame[6] = data_len >> 8;
+  frame[7] = data_len & 0xFF;
+}
+
+static void append_crc(uint8_t *frame, size_t len) {
+  uint16_t crc = crc16_ecoworthy(frame, len);
+  frame[len] = crc & 0xFF;  // LSB first
+  frame[len + 1] = (crc >> 8) & 0xFF;
+}
+
+uint8_t EcoworthyModbus::register_read(uint8_t address, uint8_t function, uint16_t start_address,
+                                       uint16_t end_address) {
+  ReadFrame frame;
+  build_request_header(frame.data(), address, function, start_address, end_address, 0);
+  append_crc(frame.data(), ECOWORTHY_HEADER_LEN);
+
+  for (size_t id = 0; id < this->read_frames_.size(); id++) {
+    if (this->read_frames_[id] == frame) {
+      return id;
+    }
+  }
+  if (this->read_frames_.size() >= INVALID_READ_FRAME) {
+    ESP_LOGE(TAG, "Too many distinct read requests, ignoring 0x%02X 0x%04X", address, start_address);
+    return INVALID_READ_FRAME;
+  }
+
+  this->read_frames_.push_back(frame);
+  return this->read_frames_.size() - 1;
+}
+
+ModbusRequest EcoworthyModbus::read_request_(uint8_t frame_id) const {
+  const ReadFrame &frame = this->read_frames_[frame_id];
   ModbusRequest request;
-  request.address = address;
-  request.function = function;
-  request.start_address = start_address;
-  request.end_address = end_address;
+  request.address = frame[0];
+  request.function = frame[1];
+  request.start_address = (uint16_t(frame[2]) << 8) | frame[3];
+  request.end_address = (uint16_t(frame[4]) << 8) | frame[5];
   request.is_write = false;
-  
-  this->request_queue_.push(request);
-  
-  ESP_LOGV(TAG, "Queued read request for address 0x%02X, start=0x%04X, end=0x%04X, queue size: %d", 
-           address, start_address, end_address, this->request_queue_.size());
+  request.read_frame_id = frame_id;
+  return request;
+}
+
+void EcoworthyModbus::send_read(uint8_t frame_id) {
+  if (frame_id >= this->read_frames_.size()) {
+    return;
+  }
+  // Add request to queue instead of sending immediately
+  this->queue_request_(this->read_request_(frame_id));
+}
+
+uint32_t EcoworthyModbus::expected_duration_ms(uint8_t frame_id) {
+  if (frame_id >= this->read_frames_.size()) {
+    return 0;
+  }
+  return this->expected_duration_ms_(this->read_request_(frame_id));
+}
+
+uint32_t EcoworthyModbus::expected_duration_ms_(const ModbusRequest &request) {
+  // Round-trip times are measured from the end of the request, so they already include the response
+  // on the wire; only the request itself is added, timed the way transmit_() times it
+  const uint32_t request_bytes = request.is_write ? request.write_frame_len : ECOWORTHY_READ_FRAME_LEN;
+  const uint32_t wire_ms = ((request_bytes + 1) * this->byte_time_us_ + 999) / 1000;
+
+  const RttEstimator &rtt = this->rtt_for_(request);
+  if (rtt.samples > 0 && rtt.timeouts == 0) {
+    return wire_ms + (rtt.srtt_x8 >> 3);
+  }
+  return wire_ms + this->response_timeout_for_(request);
 }
 
-void EcoworthyModbus::send_write(uint8_t address, uint16_t start_address, uint16_t end_address, const std::vector<uint8_t> &data) {
-  // Add write request to queue
+void EcoworthyModbus::send(uint8_t address, uint8_t function, uint16_t start_address, uint16_t end_address) {
+  this->send_read(this->register_read(address, function, start_address, end_address));
+}
+
+void EcoworthyModbus::send_write(uint8_t address, uint16_t start_address, uint16_t end_address, const uint8_t *data,
+                                 uint8_t len) {
+  // Write commands include 0x114A4244 prefix ("JBD" with 0x11 prefix)
+  static const uint8_t WRITE_PREFIX[] = {0x11, 0x4A, 0x42, 0x44};
+
+  if (sizeof(WRITE_PREFIX) + len > ECOWORTHY_MAX_WRITE_DATA) {
+    ESP_LOGE(TAG, "Write to register 0x%04X too long (%u bytes)", start_address, len);
+    return;
+  }
+
+  // Serialize the complete frame into the request; the queue's write slots are its only storage
   ModbusRequest request;
   request.address = address;
   request.function = FUNCTION_WRITE;
   request.start_address = start_address;
   request.end_address = end_address;
   request.is_write = true;
-  
-  // Write commands include 0x114A4244 prefix ("JBD" with 0x11 prefix)
-  request.data.push_back(0x11);
-  request.data.push_back(0x4A);  // 'J'
-  request.data.push_back(0x42);  // 'B'
-  request.data.push_back(0x44);  // 'D'
-  // Append actual data
-  for (uint8_t b : data) {
-    request.data.push_back(b);
-  }
-  
-  this->request_queue_.push(request);
-  
-  ESP_LOGV(TAG, "Queued write request for address 0x%02X, start=0x%04X, end=0x%04X, data_len=%d, queue size: %d", 
-           address, start_address, end_address, request.data.size(), this->request_queue_.size());
+
+  const uint8_t data_len = sizeof(WRITE_PREFIX) + len;
+  build_request_header(request.write_frame, address, FUNCTION_WRITE, start_address, end_address, data_len);
+  std::copy(WRITE_PREFIX, WRITE_PREFIX + sizeof(WRITE_PREFIX), request.write_frame + ECOWORTHY_HEADER_LEN);
+  std::copy(data, data + len, request.write_frame + ECOWORTHY_HEADER_LEN + sizeof(WRITE_PREFIX));
+  append_crc(request.write_frame, ECOWORTHY_HEADER_LEN + data_len);
+  request.write_frame_len = ECOWORTHY_HEADER_LEN + data_len + 2;
+
+  this->queue_request_(request);
 }
 
 void EcoworthyModbus::send_next_request_() {
   if (this->request_queue_.empty() || this->waiting_for_response_) {
     return;
   }
+  if (this->listen_before_talk_ && !this->clear_to_send_(millis(), *this->request_queue_.front())) {
+    if (!this->deferring_) {
+      this->deferring_ = true;
+      this->deferrals_++;
+    }
+    return;
+  }
+  this->deferring_ = false;
 
-  ModbusRequest request = this->request_queue_.front();
-  this->request_queue_.pop();
+  ModbusRequest &request = this->in_flight_;
+  this->request_queue_.pop(request);
+  // Whatever the other master asked before is over once we talk
+  this->sniffed_request_pending_ = false;
 
   if (request.is_write) {
-    // Write frame format: addr(1) + func(1) + start_addr(2) + end_addr(2) + data_len(2) + data(n) + crc(2)
-    size_t frame_size = 8 + request.data.size() + 2;
-    std::vector<uint8_t> frame(frame_size);
-    
-    frame[0] = request.address;
-    frame[1] = request.function;
-    frame[2] = request.start_address >> 8;
-    frame[3] = request.start_address & 0xFF;
-    frame[4] = request.end_address >> 8;
-    frame[5] = request.end_address & 0xFF;
-    frame[6] = (request.data.size() >> 8) & 0xFF;
-    frame[7] = request.data.size() & 0xFF;
-    
-    // Copy data
-    for (size_t i = 0; i < request.data.size(); i++) {
-      frame[8 + i] = request.data[i];
-    }
-    
-    uint16_t crc = crc16_ecoworthy(frame.data(), frame_size - 2);
-    frame[frame_size - 2] = crc & 0xFF;        // LSB first
-    frame[frame_size - 1] = (crc >> 8) & 0xFF;
-
-    if (this->flow_control_pin_ != nullptr) {
-      this->flow_control_pin_->digital_write(true);
-    }
-
-    this->write_array(frame.data(), frame_size);
-    this->flush();
-
-    if (this->flow_control_pin_ != nullptr) {
-      this->flow_control_pin_->digital_write(false);
-    }
-
-    ESP_LOGD(TAG, "Sent write: %s", format_hex_pretty(frame.data(), std::min(frame_size, (size_t)32)).c_str());
+    this->transmit_(request.write_frame, request.write_frame_len);
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_DEBUG
+    char hex[LOG_HEX_BUFFER_SIZE];
+    ESP_LOGD(TAG, "Sent write: %s", format_frame_hex(request.write_frame, request.write_frame_len, hex));
+#endif
   } else {
-    // Read frame format: addr(1) + func(1) + start_addr(2) + end_addr(2) + data_len(2) + crc(2)
-    uint8_t frame[10];
-    frame[0] = request.address;
-    frame[1] = request.function;
-    frame[2] = request.start_address >> 8;
-    frame[3] = request.start_address & 0xFF;
-    frame[4] = request.end_address >> 8;
-    frame[5] = request.end_address & 0xFF;
-    frame[6] = 0x00;
-    frame[7] = 0x00;
+    const ReadFrame &frame = this->read_frames_[request.read_frame_id];
+    this->transmit_(frame.data(), frame.size());
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERBOSE
+    char hex[LOG_HEX_BUFFER_SIZE];
+    ESP_LOGV(TAG, "Sent read: %s", format_frame_hex(frame.data(), frame.size(), hex));
+#endif
+  }
 
-    uint16_t crc = crc16_ecoworthy(frame, 8);
-    frame[8] = crc & 0xFF;        // LSB first
-    frame[9] = (crc >> 8) & 0xFF;
+  this->in_flight_timeout_ = this->in_flight_wire_ms_ + this->response_timeout_for_(request);
+  this->waiting_for_response_ = true;
+}
 
-    if (this->flow_control_pin_ != nullptr) {
-      this->flow_control_pin_->digital_write(true);
+bool EcoworthyModbus::clear_to_send_(uint32_t now, const ModbusRequest &request) {
+  if (int32_t(this->backoff_until_ - now) > 0) {
+    return false;
+  }
+  if (now - this->last_modbus_byte_ < this->guard_time_) {
+    return false;  // Line still busy, or only just gone quiet
+  }
+  if (this->sniffed_request_pending_) {
+    if (now - this->foreign_request_time_ < this->max_response_timeout_) {
+      return false;  // The other master is waiting for its response
     }
+    // Its request went unanswered, so a response to the same block from now on is ours
+    this->sniffed_request_pending_ = false;
+  }
+  if (this->foreign_period_x8_ == 0) {
+    return true;  // No other master seen yet
+  }
+
+  // Our transaction has to end a guard time before the other master's next predicted request. If
+  // that request is more than a guard time overdue, the other master has gone quiet.
+  const uint32_t next_foreign = this->foreign_request_time_ + (this->foreign_period_x8_ >> 3);
+  const int32_t until_next = int32_t(next_foreign - now);
+  const uint32_t needed = this->expected_duration_ms_(request) + this->guard_time_;
+  return until_next >= int32_t(needed) || -until_next > int32_t(this->guard_time_);
+}
 
-    this->write_array(frame, 10);
-    this->flush();
+void EcoworthyModbus::on_collision_(uint32_t now) {
+  this->collisions_++;
+  // Randomized binary exponential backoff, capped at 16 times the base
+  const uint32_t window = this->collision_backoff_ << std::min<uint8_t>(this->collision_streak_, 4);
+  const uint32_t backoff = window > 0 ? random_uint32() % window : 0;
+  this->backoff_until_ = now + backoff;
+  if (this->collision_streak_ < 255) {
+    this->collision_streak_++;
+  }
+  ESP_LOGD(TAG, "Collision on the bus, backing off %u ms", backoff);
+}
 
-    if (this->flow_control_pin_ != nullptr) {
-      this->flow_control_pin_->digital_write(false);
+void EcoworthyModbus::poll_idle_devices_() {
+  const uint8_t count = this->devices_.size();
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t index = (this->next_idle_device_ + i) % count;
+    if (this->devices_[index]->on_bus_idle()) {
+      this->next_idle_device_ = (index + 1) % count;
+      return;
     }
+  }
+}
 
-    ESP_LOGV(TAG, "Sent read: %s", format_hex_pretty(frame, 10).c_str());
+void EcoworthyModbus::transmit_(const uint8_t *frame, size_t len) {
+  const uint32_t start = micros();
+
+  if (this->flow_control_pin_ != nullptr) {
+    this->flow_control_pin_->digital_write(true);
   }
-  
+
+  // Hand the frame to the UART driver without waiting for it to drain. The driver buffers it and
+  // loop() releases the direction pin once the last stop bit is on the wire.
+  this->write_array(frame, len);
+  this->tx_bytes_ += len;
+
+  // One extra character time covers the driver starting the transfer slightly after write_array()
+  const uint32_t wire_us = (len + 1) * this->byte_time_us_;
+  this->in_flight_wire_ms_ = (wire_us + 999) / 1000;
   this->last_send_ = millis();
-  this->waiting_for_response_ = true;
+  if (this->flow_control_pin_ != nullptr) {
+    this->tx_done_us_ = start + wire_us;
+    this->tx_active_ = true;
+    this->high_freq_.start();  // Run loop() often enough to release the pin on time
+  }
+
+  const uint32_t elapsed = micros() - start;
+  this->max_transmit_us_ = std::max(this->max_transmit_us_, elapsed);
 }
 
-bool EcoworthyModbus::parse_modbus_byte_(uint8_t byte) {
-  const uint32_t now = millis();
-  
-  // Start of new frame if buffer is empty or timeout occurred
-  if (this->rx_buffer_.empty()) {
-    this->rx_buffer_.push_back(byte);
-    return true;
+void EcoworthyModbus::release_tx_(uint32_t now_us) {
+  if (!this->tx_active_ || int32_t(now_us - this->tx_done_us_) < 0) {
+    return;
   }
+  this->flow_control_pin_->digital_write(false);
+  this->tx_active_ = false;
+  this->high_freq_.stop();
+}
 
-  this->rx_buffer_.push_back(byte);
-  const uint8_t *raw = &this->rx_buffer_[0];
-  const size_t len = this->rx_buffer_.size();
+void RttEstimator::add_sample(uint32_t rtt_ms) {
+  if (this->samples == 0) {
+    this->srtt_x8 = rtt_ms << 3;
+    this->rttvar_x4 = rtt_ms << 1;
+  } else {
+    // srtt += (rtt - srtt) / 8, rttvar += (|rtt - srtt| - rttvar) / 4
+    int32_t error = int32_t(rtt_ms) - int32_t(this->srtt_x8 >> 3);
+    this->srtt_x8 += error;
+    if (error < 0) {
+      error = -error;
+    }
+    this->rttvar_x4 += error - int32_t(this->rttvar_x4 >> 2);
+  }
+  if (this->samples < 255) {
+    this->samples++;
+  }
+  this->timeouts = 0;
+}
 
-  // Wait for minimum message length (header)
-  if (len < ECOWORTHY_MIN_MSG_LEN) {
-    return true;
+// Block size class by requested register span: writes and short reads, mid-size blocks, full blocks
+static uint8_t block_size_class(const ModbusRequest &request) {
+  const uint16_t span = request.end_address - request.start_address;
+  return span <= 0x20 ? 0 : (span <= 0x80 ? 1 : 2);
+}
+
+RttEstimator &EcoworthyModbus::rtt_for_(const ModbusRequest &request) {
+  const uint8_t size_class = block_size_class(request);
+  return this->rtt_[this->address_slot_(request.address) * RTT_CLASSES + size_class];
+}
+
+uint16_t EcoworthyModbus::address_slot_(uint8_t address) const {
+  const uint8_t index = this->device_index_[address];
+  if (index == NO_DEVICE) {
+    return this->unowned_slot_;
   }
+  return this->device_slot_base_[index] + (address - this->devices_[index]->address_);
+}
 
-  // Check if we have a complete frame
-  // Response format: addr(1) + func(1) + start_addr(2) + end_addr(2) + data_len(2) + data(n) + crc(2)
-  uint8_t address = raw[0];
-  uint8_t function = raw[1];
-
-  // Get data length from header
-  uint16_t data_length = (uint16_t(raw[6]) << 8) | uint16_t(raw[7]);
-  
-  // Expected total length: 8 (header) + data_length + 2 (crc)
-  size_t expected_len = 8 + data_length + 2;
-  
-  // Sanity check on data length
-  if (data_length > 512) {
-    ESP_LOGW(TAG, "Invalid data length: %d", data_length);
-    this->rx_buffer_.clear();
-    return false;
+uint32_t EcoworthyModbus::response_timeout_for_(const ModbusRequest &request) {
+  const RttEstimator &rtt = this->rtt_for_(request);
+  const RttEstimator &bus_rtt = this->bus_rtt_[block_size_class(request)];
+
+  uint32_t timeout;
+  if (rtt.samples > 0) {
+    timeout = rtt.timeout();
+  } else if (bus_rtt.samples > 0) {
+    timeout = bus_rtt.timeout();
+  } else {
+    return this->response_timeout_;
+  }
+
+  // Give an address that just missed a response one doubled window before it is written off as
+  // offline, so a pack that merely slowed down can still produce a sample. No further back-off: an
+  // offline pack should keep costing as little bus time as possible.
+  if (rtt.timeouts > 0) {
+    timeout *= 2;
   }
 
-  if (len < expected_len) {
-    return true;  // Need more data
+  return std::clamp(timeout, this->min_response_timeout_, this->max_response_timeout_);
+}
+
+void EcoworthyModbus::on_response_(uint32_t now) {
+  // Completion is the arrival of the last byte, not the loop pass that parsed it
+  const uint32_t elapsed = now - this->last_send_;
+  const uint32_t rtt_ms = std::min(elapsed > this->in_flight_wire_ms_ ? elapsed - this->in_flight_wire_ms_ : 0,
+                                   this->max_response_timeout_);
+  RttEstimator &rtt = this->rtt_for_(this->in_flight_);
+  rtt.add_sample(rtt_ms);
+  this->bus_rtt_[block_size_class(this->in_flight_)].add_sample(rtt_ms);
+  this->latency_[this->address_slot_(this->in_flight_.address)].add(rtt_ms);
+  this->bus_latency_.add(rtt_ms);
+
+  ESP_LOGV(TAG, "Response from 0x%02X after %u ms, timeout now %u ms", this->in_flight_.address, rtt_ms,
+           this->response_timeout_for_(this->in_flight_));
+  this->waiting_for_response_ = false;  // Ready for next request
+  this->last_complete_ = now;
+  this->collision_streak_ = 0;
+}
+
+void EcoworthyModbus::on_timeout_() {
+  ESP_LOGW(TAG, "No response received from 0x%02X within %u ms", this->in_flight_.address,
+           this->in_flight_timeout_);
+  this->timeouts_++;
+  RttEstimator &rtt = this->rtt_for_(this->in_flight_);
+  if (rtt.timeouts < 255) {
+    rtt.timeouts++;
+  }
+  this->waiting_for_response_ = false;
+  this->last_complete_ = millis();
+}
+
+bool EcoworthyModbus::is_known_address_(uint8_t address) const {
+  return this->device_index_[address] != NO_DEVICE;
+}
+
+void EcoworthyModbus::push_rx_byte_(uint8_t byte) {
+  if (this->rx_count_ == RX_RING_SIZE) {
+    // A full ring without a complete frame can only be noise; drop the oldest byte and rescan
+    this->resync_rx_();
   }
+  this->rx_ring_[(this->rx_head_ + this->rx_count_) & (RX_RING_SIZE - 1)] = byte;
+  this->rx_count_++;
+}
+
+void EcoworthyModbus::consume_rx_(uint16_t len) {
+  this->rx_count_ -= len;
+  // Restart at the beginning of the ring whenever it empties, so frames rarely wrap
+  this->rx_head_ = this->rx_count_ == 0 ? 0 : (this->rx_head_ + len) & (RX_RING_SIZE - 1);
+  this->reset_rx_();
+}
+
+void EcoworthyModbus::clear_rx_() { this->consume_rx_(this->rx_count_); }
 
-  if (len >= expected_len) {
-    // Verify CRC (calculated over entire frame minus CRC itself)
-    uint16_t crc_calc = crc16_ecoworthy(raw, expected_len - 2);
-    uint16_t crc_recv = raw[expected_len - 2] | (raw[expected_len - 1] << 8);  // LSB first
+void EcoworthyModbus::reset_rx_() {
+  this->rx_state_ = RxState::HEADER;
+  this->rx_parsed_ = 0;
+  this->rx_expected_len_ = 0;
+  this->rx_crc_ = 0xFFFF;
+}
+
+void EcoworthyModbus::resync_rx_() {
+  // The candidate frame starting at rx_head_ is bad, but it may have swallowed the start of a
+  // valid one. Slide forward to the next plausible header (known address followed by a known
+  // function code) and re-parse the bytes already buffered from there.
+  uint16_t skipped = 0;
+  do {
+    this->consume_rx_(1);
+    skipped++;
+  } while (this->rx_count_ > 0 &&
+           (!this->is_known_address_(this->rx_at_(0)) ||
+            (this->rx_count_ > 1 && !is_valid_function(this->rx_at_(1)))));
 
-    if (crc_calc != crc_recv) {
-      ESP_LOGW(TAG, "CRC check failed! Calculated: 0x%04X, Received: 0x%04X", crc_calc, crc_recv);
-      this->rx_buffer_.clear();
-      return false;
+  ESP_LOGV(TAG, "Resynchronized after skipping %u bytes, %u bytes buffered", skipped, this->rx_count_);
+}
+
+void EcoworthyModbus::process_rx_() {
+  while (this->rx_parsed_ < this->rx_count_) {
+    uint8_t byte = this->rx_at_(this->rx_parsed_++);
+    switch (this->parse_modbus_byte_(byte)) {
+      case RxResult::NEED_MORE:
+        break;
+      case RxResult::FRAME:
+        if (this->passive_) {
+          this->on_sniffed_frame_();
+        } else if (this->listen_before_talk_ && this->is_request_frame_()) {
+          this->on_foreign_request_();
+        } else if (this->listen_before_talk_ &&
+                   !(this->waiting_for_response_ && this->rx_targets_(this->in_flight_)) &&
+                   this->on_foreign_response_()) {
+          // Answer to the other master, already decoded. Both masters may poll the same block, so
+          // a response matching our own request is always taken as ours.
+        } else if (this->matches_in_flight_()) {
+          this->on_response_(this->last_modbus_byte_);
+          this->dispatch_frame_();
+        }
+        this->consume_rx_(this->rx_expected_len_);
+        break;
+      case RxResult::INVALID:
+        this->resync_rx_();
+        break;
     }
+  }
+}
 
-    ESP_LOGV(TAG, "Received %d bytes: %s", expected_len, format_hex_pretty(raw, std::min(expected_len, (size_t)32)).c_str());
+EcoworthyModbus::RxResult EcoworthyModbus::parse_modbus_byte_(uint8_t byte) {
+  // Response format: addr(1) + func(1) + start_addr(2) + end_addr(2) + data_len(2) + data(n) + crc(2)
+  // The CRC is updated as each byte arrives, so validation at the last byte is a single compare.
+  const uint16_t len = this->rx_parsed_;
 
-    // Dispatch to devices
-    for (auto *device : this->devices_) {
-      device->on_modbus_data(this->rx_buffer_);
+  switch (this->rx_state_) {
+    case RxState::HEADER: {
+      if (len == 1 && !this->is_known_address_(byte)) {
+        return RxResult::INVALID;
+      }
+      if (len == 2 && !is_valid_function(byte)) {
+        return RxResult::INVALID;
+      }
+      this->rx_crc_ = crc16_ecoworthy_update(this->rx_crc_, byte);
+      if (len < ECOWORTHY_HEADER_LEN) {
+        return RxResult::NEED_MORE;
+      }
+
+      uint16_t data_length = (uint16_t(this->rx_at_(6)) << 8) | uint16_t(this->rx_at_(7));
+      if (data_length > ECOWORTHY_MAX_DATA_LEN) {
+        ESP_LOGW(TAG, "Invalid data length: %u", data_length);
+        return RxResult::INVALID;
+      }
+
+      // Expected total length: 8 (header) + data_length + 2 (crc)
+      this->rx_expected_len_ = ECOWORTHY_HEADER_LEN + data_length + 2;
+      this->rx_state_ = data_length > 0 ? RxState::PAYLOAD : RxState::CRC;
+      return RxResult::NEED_MORE;
     }
 
-    this->rx_buffer_.clear();
-    this->waiting_for_response_ = false;  // Ready for next request
-    return true;
+    case RxState::PAYLOAD:
+      this->rx_crc_ = crc16_ecoworthy_update(this->rx_crc_, byte);
+      if (len == this->rx_expected_len_ - 2u) {
+        this->rx_state_ = RxState::CRC;
+      }
+      return RxResult::NEED_MORE;
+
+    case RxState::CRC:
+      break;
+  }
+
+  if (len < this->rx_expected_len_) {
+    return RxResult::NEED_MORE;  // Need the second CRC byte
+  }
+
+  const uint16_t expected_len = this->rx_expected_len_;
+  uint16_t crc_recv = this->rx_at_(expected_len - 2) | (this->rx_at_(expected_len - 1) << 8);  // LSB first
+  if (this->rx_crc_ != crc_recv) {
+    ESP_LOGW(TAG, "CRC check failed! Calculated: 0x%04X, Received: 0x%04X", this->rx_crc_, crc_recv);
+    this->crc_errors_++;
+    if (this->listen_before_talk_ && this->waiting_for_response_) {
+      this->on_collision_(millis());
+    }
+    return RxResult::INVALID;
+  }
+
+  return RxResult::FRAME;
+}
+
+bool EcoworthyModbus::rx_targets_(const ModbusRequest &request) const {
+  return this->rx_at_(0) == request.address && this->rx_at_(1) == request.function &&
+         ((uint16_t(this->rx_at_(2)) << 8) | this->rx_at_(3)) == request.start_address &&
+         ((uint16_t(this->rx_at_(4)) << 8) | this->rx_at_(5)) == request.end_address;
+}
+
+bool EcoworthyModbus::matches_in_flight_() const {
+  const uint8_t address = this->rx_at_(0);
+  const uint8_t function = this->rx_at_(1);
+  const uint16_t start_address = (uint16_t(this->rx_at_(2)) << 8) | uint16_t(this->rx_at_(3));
+  const uint16_t end_address = (uint16_t(this->rx_at_(4)) << 8) | uint16_t(this->rx_at_(5));
+
+  if (!this->waiting_for_response_) {
+    // Typically a late answer to a request that already timed out
+    ESP_LOGW(TAG, "Ignoring unsolicited frame from 0x%02X (function 0x%02X, start 0x%04X)", address, function,
+             start_address);
+    return false;
+  }
+
+  const ModbusRequest &request = this->in_flight_;
+  if (!this->rx_targets_(request)) {
+    ESP_LOGW(TAG, "Ignoring frame from 0x%02X (function 0x%02X, 0x%04X-0x%04X) while waiting for 0x%02X "
+                  "(function 0x%02X, 0x%04X-0x%04X)",
+             address, function, start_address, end_address, request.address, request.function,
+             request.start_address, request.end_address);
+    return false;
   }
 
   return true;
 }
 
+void EcoworthyModbus::linearize_rx_() {
+  if (this->rx_head_ + this->rx_expected_len_ <= RX_RING_SIZE) {
+    return;
+  }
+  // The frame wraps around the end of the ring; rotate the ring so everything buffered starts at 0
+  std::rotate(this->rx_ring_, this->rx_ring_ + this->rx_head_, this->rx_ring_ + RX_RING_SIZE);
+  this->rx_head_ = 0;
+}
+
+void EcoworthyModbus::on_sniffed_frame_() {
+  this->linearize_rx_();
+  const FrameView frame(&this->rx_ring_[this->rx_head_], this->rx_expected_len_);
+
+  if (this->is_request_frame_()) {
+    this->on_foreign_request_();
+    this->last_send_ = this->last_modbus_byte_;
+    return;
+  }
+
+  // Pair the response with the request before it, so response times are measured as when polling
+  if (this->sniffed_request_pending_ && frame.address() == this->sniffed_request_.address &&
+      frame.function() == this->sniffed_request_.function &&
+      frame.start_address() == this->sniffed_request_.start_address &&
+      frame.end_address() == this->sniffed_request_.end_address) {
+    this->in_flight_ = this->sniffed_request_;
+    this->in_flight_wire_ms_ = 0;
+    this->on_response_(this->last_modbus_byte_);
+  } else {
+    this->unpaired_responses_++;
+  }
+  this->sniffed_request_pending_ = false;
+
+  this->sniffed_responses_++;
+  this->sniffed_frames_[this->address_slot_(frame.address())]++;
+  uint8_t block = 0;
+  while (block < this->sniffed_block_count_ && (this->sniffed_blocks_[block].function != frame.function() ||
+                                                this->sniffed_blocks_[block].start_address != frame.start_address())) {
+    block++;
+  }
+  if (block == this->sniffed_block_count_ && block < MAX_SNIFFED_BLOCKS) {
+    this->sniffed_blocks_[block] = {frame.function(), frame.start_address(), 0};
+    this->sniffed_block_count_++;
+  }
+  if (block < this->sniffed_block_count_) {
+    this->sniffed_blocks_[block].frames++;
+  }
+
+  // The response header names its register range, so it decodes the same whether paired or not
+  this->dispatch_frame_();
+}
+
+bool EcoworthyModbus::is_request_frame_() const {
+  // Requests and write acknowledgements carry no data; write requests and read responses do
+  const bool is_write = this->rx_at_(1) == FUNCTION_WRITE;
+  const bool has_data = this->rx_at_(6) != 0 || this->rx_at_(7) != 0;
+  return is_write == has_data;
+}
+
+void EcoworthyModbus::on_foreign_request_() {
+  ModbusRequest request;
+  request.address = this->rx_at_(0);
+  request.function = this->rx_at_(1);
+  request.start_address = (uint16_t(this->rx_at_(2)) << 8) | this->rx_at_(3);
+  request.end_address = (uint16_t(this->rx_at_(4)) << 8) | this->rx_at_(5);
+  request.is_write = request.function == FUNCTION_WRITE;
+  if (this->waiting_for_response_ && request.same_target(this->in_flight_)) {
+    return;  // Our own request, echoed back by a transceiver that does not disable its receiver
+  }
+  this->sniffed_request_ = request;
+  this->sniffed_request_pending_ = true;
+  this->sniffed_requests_++;
+
+  const uint32_t now = this->last_modbus_byte_;
+  if (this->listen_before_talk_) {
+    if (this->sniffed_requests_ > 1) {
+      const uint32_t period = now - this->foreign_request_time_;
+      if (this->foreign_period_x8_ == 0) {
+        this->foreign_period_x8_ = period << 3;
+      } else {
+        this->foreign_period_x8_ += period - (this->foreign_period_x8_ >> 3);
+      }
+    }
+    // Another master started talking while we wait for our answer
+    if (this->waiting_for_response_) {
+      this->on_collision_(now);
+    }
+  }
+  this->foreign_request_time_ = now;
+}
+
+bool EcoworthyModbus::on_foreign_response_() {
+  if (!this->sniffed_request_pending_ || !this->rx_targets_(this->sniffed_request_)) {
+    return false;
+  }
+  // The other master's transaction is over; its data is as good as ours
+  this->sniffed_request_pending_ = false;
+  this->sniffed_responses_++;
+  this->dispatch_frame_();
+  return true;
+}
+
+void EcoworthyModbus::log_sniff_stats_() {
+  ESP_LOGD(TAG, "Sniffed %u requests, %u responses (%u unpaired)", this->sniffed_requests_, this->sniffed_responses_,
+           this->unpaired_responses_);
+  for (size_t index = 0; index < this->devices_.size(); index++) {
+    const auto *device = this->devices_[index];
+    for (uint16_t i = 0; i < device->address_count_; i++) {
+      ESP_LOGD(TAG, "  Address 0x%02X: %u responses", device->address_ + i,
+               this->sniffed_frames_[this->device_slot_base_[index] + i]);
+    }
+  }
+  for (uint8_t block = 0; block < this->sniffed_block_count_; block++) {
+    const SniffedBlock &sniffed = this->sniffed_blocks_[block];
+    ESP_LOGD(TAG, "  Function 0x%02X, block 0x%04X: %u responses", sniffed.function, sniffed.start_address,
+             sniffed.frames);
+  }
+}
+
+void EcoworthyModbus::dispatch_frame_() {
+  this->linearize_rx_();
+  const FrameView frame(&this->rx_ring_[this->rx_head_], this->rx_expected_len_);
+
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERBOSE
+  char hex[LOG_HEX_BUFFER_SIZE];
+  ESP_LOGV(TAG, "Received %u bytes: %s", frame.size(), format_frame_hex(frame.data(), frame.size(), hex));
+#endif
+
+  // Addresses without a device never get this far: the parser rejects them as frame starts
+  const uint32_t start = micros();
+  this->devices_[this->device_index_[frame.address()]]->on_modbus_data(frame);
+  const uint32_t elapsed = micros() - start;
+  this->decode_frames_++;
+  this->decode_us_ += elapsed;
+  this->max_decode_us_ = std::max(this->max_decode_us_, elapsed);
+}
+
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+#ifdef USE_ESP8266
+// Single core without atomic instructions. An interrupt that allocates in the middle of the increment
+// can lose one count, which is acceptable for a diagnostic.
+static volatile uint32_t allocations = 0;
+
+static void count_allocation() { allocations = allocations + 1; }
+uint32_t heap_allocation_count() { return allocations; }
+#else
+static std::atomic<uint32_t> allocations{0};
+
+static void count_allocation() { allocations.fetch_add(1, std::memory_order_relaxed); }
+uint32_t heap_allocation_count() { return allocations.load(std::memory_order_relaxed); }
+#endif
+#endif
+
 }  // namespace ecoworthy_modbus
 }  // namespace esphome
+
+#if defined(USE_ECOWORTHY_ALLOCATION_COUNTER) && defined(USE_HOST)
+// Replaces the global allocation functions to count calls; the nothrow forms end up here too
+void *operator new(size_t size) {
+  esphome::ecoworthy_modbus::count_allocation();
+  void *ptr = std::malloc(size != 0 ? size : 1);
+  if (ptr == nullptr) {
+    std::abort();
+  }
+  return ptr;
+}
+void *operator new[](size_t size) { return ::operator new(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+// Over-aligned types; aligned_alloc() wants the size rounded up to a multiple of the alignment
+void *operator new(size_t size, std::align_val_t alignment) {
+  esphome::ecoworthy_modbus::count_allocation();
+  const size_t align = static_cast<size_t>(alignment);
+  const size_t rounded = size != 0 ? (size + align - 1) / align * align : align;
+  void *ptr = std::aligned_alloc(align, rounded);
+  if (ptr == nullptr) {
+    std::abort();
+  }
+  return ptr;
+}
+void *operator new[](size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+#endif
+
+#if defined(USE_ECOWORTHY_ALLOCATION_COUNTER) && (defined(USE_ESP32) || defined(USE_ESP8266))
+// The firmware is linked with --wrap for these (see sensor.py), so every call, including those from
+// operator new and prebuilt libraries, comes here first. The ESP8266 Wi-Fi SDK is the exception: it
+// allocates through pvPortMalloc(), which goes to umm_malloc directly.
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  esphome::ecoworthy_modbus::count_allocation();
+  return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size) {
+  esphome::ecoworthy_modbus::count_allocation();
+  return __real_calloc(count, size);
+}
+void *__wrap_realloc(void *ptr, size_t size) {
+  esphome::ecoworthy_modbus::count_allocation();
+  return __real_realloc(ptr, size);
+}
+}
+#endif
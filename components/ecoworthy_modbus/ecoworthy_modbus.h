@@ -1,28 +1,175 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/sensor/sensor.h"
 #include "esphome/components/uart/uart.h"
-#include <queue>
+
+#include <array>
+#include <cstring>
 
 namespace esphome {
 namespace ecoworthy_modbus {
 
 class EcoworthyModbusDevice;
 
+static const uint8_t ECOWORTHY_MAX_WRITE_DATA = 16;  // 0x114A4244 prefix + register values
+static const uint8_t ECOWORTHY_READ_FRAME_LEN = 10;
+static const uint8_t ECOWORTHY_MAX_WRITE_FRAME_LEN = 8 + ECOWORTHY_MAX_WRITE_DATA + 2;
+
 // Ecoworthy/JBD BMS uses a custom Modbus-like protocol
 // Function codes: 0x78 = read, 0x79 = write
 // CRC: CRC16 with initial=0xFFFF, polynomial=0xA001, LSB first
+
+// Read requests never change, so their frames are built once and referenced by id; write
+// requests carry their complete serialized frame.
 struct ModbusRequest {
   uint8_t address;
   uint8_t function;
   uint16_t start_address;
   uint16_t end_address;
-  std::vector<uint8_t> data;  // For write commands
   bool is_write;
+  uint8_t read_frame_id;    // Reads: EcoworthyModbus::register_read() id
+  uint8_t write_frame_len;  // Writes: bytes used in write_frame
+  uint8_t write_frame[ECOWORTHY_MAX_WRITE_FRAME_LEN];
+
+  bool same_target(const ModbusRequest &other) const {
+    return this->address == other.address && this->function == other.function &&
+           this->start_address == other.start_address && this->end_address == other.end_address;
+  }
+};
+
+// Fixed-capacity request queue. Writes always go out before reads. A read for the same
+// address/function/range as one already pending is coalesced into it. When the read slots are
+// full the oldest pending read is dropped, since a newer poll supersedes it; when the write slots
+// are full the new write is rejected, as writes must never be silently reordered or replaced.
+class ModbusRequestQueue {
+ public:
+  static const uint8_t MAX_READS = 16;
+  static const uint8_t MAX_WRITES = 4;
+
+  enum class PushResult : uint8_t {
+    QUEUED,
+    COALESCED,
+    DROPPED_OLDEST,
+    REJECTED,
+  };
+
+  PushResult push(const ModbusRequest &request);
+  bool pop(ModbusRequest &request);
+  // Request pop() would return next, or nullptr when empty
+  const ModbusRequest *front() const;
+  bool empty() const { return this->read_count_ == 0 && this->write_count_ == 0; }
+  uint8_t size() const { return this->read_count_ + this->write_count_; }
+
+ protected:
+  ModbusRequest reads_[MAX_READS];
+  ModbusRequest writes_[MAX_WRITES];
+  uint8_t read_head_{0};
+  uint8_t read_count_{0};
+  uint8_t write_head_{0};
+  uint8_t write_count_{0};
+};
+
+// Smoothed round-trip time and variance (RFC 6298), in fixed point: srtt * 8 and rttvar * 4 ms
+struct RttEstimator {
+  uint32_t srtt_x8{0};
+  uint32_t rttvar_x4{0};
+  uint8_t samples{0};
+  uint8_t timeouts{0};  // Consecutive requests that went unanswered
+
+  void add_sample(uint32_t rtt_ms);
+  // srtt + 4 * rttvar
+  uint32_t timeout() const { return (this->srtt_x8 >> 3) + this->rttvar_x4; }
+};
+
+// Read-only view of a received, CRC-checked frame. It points into the receive buffer and is only
+// valid for the duration of EcoworthyModbusDevice::on_modbus_data(). Payload accessors take byte
+// offsets relative to the start of the data and return 0 for fields past the end of the data.
+class FrameView {
+ public:
+  FrameView(const uint8_t *frame, uint16_t len)
+      : frame_(frame),
+        len_(len),
+        start_address_((uint16_t(frame[2]) << 8) | frame[3]),
+        end_address_((uint16_t(frame[4]) << 8) | frame[5]),
+        data_length_((uint16_t(frame[6]) << 8) | frame[7]) {}
+
+  uint8_t address() const { return this->frame_[0]; }
+  uint8_t function() const { return this->frame_[1]; }
+  uint16_t start_address() const { return this->start_address_; }
+  uint16_t end_address() const { return this->end_address_; }
+  uint16_t data_length() const { return this->data_length_; }
+
+  // The whole frame including header and CRC
+  const uint8_t *data() const { return this->frame_; }
+  uint16_t size() const { return this->len_; }
+
+  bool has(size_t offset, size_t width) const { return offset + width <= this->data_length_; }
+  uint8_t get_u8(size_t offset) const { return this->has(offset, 1) ? this->payload_()[offset] : 0; }
+  uint16_t get_u16(size_t offset) const {
+    if (!this->has(offset, 2))
+      return 0;
+    const uint8_t *p = this->payload_() + offset;
+    return (uint16_t(p[0]) << 8) | uint16_t(p[1]);
+  }
+  uint32_t get_u32(size_t offset) const {
+    if (!this->has(offset, 4))
+      return 0;
+    const uint8_t *p = this->payload_() + offset;
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+  }
+  // Fixed-width text field, cut at the first NUL and copied into buffer, which must hold width + 1
+  // bytes; empty if the field is not fully present. Returns the string length.
+  size_t get_string(size_t offset, size_t width, char *buffer) const {
+    size_t length = 0;
+    if (this->has(offset, width)) {
+      const char *p = reinterpret_cast<const char *>(this->payload_() + offset);
+      length = strnlen(p, width);
+      memcpy(buffer, p, length);
+    }
+    buffer[length] = '\0';
+    return length;
+  }
+
+ protected:
+  const uint8_t *payload_() const { return this->frame_ + 8; }
+
+  const uint8_t *frame_;
+  uint16_t len_;
+  uint16_t start_address_;
+  uint16_t end_address_;
+  uint16_t data_length_;
+};
+
+// Response latency histogram with fixed millisecond buckets
+struct LatencyHistogram {
+  static const uint8_t BUCKETS = 16;
+  static const uint16_t BUCKET_LIMITS[BUCKETS];  // Inclusive upper bound of each bucket, in ms
+
+  uint16_t counts[BUCKETS]{};
+  uint16_t count{0};
+  uint16_t max_ms{0};
+
+  void add(uint32_t latency_ms);
+  // Upper bound of the bucket holding the given percentile, capped at the largest sample
+  uint16_t percentile(uint8_t percent) const;
+  void reset() { *this = LatencyHistogram(); }
+};
+
+// Latency sensors of one battery address; any of them may be null
+struct AddressLatencySensors {
+  uint8_t address;
+  sensor::Sensor *p50;
+  sensor::Sensor *p95;
+  sensor::Sensor *max;
 };
 
 class EcoworthyModbus : public uart::UARTDevice, public Component {
  public:
+  // Fixed receive ring; holds a maximum-size frame (8 + 512 + 2 bytes) plus the start of the next
+  static constexpr uint16_t RX_RING_SIZE = 1024;
+
   EcoworthyModbus() = default;
 
   void setup() override;
@@ -33,39 +180,251 @@ class EcoworthyModbus : public uart::UARTDevice, public Component {
 
   float get_setup_priority() const override;
 
+  static const uint8_t INVALID_READ_FRAME = 0xFF;
+
   // Ecoworthy uses a custom frame format: addr(1) + func(1) + start_addr(2) + end_addr(2) + data_len(2) + crc(2)
+  // Builds the read frame, CRC included, once and returns its id for send_read(). Registering the
+  // same request again returns the existing id. Call from setup(); the frame table is never freed.
+  uint8_t register_read(uint8_t address, uint8_t function, uint16_t start_address, uint16_t end_address);
+  void send_read(uint8_t frame_id);
+  // Expected bus time of a registered read: the request on the wire plus the measured round-trip
+  // time, or the response timeout while the address has not answered. Valid once setup() has run.
+  uint32_t expected_duration_ms(uint8_t frame_id);
+  // Convenience for one-off reads; registers the frame on first use
   void send(uint8_t address, uint8_t function, uint16_t start_address, uint16_t end_address);
   // Write command with data payload (includes 0x114A4244 prefix automatically)
-  void send_write(uint8_t address, uint16_t start_address, uint16_t end_address, const std::vector<uint8_t> &data);
+  void send_write(uint8_t address, uint16_t start_address, uint16_t end_address, const uint8_t *data, uint8_t len);
   void set_flow_control_pin(GPIOPin *flow_control_pin) { this->flow_control_pin_ = flow_control_pin; }
+  void set_response_timeout(uint32_t response_timeout) { this->response_timeout_ = response_timeout; }
+  void set_min_response_timeout(uint32_t min_response_timeout) { this->min_response_timeout_ = min_response_timeout; }
+  void set_max_response_timeout(uint32_t max_response_timeout) { this->max_response_timeout_ = max_response_timeout; }
+  void set_metrics_interval(uint32_t metrics_interval) { this->metrics_interval_ = metrics_interval; }
+  void set_request_gap(uint32_t request_gap) { this->request_gap_ = request_gap; }
+  // Passive mode never transmits; it decodes another master's requests and the responses to them
+  void set_passive(bool passive) { this->passive_ = passive; }
+  bool is_passive() const { return this->passive_; }
+  // Listen before talk: only transmit when the line has been quiet for guard_time and another
+  // master is neither mid-transaction nor predicted to start one before our transaction would end.
+  // After a collision, wait a random time up to backoff, doubled on each further collision.
+  void set_listen_before_talk(bool enabled) { this->listen_before_talk_ = enabled; }
+  void set_guard_time(uint32_t guard_time) { this->guard_time_ = guard_time; }
+  void set_collision_backoff(uint32_t backoff) { this->collision_backoff_ = backoff; }
+  void set_dropped_requests_sensor(sensor::Sensor *dropped_requests) {
+    this->dropped_requests_sensor_ = dropped_requests;
+  }
+  void set_latency_p50_sensor(sensor::Sensor *latency_p50) { this->latency_p50_sensor_ = latency_p50; }
+  void set_latency_p95_sensor(sensor::Sensor *latency_p95) { this->latency_p95_sensor_ = latency_p95; }
+  void set_latency_max_sensor(sensor::Sensor *latency_max) { this->latency_max_sensor_ = latency_max; }
+  void set_crc_errors_sensor(sensor::Sensor *crc_errors) { this->crc_errors_sensor_ = crc_errors; }
+  void set_timeouts_sensor(sensor::Sensor *timeouts) { this->timeouts_sensor_ = timeouts; }
+  void set_partial_frames_sensor(sensor::Sensor *partial_frames) { this->partial_frames_sensor_ = partial_frames; }
+  void set_tx_rate_sensor(sensor::Sensor *tx_rate) { this->tx_rate_sensor_ = tx_rate; }
+  void set_rx_rate_sensor(sensor::Sensor *rx_rate) { this->rx_rate_sensor_ = rx_rate; }
+  void set_bus_utilization_sensor(sensor::Sensor *bus_utilization) {
+    this->bus_utilization_sensor_ = bus_utilization;
+  }
+  void set_queue_depth_sensor(sensor::Sensor *queue_depth) { this->queue_depth_sensor_ = queue_depth; }
+  void set_peak_queue_depth_sensor(sensor::Sensor *peak_queue_depth) {
+    this->peak_queue_depth_sensor_ = peak_queue_depth;
+  }
+  void set_sniffed_frames_sensor(sensor::Sensor *sniffed_frames) { this->sniffed_frames_sensor_ = sniffed_frames; }
+  void set_collisions_sensor(sensor::Sensor *collisions) { this->collisions_sensor_ = collisions; }
+  void set_deferrals_sensor(sensor::Sensor *deferrals) { this->deferrals_sensor_ = deferrals; }
+  // Latency of a single address, published with the bus-wide latency sensors
+  void add_address_latency_sensors(uint8_t address, sensor::Sensor *p50, sensor::Sensor *p95, sensor::Sensor *max) {
+    this->address_latency_sensors_.push_back({address, p50, p95, max});
+  }
 
  protected:
   GPIOPin *flow_control_pin_{nullptr};
+  sensor::Sensor *dropped_requests_sensor_{nullptr};
+  sensor::Sensor *latency_p50_sensor_{nullptr};
+  sensor::Sensor *latency_p95_sensor_{nullptr};
+  sensor::Sensor *latency_max_sensor_{nullptr};
+  sensor::Sensor *crc_errors_sensor_{nullptr};
+  sensor::Sensor *timeouts_sensor_{nullptr};
+  sensor::Sensor *partial_frames_sensor_{nullptr};
+  sensor::Sensor *tx_rate_sensor_{nullptr};
+  sensor::Sensor *rx_rate_sensor_{nullptr};
+  sensor::Sensor *bus_utilization_sensor_{nullptr};
+  sensor::Sensor *queue_depth_sensor_{nullptr};
+  sensor::Sensor *peak_queue_depth_sensor_{nullptr};
+  sensor::Sensor *sniffed_frames_sensor_{nullptr};
+  sensor::Sensor *collisions_sensor_{nullptr};
+  sensor::Sensor *deferrals_sensor_{nullptr};
+  std::vector<AddressLatencySensors> address_latency_sensors_;
+
+  // Receive state machine: header bytes, then payload, then the two CRC bytes
+  enum class RxState : uint8_t {
+    HEADER,
+    PAYLOAD,
+    CRC,
+  };
+  enum class RxResult : uint8_t {
+    NEED_MORE,
+    FRAME,
+    INVALID,
+  };
 
-  bool parse_modbus_byte_(uint8_t byte);
+  RxResult parse_modbus_byte_(uint8_t byte);
+  void push_rx_byte_(uint8_t byte);
+  void process_rx_();
+  void dispatch_frame_();
+  void on_sniffed_frame_();
+  bool is_request_frame_() const;
+  void on_foreign_request_();
+  bool on_foreign_response_();
+  bool clear_to_send_(uint32_t now, const ModbusRequest &request);
+  void on_collision_(uint32_t now);
+  void linearize_rx_();
+  void consume_rx_(uint16_t len);
+  void clear_rx_();
+  void reset_rx_();
+  void resync_rx_();
+  bool is_known_address_(uint8_t address) const;
+  bool matches_in_flight_() const;
+  // Whether the buffered frame's header names the same register range as the request
+  bool rx_targets_(const ModbusRequest &request) const;
+  uint8_t rx_at_(uint16_t offset) const { return this->rx_ring_[(this->rx_head_ + offset) & (RX_RING_SIZE - 1)]; }
+  ModbusRequest read_request_(uint8_t frame_id) const;
+  uint32_t expected_duration_ms_(const ModbusRequest &request);
   void send_next_request_();
-  
-  std::vector<uint8_t> rx_buffer_;
+  void poll_idle_devices_();
+  void transmit_(const uint8_t *frame, size_t len);
+  void release_tx_(uint32_t now_us);
+  uint16_t address_slot_(uint8_t address) const;
+  void publish_metrics_();
+  void log_sniff_stats_();
+  RttEstimator &rtt_for_(const ModbusRequest &request);
+  uint32_t response_timeout_for_(const ModbusRequest &request);
+  void on_response_(uint32_t now);
+  void on_timeout_();
+  void queue_request_(const ModbusRequest &request);
+
+  // Received bytes not yet consumed; the candidate frame always starts at rx_head_
+  uint8_t rx_ring_[RX_RING_SIZE];
+  uint16_t rx_head_{0};
+  uint16_t rx_count_{0};
+  uint16_t rx_parsed_{0};  // Bytes of the candidate frame fed through the state machine
+  RxState rx_state_{RxState::HEADER};
+  uint16_t rx_expected_len_{0};
+  uint16_t rx_crc_{0xFFFF};
+  // Index into devices_ for every bus address, NO_DEVICE if nothing answers there
+  static const uint8_t NO_DEVICE = 0xFF;
+  uint8_t device_index_[256];
   uint32_t last_modbus_byte_{0};
   uint32_t last_send_{0};
   std::vector<EcoworthyModbusDevice *> devices_;
-  
-  std::queue<ModbusRequest> request_queue_;
+
+  using ReadFrame = std::array<uint8_t, ECOWORTHY_READ_FRAME_LEN>;
+  std::vector<ReadFrame> read_frames_;
+
+  ModbusRequestQueue request_queue_;
+  ModbusRequest in_flight_{};  // Last request sent; responses must match it
+  uint32_t in_flight_timeout_{0};
+  uint32_t in_flight_wire_ms_{0};  // Time the request takes on the wire; excluded from round-trip time
+  uint32_t last_complete_{0};      // When the last transaction was answered or timed out
+  uint32_t request_gap_{0};        // Minimum quiet time after a transaction before the next request
+  uint8_t next_idle_device_{0};    // Round-robin position for on_bus_idle()
+
+  // Direction pin is released from loop() once the frame has left the UART, instead of flush()ing
+  HighFrequencyLoopRequester high_freq_;
+  uint32_t byte_time_us_{1042};  // 10 bits at 9600 baud until setup() reads the UART settings
+  uint32_t tx_done_us_{0};
+  bool tx_active_{false};
+  uint32_t max_transmit_us_{0};  // Longest time transmit_() held up loop() this metrics interval
+  uint32_t max_loop_us_{0};      // Longest loop() call this metrics interval
+  uint32_t decode_frames_{0};    // Frames handed to devices this metrics interval
+  uint32_t decode_us_{0};        // Total time spent in on_modbus_data() this metrics interval
+  uint32_t max_decode_us_{0};
+
+  // Round-trip estimates per bus address and block size class. Addresses without samples fall back
+  // to the bus-wide estimate for the class, and to response_timeout_ before any response at all.
+  static const uint8_t RTT_CLASSES = 3;
+  std::vector<uint16_t> device_slot_base_;  // Slot of each device's first address in the per-address tables
+  uint16_t unowned_slot_{0};                // Per-address table slot of addresses without a device
+  std::vector<RttEstimator> rtt_;           // RTT_CLASSES entries per address slot
+  RttEstimator bus_rtt_[RTT_CLASSES];
+  uint32_t response_timeout_{2000};
+  uint32_t min_response_timeout_{150};
+  uint32_t max_response_timeout_{2000};
+  uint32_t dropped_requests_{0};
+
+  // Bus metrics. Error counters are totals since boot; latency, byte rates and peak queue depth
+  // cover the current metrics interval and are reset when it is published.
+  std::vector<LatencyHistogram> latency_;  // One per address slot
+  LatencyHistogram bus_latency_;
+  uint32_t crc_errors_{0};
+  uint32_t timeouts_{0};
+  uint32_t partial_frames_{0};
+  uint32_t tx_bytes_{0};
+  uint32_t rx_bytes_{0};
+  uint8_t peak_queue_depth_{0};
+  uint8_t bits_per_byte_{10};
+  uint32_t metrics_interval_{60000};
+  uint32_t last_metrics_{0};
+
+  // Passive mode. A request seen on the wire is held until its response arrives; responses are
+  // counted per address slot and per register block since boot.
+  struct SniffedBlock {
+    uint8_t function;
+    uint16_t start_address;
+    uint32_t frames;
+  };
+  static const uint8_t MAX_SNIFFED_BLOCKS = 8;
+  bool passive_{false};
+  ModbusRequest sniffed_request_{};
+  bool sniffed_request_pending_{false};
+  std::vector<uint32_t> sniffed_frames_;  // One per address slot
+  SniffedBlock sniffed_blocks_[MAX_SNIFFED_BLOCKS];
+  uint8_t sniffed_block_count_{0};
+  uint32_t sniffed_requests_{0};
+  uint32_t sniffed_responses_{0};
+  uint32_t unpaired_responses_{0};  // Responses whose request was not seen, e.g. after a CRC error
+
+  // Listen before talk. Another master's requests are tracked through sniffed_request_; its
+  // request cadence is smoothed like the round-trip time, in ms * 8.
+  bool listen_before_talk_{false};
+  uint32_t guard_time_{20};
+  uint32_t collision_backoff_{200};
+  uint32_t foreign_request_time_{0};
+  uint32_t foreign_period_x8_{0};
+  uint32_t backoff_until_{0};
+  uint8_t collision_streak_{0};
+  bool deferring_{false};  // The request at the head of the queue has been held back at least once
+  uint32_t collisions_{0};
+  uint32_t deferrals_{0};
   bool waiting_for_response_{false};
 };
 
 uint16_t crc16_ecoworthy(const uint8_t *data, uint16_t len);
 
+#ifdef USE_ECOWORTHY_ALLOCATION_COUNTER
+// Opt-in heap diagnostics: allocations since boot. Host builds count every operator new; ESP32 and
+// ESP8266 builds count every malloc(), calloc() and realloc() call, which operator new goes through.
+uint32_t heap_allocation_count();
+#endif
+
 class EcoworthyModbusDevice {
  public:
   void set_parent(EcoworthyModbus *parent) { parent_ = parent; }
   void set_address(uint8_t address) { address_ = address; }
-  virtual void on_modbus_data(const std::vector<uint8_t> &data) = 0;
+  // Number of consecutive addresses, starting at address_, this device answers for
+  void set_address_count(uint8_t address_count) { address_count_ = address_count; }
+  virtual void on_modbus_data(const FrameView &frame) = 0;
+  // Called when nothing is queued or in flight. Devices that keep the bus busy queue their next
+  // request here and return true; devices are asked in turn so none of them is starved.
+  virtual bool on_bus_idle() { return false; }
+  // address_offset selects one of the address_count_ addresses starting at address_
+  uint8_t register_read(uint8_t function, uint16_t start_address, uint16_t end_address, uint8_t address_offset = 0) {
+    return this->parent_->register_read(this->address_ + address_offset, function, start_address, end_address);
+  }
+  void send_read(uint8_t frame_id) { this->parent_->send_read(frame_id); }
   void send(uint8_t function, uint16_t start_address, uint16_t end_address) {
     this->parent_->send(this->address_, function, start_address, end_address);
   }
-  void send_write(uint16_t start_address, uint16_t end_address, const std::vector<uint8_t> &data) {
-    this->parent_->send_write(this->address_, start_address, end_address, data);
+  void send_write(uint16_t start_address, uint16_t end_address, const uint8_t *data, uint8_t len) {
+    this->parent_->send_write(this->address_, start_address, end_address, data, len);
   }
 
  protected:
@@ -73,6 +432,7 @@ class EcoworthyModbusDevice {
 
   EcoworthyModbus *parent_;
   uint8_t address_;
+  uint8_t address_count_{1};
 };
 
 }  // namespace ecoworthy_modbus
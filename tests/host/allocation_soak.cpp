@@ -0,0 +1,91 @@
+// Runs a three battery bank against a simulated BMS for many poll cycles and fails if bus.loop() or
+// update() allocates once warmed up. Usage: allocation_soak [frames]
+#include <cstdio>
+#include <cstdlib>
+
+#include "fixture.h"
+#include "host.h"
+
+using namespace esphome;
+using namespace esphome::ecoworthy_modbus;
+using namespace esphome::ecoworthy_bms;
+
+static const uint8_t BATTERY_COUNT = 3;
+static const uint32_t WARMUP_FRAMES = 2000;
+static const uint32_t LOOP_INTERVAL_US = 500;
+static const uint32_t RESPONSE_DELAY_US = 30000;
+
+// The simulated bank's answer to a read request; pack status is live data, config blocks are blank
+static std::vector<uint8_t> respond(const std::vector<uint8_t> &request, uint32_t sample) {
+  const uint8_t address = request[0];
+  const uint8_t function = request[1];
+  const uint16_t start = (uint16_t(request[2]) << 8) | request[3];
+  const uint16_t end = (uint16_t(request[4]) << 8) | request[5];
+  if (function == 0x78 && start == host::PACK_STATUS_START) {
+    std::vector<uint8_t> payload = host::pack_status_payload(sample, 0x81, 0x05);
+    payload.resize(end - start);
+    return host::make_response(address, function, start, end, payload);
+  }
+  return host::make_response(address, function, start, end, std::vector<uint8_t>(function == 0x45 ? 100 : end - start));
+}
+
+static bool soak(uint32_t frames, bool changes_only) {
+  uart::UARTComponent uart;
+  EcoworthyModbus bus;
+  bus.set_uart_parent(&uart);
+  EcoworthyBms bms;
+  bms.set_parent(&bus);
+  bms.set_address(1);
+  bms.set_battery_count(BATTERY_COUNT);
+  bms.set_poll_mode(POLL_MODE_CONTINUOUS);
+  bms.set_pack_status_interval(0);
+  for (uint8_t block = 0; block < EcoworthyBms::CONFIG_BLOCK_SLOTS; block++)
+    bms.set_config_block_interval(block, 50);
+  bms.set_publish_changes_only(changes_only);
+  bus.register_device(&bms);
+  host::BmsSensors sensors;
+  sensors.attach(bms, BATTERY_COUNT);
+  bus.setup();
+  bms.setup();
+
+  std::vector<uint8_t> response;
+  uint64_t response_at = 0;
+  uint32_t answered = 0;
+  uint32_t warmup_allocations = 0;
+  uint32_t allocations = 0;
+  uint64_t next_update = 0;
+  while (answered < frames) {
+    host::advance_us(LOOP_INTERVAL_US);
+    if (!response.empty() && host::now_us() >= response_at) {
+      host::uart_receive(response.data(), response.size());
+      response.clear();
+      answered++;
+    }
+    host::uart_clear_sent();
+
+    const uint32_t before = heap_allocation_count();
+    bus.loop();
+    if (host::now_us() >= next_update) {
+      bms.update();
+      next_update = host::now_us() + 1000000;
+    }
+    const uint32_t used = heap_allocation_count() - before;
+    (answered > WARMUP_FRAMES ? allocations : warmup_allocations) += used;
+
+    if (!host::uart_sent().empty()) {
+      response = respond(host::uart_sent(), answered);
+      response_at = host::now_us() + RESPONSE_DELAY_US;
+    }
+  }
+
+  printf("publish_changes_only %s: %u frames, %u allocations during warm-up, %u after\n", changes_only ? "on" : "off", frames,
+         warmup_allocations, allocations);
+  return allocations == 0;
+}
+
+int main(int argc, char **argv) {
+  const uint32_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  bool passed = soak(frames, false);
+  passed = soak(frames, true) && passed;
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
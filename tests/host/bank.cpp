@@ -0,0 +1,110 @@
+// Runs a two pack bank whose BMS has no sensors of its own, as in the README example, and checks that
+// the bank still gets whole pack status reads and publishes its totals. The bank subscribes either
+// before or after the BMS has planned its reads.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "esphome/components/ecoworthy_bank/ecoworthy_bank.h"
+#include "fixture.h"
+#include "host.h"
+
+using namespace esphome;
+using namespace esphome::ecoworthy_bank;
+using namespace esphome::ecoworthy_bms;
+using namespace esphome::ecoworthy_modbus;
+
+static const uint32_t LOOP_INTERVAL_US = 1000;
+static const uint32_t RESPONSE_DELAY_US = 30000;
+
+static int failures = 0;
+
+static void expect(const char *what, float actual, float wanted) {
+  if (std::isnan(actual) || std::fabs(actual - wanted) > 0.001f) {
+    printf("%s: %.3f, expected %.3f\n", what, actual, wanted);
+    failures++;
+  }
+}
+
+// Answers with as many bytes as were asked for, like the BMS does
+static std::vector<uint8_t> respond(const std::vector<uint8_t> &request, uint16_t &pack_status_length) {
+  const uint8_t address = request[0];
+  const uint8_t function = request[1];
+  const uint16_t start = (uint16_t(request[2]) << 8) | request[3];
+  const uint16_t end = (uint16_t(request[4]) << 8) | request[5];
+  if (function == 0x78 && start == host::PACK_STATUS_START) {
+    pack_status_length = std::min<uint16_t>(pack_status_length, end - start);
+    std::vector<uint8_t> payload = host::pack_status_payload(0);
+    payload.resize(end - start);
+    return host::make_response(address, function, start, end, payload);
+  }
+  return host::make_response(address, function, start, end, std::vector<uint8_t>(function == 0x45 ? 100 : end - start));
+}
+
+static void run(bool bank_first) {
+  const char *order = bank_first ? "bank set up first" : "BMS set up first";
+  uart::UARTComponent uart;
+  EcoworthyModbus bus;
+  bus.set_uart_parent(&uart);
+  EcoworthyBms bms;
+  bms.set_parent(&bus);
+  bms.set_address(1);
+  bms.set_battery_count(2);
+  bms.set_pack_status_interval(1000);
+  bus.register_device(&bms);
+
+  EcoworthyBank bank;
+  bank.add_bms(&bms);
+  sensor::Sensor current, state_of_charge, min_cell_voltage, online_packs;
+  bank.set_sensor(BANK_CURRENT, &current);
+  bank.set_sensor(BANK_STATE_OF_CHARGE, &state_of_charge);
+  bank.set_sensor(BANK_MIN_CELL_VOLTAGE, &min_cell_voltage);
+  bank.set_sensor(BANK_ONLINE_PACKS, &online_packs);
+
+  bus.setup();
+  if (bank_first) {
+    bank.setup();
+    bms.setup();
+  } else {
+    bms.setup();
+    bank.setup();
+  }
+
+  std::vector<uint8_t> response;
+  uint64_t response_at = 0;
+  uint16_t pack_status_length = 0xFFFF;
+  uint64_t next_update = 0;
+  const uint64_t end = host::now_us() + 5000000;
+  while (host::now_us() < end) {
+    host::advance_us(LOOP_INTERVAL_US);
+    if (!response.empty() && host::now_us() >= response_at) {
+      host::uart_receive(response.data(), response.size());
+      response.clear();
+    }
+    host::uart_clear_sent();
+    bus.loop();
+    if (host::now_us() >= next_update) {
+      bms.update();
+      next_update = host::now_us() + 1000000;
+    }
+    if (!host::uart_sent().empty()) {
+      response = respond(host::uart_sent(), pack_status_length);
+      response_at = host::now_us() + RESPONSE_DELAY_US;
+    }
+  }
+  bank.update();
+
+  printf("%s: shortest pack status read %u bytes, current %.2f A, SOC %.2f %%, min cell %.3f V, %.0f packs online\n",
+         order, pack_status_length, current.state, state_of_charge.state, min_cell_voltage.state, online_packs.state);
+  expect("shortest pack status read", pack_status_length, host::PACK_STATUS_LENGTH);
+  expect("online packs", online_packs.state, 2.0f);
+  expect("current", current.state, -25.0f);
+  expect("state of charge", state_of_charge.state, 86.5f);
+  expect("min cell voltage", min_cell_voltage.state, 3.312f);
+}
+
+int main() {
+  run(true);
+  run(false);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
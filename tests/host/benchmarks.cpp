@@ -0,0 +1,301 @@
+// Microbenchmarks of the receive, decode and transmit paths. One iteration handles one frame, so the time
+// column is ns/frame; "allocs" is heap allocations per frame. The baseline:: functions are the bit-by-bit
+// CRC, the parser and the flushing transmit this component used before, kept so the current code can be
+// compared with them side by side.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "fixture.h"
+#include "host.h"
+
+using namespace esphome;
+using namespace esphome::ecoworthy_modbus;
+using namespace esphome::ecoworthy_bms;
+
+namespace {
+
+static const uint32_t WARMUP_RUNS = 256;
+static const uint32_t COUNTED_RUNS = 1024;
+
+// Times step() and reports its heap allocations per call as "allocs". They are counted over a separate
+// run after a warm-up, so neither the first publishes nor the benchmark library's own allocations show.
+template<typename Step> void run(benchmark::State &state, Step &&step) {
+  for (uint32_t i = 0; i < WARMUP_RUNS; i++)
+    step();
+  const uint32_t start = heap_allocation_count();
+  for (uint32_t i = 0; i < COUNTED_RUNS; i++)
+    step();
+  const double per_call = double(heap_allocation_count() - start) / COUNTED_RUNS;
+  for (auto _ : state)
+    step();
+  state.counters["allocs"] = per_call;
+}
+
+namespace baseline {
+
+uint16_t crc16_ecoworthy(const uint8_t *data, uint16_t len) {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (uint8_t j = 0; j < 8; j++) {
+      if (crc & 0x0001) {
+        crc = (crc >> 1) ^ 0xA001;
+      } else {
+        crc >>= 1;
+      }
+    }
+  }
+  return crc;
+}
+
+// The old parse_modbus_byte_(): every byte is appended, the header is decoded again and, once the frame
+// is complete, the CRC is computed over the whole buffer. Logging is left out.
+class Parser : public uart::UARTDevice {
+ public:
+  void loop() {
+    while (this->available()) {
+      uint8_t byte;
+      this->read_byte(&byte);
+      if (!this->parse_byte_(byte))
+        this->rx_buffer_.clear();
+    }
+  }
+
+  uint64_t frames{0};
+
+ protected:
+  bool parse_byte_(uint8_t byte) {
+    if (this->rx_buffer_.empty()) {
+      this->rx_buffer_.push_back(byte);
+      return true;
+    }
+    this->rx_buffer_.push_back(byte);
+    const uint8_t *raw = &this->rx_buffer_[0];
+    const size_t len = this->rx_buffer_.size();
+    if (len < 10)
+      return true;
+    uint16_t data_length = (uint16_t(raw[6]) << 8) | uint16_t(raw[7]);
+    size_t expected_len = 8 + data_length + 2;
+    if (data_length > 512) {
+      this->rx_buffer_.clear();
+      return false;
+    }
+    if (len < expected_len)
+      return true;
+    uint16_t crc_calc = crc16_ecoworthy(raw, expected_len - 2);
+    uint16_t crc_recv = raw[expected_len - 2] | (raw[expected_len - 1] << 8);
+    if (crc_calc != crc_recv) {
+      this->rx_buffer_.clear();
+      return false;
+    }
+    this->frames++;
+    this->rx_buffer_.clear();
+    return true;
+  }
+
+  std::vector<uint8_t> rx_buffer_;
+};
+
+// The old send path: raise the direction pin, write the frame and flush() until it has left the line
+class Transmitter : public uart::UARTDevice {
+ public:
+  void transmit(GPIOPin *pin, const uint8_t *frame, size_t len) {
+    pin->digital_write(true);
+    this->write_array(frame, len);
+    this->flush();
+    pin->digital_write(false);
+  }
+};
+
+}  // namespace baseline
+
+class DirectionPin : public GPIOPin {
+ public:
+  void setup() override {}
+  void digital_write(bool value) override { this->level = value; }
+  bool digital_read() override { return this->level; }
+  bool level{false};
+};
+
+// Counts the frames the bus hands over, without decoding them
+class FrameCounter : public EcoworthyModbusDevice {
+ public:
+  void on_modbus_data(const FrameView &frame) override { this->frames++; }
+  uint64_t frames{0};
+};
+
+std::vector<uint8_t> test_data(size_t length) {
+  std::vector<uint8_t> data(length);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = uint8_t(i * 37 + 11);
+  return data;
+}
+
+void BM_Crc16Bitwise(benchmark::State &state) {
+  const std::vector<uint8_t> data = test_data(state.range(0));
+  run(state, [&]() { benchmark::DoNotOptimize(baseline::crc16_ecoworthy(data.data(), data.size())); });
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc16Bitwise)->RangeMultiplier(4)->Range(8, 512);
+
+void BM_Crc16(benchmark::State &state) {
+  const std::vector<uint8_t> data = test_data(state.range(0));
+  if (crc16_ecoworthy(data.data(), data.size()) != baseline::crc16_ecoworthy(data.data(), data.size()))
+    state.SkipWithError("CRC differs from the bitwise one");
+  run(state, [&]() { benchmark::DoNotOptimize(crc16_ecoworthy(data.data(), data.size())); });
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc16)->RangeMultiplier(4)->Range(8, 512);
+
+// A pack status response fed in chunks of range(0) bytes, with loop() after each chunk, the way the UART
+// hands over whatever arrived since the last loop
+template<typename Receiver> void feed(benchmark::State &state, Receiver &receiver, uint64_t &frames) {
+  const size_t chunk = state.range(0);
+  const std::vector<uint8_t> frame = host::pack_status_response(1, 0);
+  run(state, [&]() {
+    for (size_t offset = 0; offset < frame.size(); offset += chunk) {
+      host::uart_receive(frame.data() + offset, std::min(chunk, frame.size() - offset));
+      receiver.loop();
+    }
+  });
+  if (frames != state.iterations() + WARMUP_RUNS + COUNTED_RUNS)
+    state.SkipWithError("frames were lost");
+  state.SetBytesProcessed(state.iterations() * frame.size());
+}
+
+void BM_ParseFrameBaseline(benchmark::State &state) {
+  baseline::Parser parser;
+  feed(state, parser, parser.frames);
+}
+BENCHMARK(BM_ParseFrameBaseline)->RangeMultiplier(2)->Range(1, 256);
+
+// A passive bus decodes every frame on the line, so no request has to be sent first
+void BM_ParseFrame(benchmark::State &state) {
+  uart::UARTComponent uart;
+  EcoworthyModbus bus;
+  bus.set_uart_parent(&uart);
+  bus.set_passive(true);
+  FrameCounter device;
+  device.set_parent(&bus);
+  device.set_address(1);
+  bus.register_device(&device);
+  bus.setup();
+  feed(state, bus, device.frames);
+}
+BENCHMARK(BM_ParseFrame)->RangeMultiplier(2)->Range(1, 256);
+
+// Decoding and publishing a full pack status response of battery range(0) + 1; range(1) enables
+// publish_changes_only. The samples cycle, so values change from frame to frame like on a live bus.
+void BM_PackStatus(benchmark::State &state) {
+  const uint8_t battery_index = state.range(0);
+  EcoworthyModbus bus;
+  EcoworthyBms bms;
+  bms.set_parent(&bus);
+  bms.set_address(1);
+  bms.set_battery_count(2);
+  bms.set_publish_changes_only(state.range(1) != 0);
+  bus.register_device(&bms);
+  host::BmsSensors sensors;
+  sensors.attach(bms, 2);
+  bus.setup();
+  bms.setup();
+
+  std::vector<std::vector<uint8_t>> frames;
+  for (uint32_t sample = 0; sample < 64; sample++)
+    frames.push_back(host::pack_status_response(1 + battery_index, sample));
+  size_t next = 0;
+  run(state, [&]() {
+    const std::vector<uint8_t> &frame = frames[next];
+    next = (next + 1) % frames.size();
+    bms.on_modbus_data(FrameView(frame.data(), frame.size()));
+  });
+}
+BENCHMARK(BM_PackStatus)->ArgNames({"battery", "changes_only"})->ArgsProduct({{0, 1}, {0, 1}});
+
+// Sending a read request (10 bytes) or the longest write (26 bytes) with a direction pin. "blocked_us" is
+// the simulated time per frame the call held up loop(); the shim's flush() waits out the wire time at
+// 9600 baud like the hardware driver does.
+void BM_TransmitBaseline(benchmark::State &state) {
+  const std::vector<uint8_t> frame = test_data(state.range(0));
+  baseline::Transmitter uart;
+  DirectionPin pin;
+  uint64_t blocked_us = 0;
+  uint64_t calls = 0;
+  run(state, [&]() {
+    host::uart_clear_sent();
+    const uint64_t start = host::now_us();
+    uart.transmit(&pin, frame.data(), frame.size());
+    blocked_us += host::now_us() - start;
+    calls++;
+  });
+  state.counters["blocked_us"] = double(blocked_us) / calls;
+}
+BENCHMARK(BM_TransmitBaseline)->ArgName("bytes")->Arg(10)->Arg(26);
+
+// The request goes out from loop(); the BMS's answer is fed back so the next request can follow
+void BM_Transmit(benchmark::State &state) {
+  static const uint8_t WRITE_DATA[12] = {};
+  const bool write = state.range(0) > 10;
+  uart::UARTComponent line;
+  EcoworthyModbus bus;
+  bus.set_uart_parent(&line);
+  DirectionPin pin;
+  bus.set_flow_control_pin(&pin);
+  FrameCounter device;
+  device.set_parent(&bus);
+  device.set_address(1);
+  bus.register_device(&device);
+  const uint8_t frame_id = bus.register_read(1, 0x78, host::PACK_STATUS_START, host::PACK_STATUS_START + 16);
+  bus.setup();
+  const std::vector<uint8_t> response =
+      write ? host::make_response(1, 0x79, 0x2000, 0x2010, {})
+            : host::make_response(1, 0x78, host::PACK_STATUS_START, host::PACK_STATUS_START + 16,
+                                  std::vector<uint8_t>(16));
+
+  uint64_t blocked_us = 0;
+  uint64_t calls = 0;
+  run(state, [&]() {
+    if (write) {
+      bus.send_write(1, 0x2000, 0x2010, WRITE_DATA, sizeof(WRITE_DATA));
+    } else {
+      bus.send_read(frame_id);
+    }
+    host::uart_clear_sent();
+    const uint64_t start = host::now_us();
+    bus.loop();
+    blocked_us += host::now_us() - start;
+    calls++;
+    if (host::uart_sent().size() != size_t(state.range(0)))
+      state.SkipWithError("unexpected request length");
+    host::advance_us(50000);
+    host::uart_receive(response.data(), response.size());
+    bus.loop();
+  });
+  if (pin.level)
+    state.SkipWithError("direction pin was not released");
+  state.counters["blocked_us"] = double(blocked_us) / calls;
+}
+BENCHMARK(BM_Transmit)->ArgName("bytes")->Arg(10)->Arg(26);
+
+// Fault and alarm text of a bitmask with range(0) bits set
+uint32_t low_bits(int64_t count) { return count >= 32 ? 0xFFFFFFFFUL : (1UL << count) - 1; }
+
+void BM_DecodeFault(benchmark::State &state) {
+  const uint32_t bits = low_bits(state.range(0));
+  char text[320];
+  run(state, [&]() { benchmark::DoNotOptimize(decode_fault_bits(bits, text, sizeof(text))); });
+}
+BENCHMARK(BM_DecodeFault)->Arg(0)->Arg(1)->Arg(4)->Arg(32);
+
+void BM_DecodeAlarm(benchmark::State &state) {
+  const uint32_t bits = low_bits(state.range(0));
+  char text[320];
+  run(state, [&]() { benchmark::DoNotOptimize(decode_alarm_bits(bits, text, sizeof(text))); });
+}
+BENCHMARK(BM_DecodeAlarm)->Arg(0)->Arg(1)->Arg(4)->Arg(32);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,87 @@
+// Checks that fault and alarm text keeps the format Home Assistant automations match on: the names of
+// the set bits joined with ';' and no trailing ';', "None" for no bits, and nothing for unnamed bits.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "fixture.h"
+#include "host.h"
+
+using namespace esphome;
+using namespace esphome::ecoworthy_bms;
+
+// As published before the decoders moved to name tables
+static const char *const FAULTS[] = {
+    "Cell OV",          "Cell UV",          "Pack OV",             "Pack UV",
+    "Charge OC Slow",   "Charge OC Fast",   "Discharge OC Slow",   "Discharge OC Fast",
+    "Charge HT",        "Charge LT",        "Discharge HT",        "Discharge LT",
+    "MOS HT",           "Ambient HT",       "Ambient LT",          "Cell V Diff",
+    "Temp Diff",        "SOC Low",          "Short Circuit",       "Cell Offline",
+    "Temp Sensor Fail", "Charge MOS Fault", "Discharge MOS Fault", "AFE Comm Error",
+};
+static const char *const ALARMS[] = {
+    "Cell OV",      "Cell UV",      "Pack OV",    "Pack UV",
+    "Charge OC",    "Discharge OC", "Charge HT",  "Charge LT",
+    "Discharge HT", "Discharge LT", "MOS HT",     "Ambient HT",
+    "Ambient LT",   "Cell V Diff",  "Temp Diff",  "SOC Low",
+    "EEP Fault",    "RTC Abnormal", "Full Charge Prot",
+};
+
+static std::string expected(uint32_t bits, const char *const *names, size_t count) {
+  if (bits == 0)
+    return "None";
+  std::string text;
+  for (size_t bit = 0; bit < count; bit++) {
+    if (bits & (1UL << bit))
+      text += std::string(text.empty() ? "" : ";") + names[bit];
+  }
+  return text;
+}
+
+static int failures = 0;
+
+static void check(const char *what, uint32_t bits, const std::string &actual, const std::string &wanted) {
+  if (actual != wanted) {
+    printf("%s 0x%08X: \"%s\", expected \"%s\"\n", what, bits, actual.c_str(), wanted.c_str());
+    failures++;
+  }
+}
+
+int main() {
+  char text[320];
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < 100000; i++) {
+    // Every single bit, then pseudo-random masks
+    bits = i < 32 ? 1UL << i : bits * 1664525UL + 1013904223UL;
+    check("fault", bits, decode_fault_bits(bits, text, sizeof(text)), expected(bits, FAULTS, 24));
+    check("alarm", bits, decode_alarm_bits(bits, text, sizeof(text)), expected(bits, ALARMS, 19));
+  }
+  check("fault", 0, decode_fault_bits(0, text, sizeof(text)), "None");
+  check("fault", 0xFFFFFFFF, decode_fault_bits(0xFFFFFFFF, text, sizeof(text)), expected(0xFFFFFFFF, FAULTS, 24));
+
+  // The same text reaches the sensor, also when only unnamed bits are set
+  ecoworthy_modbus::EcoworthyModbus bus;
+  EcoworthyBms bms;
+  bms.set_parent(&bus);
+  bms.set_address(1);
+  bus.register_device(&bms);
+  host::BmsSensors sensors;
+  sensors.attach(bms, 1);
+  text_sensor::TextSensor fault;
+  text_sensor::TextSensor alarm;
+  bms.set_fault_text_sensor(&fault);
+  bms.set_alarm_text_sensor(&alarm);
+  bus.setup();
+  bms.setup();
+  const uint32_t masks[] = {0x00000003, 0x80000000, 0, 0x00040001};
+  for (uint32_t mask : masks) {
+    const std::vector<uint8_t> frame = host::pack_status_response(1, 0, mask, mask);
+    bms.on_modbus_data(ecoworthy_modbus::FrameView(frame.data(), frame.size()));
+    check("fault sensor", mask, fault.state, expected(mask, FAULTS, 24));
+    check("alarm sensor", mask, alarm.state, expected(mask, ALARMS, 19));
+  }
+
+  if (failures == 0)
+    printf("fault and alarm text OK\n");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
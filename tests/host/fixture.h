@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "esphome/components/ecoworthy_bms/ecoworthy_bms.h"
+#include "esphome/components/ecoworthy_modbus/ecoworthy_modbus.h"
+
+namespace esphome {
+namespace host {
+
+static const uint16_t PACK_STATUS_START = 0x1000;
+static const uint16_t PACK_STATUS_LENGTH = 160;
+
+inline void put_u16(uint8_t *data, uint16_t value) {
+  data[0] = value >> 8;
+  data[1] = value & 0xFF;
+}
+
+inline void put_u32(uint8_t *data, uint32_t value) {
+  put_u16(data, value >> 16);
+  put_u16(data + 2, value & 0xFFFF);
+}
+
+// A response frame with the header the BMS sends: the register range, the data length and a CRC
+inline std::vector<uint8_t> make_response(uint8_t address, uint8_t function, uint16_t start, uint16_t end,
+                                          const std::vector<uint8_t> &payload) {
+  uint8_t header[8] = {address, function};
+  put_u16(&header[2], start);
+  put_u16(&header[4], end);
+  put_u16(&header[6], payload.size());
+  std::vector<uint8_t> frame;
+  frame.reserve(sizeof(header) + payload.size() + 2);
+  frame.assign(header, header + sizeof(header));
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  const uint16_t crc = ecoworthy_modbus::crc16_ecoworthy(frame.data(), frame.size());
+  frame.push_back(crc & 0xFF);
+  frame.push_back(crc >> 8);
+  return frame;
+}
+
+// A full 0x1000 pack status block of a 16 cell pack. sample moves current, SOC and the cells a little, so
+// consecutive samples differ the way a live pack's do.
+inline std::vector<uint8_t> pack_status_payload(uint32_t sample, uint32_t fault_bitmask = 0,
+                                                uint32_t alarm_bitmask = 0) {
+  std::vector<uint8_t> data(PACK_STATUS_LENGTH, 0);
+  uint8_t *d = data.data();
+  put_u16(d + 0, 5312 + sample % 7);               // Total voltage, 10 mV
+  put_u32(d + 4, 300000 - 1250 + sample % 50);     // Current, 10 mA offset by 3000 A
+  put_u16(d + 8, 8650 + sample % 3);               // SOC, 0.01 %
+  put_u16(d + 10, 8650);                           // Remaining capacity, 10 mAh
+  put_u16(d + 12, 10000);                          // Full capacity
+  put_u16(d + 14, 10000);                          // Rated capacity
+  put_u16(d + 16, 500 + 281);                      // Power tube temperature, 0.1 C offset by 50 C
+  put_u16(d + 18, 500 + 224);                      // Ambient temperature
+  put_u16(d + 20, 2);                              // Discharging
+  put_u16(d + 22, 100);                            // SOH
+  put_u32(d + 24, fault_bitmask);
+  put_u32(d + 28, alarm_bitmask);
+  put_u16(d + 32, 0x0003);                         // Both MOS on
+  put_u16(d + 36, 57);                             // Cycles
+  put_u16(d + 38, 4);
+  put_u16(d + 40, 3329);
+  put_u16(d + 42, 11);
+  put_u16(d + 44, 3312);
+  put_u16(d + 46, 3320);
+  put_u16(d + 50, 500 + 241);
+  put_u16(d + 54, 500 + 236);
+  put_u16(d + 56, 500 + 238);
+  put_u16(d + 58, 568);
+  put_u16(d + 60, 1000);
+  put_u16(d + 62, 440);
+  put_u16(d + 64, 1000);
+  put_u16(d + 66, 16);                             // Cell count
+  for (uint8_t cell = 0; cell < 16; cell++)
+    put_u16(d + 68 + cell * 2, 3312 + (sample + cell) % 18);
+  put_u16(d + 100, 4);                             // Temperature sensor count
+  for (uint8_t sensor = 0; sensor < 4; sensor++)
+    put_u16(d + 102 + sensor * 2, 500 + 236 + sensor);
+  put_u16(d + 112, 0);                             // Balancing bitmask
+  put_u16(d + 114, 0x0103);                        // Firmware 1.3
+  memcpy(d + 116, "ECO2403150012345", 16);         // Serial number
+  return data;
+}
+
+inline std::vector<uint8_t> pack_status_response(uint8_t address, uint32_t sample, uint32_t fault_bitmask = 0,
+                                                 uint32_t alarm_bitmask = 0) {
+  return make_response(address, 0x78, PACK_STATUS_START, PACK_STATUS_START + PACK_STATUS_LENGTH,
+                       pack_status_payload(sample, fault_bitmask, alarm_bitmask));
+}
+
+// Gives a BMS every pack status sensor of every battery, like a full configuration. The sensors are
+// owned by the returned holders and must outlive the BMS.
+struct BmsSensors {
+  std::vector<std::unique_ptr<sensor::Sensor>> sensors;
+  std::vector<std::unique_ptr<binary_sensor::BinarySensor>> binary_sensors;
+  std::vector<std::unique_ptr<text_sensor::TextSensor>> text_sensors;
+
+  sensor::Sensor *sensor() {
+    this->sensors.emplace_back(new sensor::Sensor());
+    return this->sensors.back().get();
+  }
+  binary_sensor::BinarySensor *binary_sensor() {
+    this->binary_sensors.emplace_back(new binary_sensor::BinarySensor());
+    return this->binary_sensors.back().get();
+  }
+  text_sensor::TextSensor *text_sensor() {
+    this->text_sensors.emplace_back(new text_sensor::TextSensor());
+    return this->text_sensors.back().get();
+  }
+
+  void attach(ecoworthy_bms::EcoworthyBms &bms, uint8_t battery_count) {
+    using namespace ecoworthy_bms;
+    for (uint8_t slot = 0; slot < BATTERY_SENSOR_COUNT; slot++)
+      bms.set_pack_sensor(slot, this->sensor());
+    bms.set_charging_binary_sensor(this->binary_sensor());
+    bms.set_discharging_binary_sensor(this->binary_sensor());
+    bms.set_charging_switch_binary_sensor(this->binary_sensor());
+    bms.set_discharging_switch_binary_sensor(this->binary_sensor());
+    bms.set_balancing_binary_sensor(this->binary_sensor());
+    bms.set_online_status_binary_sensor(this->binary_sensor());
+    bms.set_operation_status_text_sensor(this->text_sensor());
+    bms.set_fault_text_sensor(this->text_sensor());
+    bms.set_alarm_text_sensor(this->text_sensor());
+    bms.set_serial_number_text_sensor(this->text_sensor());
+    bms.set_firmware_version_text_sensor(this->text_sensor());
+    for (uint8_t field = 0; field < PARAM_FIELD_COUNT; field++)
+      bms.set_param_sensor(ParamField(field), this->sensor());
+    bms.set_bms_serial_number_text_sensor(this->text_sensor());
+    bms.set_pack_serial_number_text_sensor(this->text_sensor());
+    bms.set_manufacturer_text_sensor(this->text_sensor());
+    bms.set_bms_model_text_sensor(this->text_sensor());
+    bms.set_balance_mode_text_sensor(this->text_sensor());
+    bms.set_hardware_version_text_sensor(this->text_sensor());
+
+    for (uint8_t battery = 1; battery < battery_count; battery++) {
+      for (uint8_t slot = 0; slot < BATTERY_SENSOR_COUNT; slot++)
+        bms.set_secondary_battery_sensor(battery, slot, this->sensor());
+      for (uint8_t slot = 0; slot < BATTERY_BINARY_SENSOR_COUNT; slot++)
+        bms.set_secondary_battery_binary_sensor(battery, BatteryBinarySensor(slot), this->binary_sensor());
+      for (uint8_t slot = 0; slot < BATTERY_TEXT_SENSOR_COUNT; slot++)
+        bms.set_secondary_battery_text_sensor(battery, BatteryTextSensor(slot), this->text_sensor());
+    }
+  }
+};
+
+}  // namespace host
+}  // namespace esphome
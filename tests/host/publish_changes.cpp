@@ -0,0 +1,71 @@
+// Checks which values publish_changes_only lets through: those that differ at accuracy_decimals by
+// default, and those that moved more than the deadband from the last published value when one is set.
+#include <cstdio>
+#include <cstdlib>
+
+#include "fixture.h"
+#include "host.h"
+
+using namespace esphome;
+using namespace esphome::ecoworthy_bms;
+
+static int failures = 0;
+
+// Feeds a pack status response with the given current (10 mA steps) and returns whether the current
+// sensor was published
+static bool publishes_current(EcoworthyBms &bms, sensor::Sensor &current, int32_t centiamps) {
+  std::vector<uint8_t> payload = host::pack_status_payload(0);
+  host::put_u32(&payload[4], uint32_t(300000 + centiamps));
+  const std::vector<uint8_t> frame = host::make_response(1, 0x78, host::PACK_STATUS_START,
+                                                         host::PACK_STATUS_START + payload.size(), payload);
+  const uint32_t before = current.get_publish_count();
+  bms.on_modbus_data(ecoworthy_modbus::FrameView(frame.data(), frame.size()));
+  return current.get_publish_count() != before;
+}
+
+static void expect(const char *what, bool actual, bool wanted) {
+  if (actual != wanted) {
+    printf("%s: %s, expected %s\n", what, actual ? "published" : "suppressed", wanted ? "published" : "suppressed");
+    failures++;
+  }
+}
+
+static void run(float deadband) {
+  ecoworthy_modbus::EcoworthyModbus bus;
+  EcoworthyBms bms;
+  bms.set_parent(&bus);
+  bms.set_address(1);
+  bms.set_publish_changes_only(true);
+  if (deadband > 0.0f)
+    bms.set_deadband(PACK_CURRENT, 1, deadband);
+  bus.register_device(&bms);
+  host::BmsSensors sensors;
+  sensors.attach(bms, 1);
+  sensor::Sensor current;
+  current.set_accuracy_decimals(1);
+  bms.set_pack_sensor(PACK_CURRENT, &current);
+  bus.setup();
+  bms.setup();
+
+  expect("first value", publishes_current(bms, current, -1000), true);
+  if (deadband == 0.0f) {
+    // Compared at one decimal: -10.04 A rounds to the published -10.0 A, -10.06 A does not
+    expect("same at accuracy_decimals", publishes_current(bms, current, -1004), false);
+    expect("differs at accuracy_decimals", publishes_current(bms, current, -1006), true);
+  } else {
+    // Deadband 0.5 A around the last published -10.00 A; drift does not add up unpublished
+    expect("within deadband", publishes_current(bms, current, -1040), false);
+    expect("within deadband again", publishes_current(bms, current, -960), false);
+    expect("past deadband", publishes_current(bms, current, -1060), true);
+    expect("within deadband of new value", publishes_current(bms, current, -1020), false);
+    expect("past deadband upwards", publishes_current(bms, current, -1000), true);
+  }
+}
+
+int main() {
+  run(0.0f);
+  run(0.5f);
+  if (failures == 0)
+    printf("publish_changes_only OK\n");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
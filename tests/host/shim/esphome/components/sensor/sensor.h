@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace sensor {
+
+class Sensor {
+ public:
+  void publish_state(float state) {
+    this->raw_state = state;
+    this->state = state;
+    this->has_state_ = true;
+    this->publish_count_++;
+  }
+  bool has_state() const { return this->has_state_; }
+  float get_raw_state() const { return this->raw_state; }
+  float get_state() const { return this->state; }
+  int8_t get_accuracy_decimals() { return this->accuracy_decimals_; }
+  void set_accuracy_decimals(int8_t accuracy_decimals) { this->accuracy_decimals_ = accuracy_decimals; }
+  uint32_t get_publish_count() const { return this->publish_count_; }
+
+  float state{NAN};
+  float raw_state{NAN};
+
+ protected:
+  int8_t accuracy_decimals_{2};
+  bool has_state_{false};
+  uint32_t publish_count_{0};
+};
+
+}  // namespace sensor
+}  // namespace esphome
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace text_sensor {
+
+// Keeps its text in a std::string like ESPHome's, so a publish with new text allocates here too
+class TextSensor {
+ public:
+  void publish_state(const std::string &state) {
+    this->raw_state = state;
+    this->state = state;
+    this->has_state_ = true;
+    this->publish_count_++;
+  }
+  bool has_state() const { return this->has_state_; }
+  std::string get_raw_state() const { return this->raw_state; }
+  uint32_t get_publish_count() const { return this->publish_count_; }
+
+  std::string state;
+  std::string raw_state;
+
+ protected:
+  bool has_state_{false};
+  uint32_t publish_count_{0};
+};
+
+}  // namespace text_sensor
+}  // namespace esphome
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace uart {
+
+enum UARTParityOptions {
+  UART_CONFIG_PARITY_NONE,
+  UART_CONFIG_PARITY_EVEN,
+  UART_CONFIG_PARITY_ODD,
+};
+
+class UARTComponent {
+ public:
+  uint32_t get_baud_rate() const { return 9600; }
+  uint8_t get_stop_bits() const { return 1; }
+  uint8_t get_data_bits() const { return 8; }
+  UARTParityOptions get_parity() const { return UART_CONFIG_PARITY_NONE; }
+};
+
+// All devices share one simulated line; host.h feeds its receive side and collects what is written
+class UARTDevice {
+ public:
+  void set_uart_parent(UARTComponent *parent) { this->parent_ = parent; }
+  void write_array(const uint8_t *data, size_t len);
+  bool read_byte(uint8_t *data);
+  bool read_array(uint8_t *data, size_t len);
+  int available();
+  // Blocks like the hardware driver: the clock advances until everything written has left the line
+  void flush();
+
+ protected:
+  UARTComponent *parent_{nullptr};
+};
+
+}  // namespace uart
+}  // namespace esphome
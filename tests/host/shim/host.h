@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Controls for the simulated clock and UART line behind the ESPHome shim
+namespace esphome {
+namespace host {
+
+// millis() and micros() only move when a test advances them
+void advance_us(uint32_t us);
+uint64_t now_us();
+
+// Queues bytes for the bus to read; what the bus writes is collected until cleared
+void uart_receive(const uint8_t *data, size_t len);
+size_t uart_pending();
+const std::vector<uint8_t> &uart_sent();
+void uart_clear_sent();
+
+}  // namespace host
+}  // namespace esphome
@@ -0,0 +1,101 @@
+#include "host.h"
+
+#include <cstdio>
+#include <string>
+
+#include "esphome/components/uart/uart.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+
+namespace setup_priority {
+const float BUS = 1000.0f;
+const float DATA = 600.0f;
+}  // namespace setup_priority
+
+static uint64_t clock_us = 0;
+
+// Received bytes are read from rx_buffer[rx_position]; the buffer is reused once drained, so feeding
+// the line does not allocate after warm-up
+static std::vector<uint8_t> rx_buffer;
+static size_t rx_position = 0;
+static std::vector<uint8_t> tx_buffer;
+static size_t tx_flushed = 0;  // Bytes of tx_buffer already on the wire
+
+uint32_t millis() { return uint32_t(clock_us / 1000); }
+uint32_t micros() { return uint32_t(clock_us); }
+void delay(uint32_t ms) { clock_us += uint64_t(ms) * 1000; }
+void delayMicroseconds(uint32_t us) { clock_us += us; }
+
+uint32_t random_uint32() {
+  static uint32_t state = 2463534242UL;  // xorshift32, fixed seed so runs repeat
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+float random_float() { return float(random_uint32()) / 4294967296.0f; }
+
+std::string format_hex_pretty(const uint8_t *data, size_t length) {
+  std::string out;
+  char hex[4];
+  for (size_t i = 0; i < length; i++) {
+    snprintf(hex, sizeof(hex), i + 1 < length ? "%02X." : "%02X", data[i]);
+    out += hex;
+  }
+  return out;
+}
+std::string format_hex_pretty(const std::vector<uint8_t> &data) { return format_hex_pretty(data.data(), data.size()); }
+
+namespace uart {
+
+void UARTDevice::write_array(const uint8_t *data, size_t len) { tx_buffer.insert(tx_buffer.end(), data, data + len); }
+
+bool UARTDevice::read_byte(uint8_t *data) {
+  if (rx_position == rx_buffer.size())
+    return false;
+  *data = rx_buffer[rx_position++];
+  if (rx_position == rx_buffer.size()) {
+    rx_buffer.clear();
+    rx_position = 0;
+  }
+  return true;
+}
+
+bool UARTDevice::read_array(uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (!this->read_byte(data + i))
+      return false;
+  }
+  return true;
+}
+
+int UARTDevice::available() { return int(rx_buffer.size() - rx_position); }
+
+void UARTDevice::flush() {
+  // 8N1: ten bits per byte
+  const UARTComponent line;
+  clock_us += uint64_t(tx_buffer.size() - tx_flushed) * 10 * 1000000 / line.get_baud_rate();
+  tx_flushed = tx_buffer.size();
+}
+
+}  // namespace uart
+
+namespace host {
+
+void advance_us(uint32_t us) { clock_us += us; }
+uint64_t now_us() { return clock_us; }
+
+void uart_receive(const uint8_t *data, size_t len) { rx_buffer.insert(rx_buffer.end(), data, data + len); }
+size_t uart_pending() { return rx_buffer.size() - rx_position; }
+const std::vector<uint8_t> &uart_sent() { return tx_buffer; }
+void uart_clear_sent() {
+  tx_buffer.clear();
+  tx_flushed = 0;
+}
+
+}  // namespace host
+
+}  // namespace esphome
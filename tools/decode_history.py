@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Decode the compressed pack status history dumped by ecoworthy_bms.
+
+Press the dump_history button (or call EcoworthyBms::dump_history()) and save the log, e.g. with
+`esphome logs bank.yaml > dump.log`. Every battery's history is printed between a header and an end
+line, one block every 50 ms, as "H<battery> <block sequence> <offset> <hex>" lines; the block format
+is described in components/ecoworthy_bms/pack_history.h. Blocks that lost a line in the log are
+reported and skipped. This tool turns those lines back into CSV, one row per
+sample, with times in ms of the device's millis() clock.
+
+    tools/decode_history.py dump.log --battery 1 > battery1.csv
+
+--benchmark encodes a synthetic trace from the emulator's random walk with the same encoder as the
+device, checks it decodes back exactly and compares bytes per sample with storing every field as a
+float plus a u32 timestamp:
+
+    tools/decode_history.py --benchmark --samples 20000 --interval 1000
+"""
+
+import argparse
+import csv
+import random
+import re
+import struct
+import sys
+
+BLOCK_SIZE = 256
+HEADER_SIZE = 8
+TIME_STEP_MS = 100
+ABSENT = -32768
+
+# (column, count, scale) in HistoryField order
+FIELDS = [
+    ("total_voltage", 1, 100),
+    ("current", 1, 100),
+    ("state_of_charge", 1, 100),
+    ("cell_voltage", 16, 1000),
+    ("temperature", 4, 10),
+    ("power_tube_temperature", 1, 10),
+]
+FIELD_COUNT = sum(count for _, count, _ in FIELDS)
+MASK_SIZE = (FIELD_COUNT + 7) // 8
+NAIVE_SAMPLE_SIZE = 4 + 4 * FIELD_COUNT
+
+LINE_RE = re.compile(r"\bH(\d+) (\d+) (\d+) ([0-9A-F]+)\s*$")
+
+
+def columns():
+    names = ["time_ms"]
+    for name, count, _ in FIELDS:
+        names += [name] if count == 1 else [f"{name}_{i + 1}" for i in range(count)]
+    return names
+
+
+def scales():
+    return [scale for _, count, scale in FIELDS for _ in range(count)]
+
+
+def get_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def put_varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def zigzag(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+def decode_block(block):
+    """Yield (time_ms, fields) for every sample of one block."""
+    start, used, count = struct.unpack_from("<IHH", block)
+    if used > len(block):
+        raise ValueError(f"block claims {used} bytes but only {len(block)} were dumped")
+    fields = [0] * FIELD_COUNT
+    time_ms = start
+    pos = HEADER_SIZE
+    for _ in range(count):
+        steps, pos = get_varint(block, pos)
+        time_ms = (time_ms + steps * TIME_STEP_MS) & 0xFFFFFFFF
+        mask = int.from_bytes(block[pos:pos + MASK_SIZE], "little")
+        pos += MASK_SIZE
+        for field in range(FIELD_COUNT):
+            if mask >> field & 1:
+                delta, pos = get_varint(block, pos)
+                fields[field] += unzigzag(delta)
+        yield time_ms, list(fields)
+    if pos != used:
+        raise ValueError(f"block decoded to {pos} bytes, header says {used}")
+
+
+def read_dump(lines):
+    """Return {battery: [block bytes, ...]} from log lines, oldest block first."""
+    chunks = {}
+    for line in lines:
+        match = LINE_RE.search(line)
+        if match:
+            battery, sequence, offset = (int(group) for group in match.group(1, 2, 3))
+            chunks.setdefault(battery, {}).setdefault(sequence, {})[offset] = bytes.fromhex(match.group(4))
+    blocks = {}
+    for battery, sequences in chunks.items():
+        blocks[battery] = []
+        for sequence in sorted(sequences):
+            raw = bytearray()
+            for offset, data in sorted(sequences[sequence].items()):
+                if offset != len(raw):
+                    break
+                raw += data
+            used = struct.unpack_from("<H", raw, 4)[0] if len(raw) >= HEADER_SIZE else 0
+            if used < HEADER_SIZE or used != len(raw):
+                print(f"battery {battery}: block {sequence} is incomplete, skipped", file=sys.stderr)
+                continue
+            blocks[battery].append(bytes(raw))
+    return blocks
+
+
+def write_csv(blocks, out):
+    writer = csv.writer(out)
+    writer.writerow(columns())
+    factors = scales()
+    for block in blocks:
+        for time_ms, fields in decode_block(block):
+            writer.writerow(
+                [time_ms] + ["" if value == ABSENT else value / factor for value, factor in zip(fields, factors)]
+            )
+
+
+class Encoder:
+    """Python port of PackHistory::add(), without the ring: blocks are kept until the end."""
+
+    def __init__(self):
+        self.blocks = []
+        self.previous = [0] * FIELD_COUNT
+        self.previous_time = 0
+
+    def encode(self, steps, fields):
+        out = put_varint(steps)
+        mask = 0
+        deltas = bytearray()
+        for field in range(FIELD_COUNT):
+            delta = fields[field] - self.previous[field]
+            if delta:
+                mask |= 1 << field
+                deltas += put_varint(zigzag(delta))
+        return out + mask.to_bytes(MASK_SIZE, "little") + deltas
+
+    def add(self, now, fields):
+        steps = (now - self.previous_time) // TIME_STEP_MS
+        sample = self.encode(steps, fields) if self.blocks else None
+        if sample is None or len(self.blocks[-1]) + len(sample) > BLOCK_SIZE:
+            self.blocks.append(bytearray(struct.pack("<IHH", now, HEADER_SIZE, 0)))
+            self.previous = [0] * FIELD_COUNT
+            self.previous_time = now
+            steps = 0
+            sample = self.encode(steps, fields)
+        block = self.blocks[-1]
+        block += sample
+        count = struct.unpack_from("<H", block, 6)[0]
+        struct.pack_into("<HH", block, 4, len(block), count + 1)
+        self.previous = list(fields)
+        self.previous_time += steps * TIME_STEP_MS
+
+
+def pack_fields(pack):
+    """The fields EcoworthyBms::add_history_sample_() would record for an emulated pack."""
+    return (
+        [sum(pack.cells_mv) // 10, int(round(pack.current * 100)), int(pack.soc * 100)]
+        + list(pack.cells_mv)
+        + [int(round(t * 10)) for t in pack.temperatures]
+        + [300]
+    )
+
+
+def benchmark(args):
+    from ecoworthy_emulator import Pack
+
+    rng = random.Random(args.seed)
+    pack = Pack(1, rng)
+    encoder = Encoder()
+    expected = []
+    now = 0
+    for _ in range(args.samples):
+        pack.vary()
+        now += args.interval + rng.randint(0, args.interval // 10)
+        fields = pack_fields(pack)
+        encoder.add(now, fields)
+        expected.append(fields)
+
+    decoded = [fields for block in encoder.blocks for _, fields in decode_block(bytes(block))]
+    if decoded != expected:
+        sys.exit("round trip mismatch")
+
+    used = sum(len(block) for block in encoder.blocks)
+    allocated = len(encoder.blocks) * BLOCK_SIZE
+    naive = args.samples * NAIVE_SAMPLE_SIZE
+    print(f"{args.samples} samples every ~{args.interval} ms, {len(encoder.blocks)} blocks of {BLOCK_SIZE} bytes")
+    print(f"  naive floats:  {NAIVE_SAMPLE_SIZE:6.2f} bytes/sample")
+    print(f"  delta encoded: {used / args.samples:6.2f} bytes/sample used, "
+          f"{allocated / args.samples:6.2f} with block slack ({naive / allocated:.1f}x smaller)")
+    print(f"  64 KiB holds {65536 * args.samples // allocated} samples "
+          f"(~{65536 * args.samples // allocated * args.interval / 3600000:.1f} h), "
+          f"naive {65536 // NAIVE_SAMPLE_SIZE}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="log containing a history dump (default stdin)")
+    parser.add_argument("--battery", type=int, default=None, help="battery to decode (default: the only one dumped)")
+    parser.add_argument("--benchmark", action="store_true", help="encode a synthetic trace instead of decoding a log")
+    parser.add_argument("--samples", type=int, default=10000, help="benchmark trace length")
+    parser.add_argument("--interval", type=int, default=1000, help="benchmark sample interval in ms")
+    parser.add_argument("--seed", type=int, default=1, help="benchmark random seed")
+    args = parser.parse_args()
+
+    if args.benchmark:
+        benchmark(args)
+        return
+
+    blocks = read_dump(args.log)
+    if not blocks:
+        sys.exit("no history lines found")
+    battery = args.battery
+    if battery is None:
+        if len(blocks) > 1:
+            sys.exit(f"dump has batteries {sorted(blocks)}, pick one with --battery")
+        battery = next(iter(blocks))
+    if battery not in blocks:
+        sys.exit(f"battery {battery} is not in the dump")
+    write_csv(blocks[battery], sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
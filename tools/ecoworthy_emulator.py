@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+"""Ecoworthy/JBD BMS bank emulator on a pseudo-terminal.
+
+Answers the framing handled by components/ecoworthy_modbus: 0x78 reads, 0x79 writes with the
+0x114A4244 prefix and 0x45 individual pack status, all with CRC16/0xA001 (LSB first). Register
+images follow REGISTER_MAP.md. Point a host build or a USB-RS485 bridge test at the printed pty
+path to benchmark polling throughput and recovery behaviour without batteries.
+
+Example, a 16-pack bank with one pack offline and a slow primary:
+
+    tools/ecoworthy_emulator.py --packs 16 --offline 7 --latency 120 --latency-for 1=250 \\
+        --baud 9600 --drop-rate 0.01 --crc-error-rate 0.005 --link /tmp/ttyECOWORTHY
+"""
+
+import argparse
+import os
+import random
+import select
+import signal
+import struct
+import sys
+import time
+import tty
+
+FUNCTION_INDIVIDUAL_PACK_STATUS = 0x45
+FUNCTION_READ = 0x78
+FUNCTION_WRITE = 0x79
+WRITE_PREFIX = bytes([0x11, 0x4A, 0x42, 0x44])
+HEADER_LEN = 8
+MAX_DATA_LEN = 512
+
+REG_PACK_STATUS = 0x1000
+REG_PROTECTION_PARAMS = 0x1800
+REG_CONFIG_1C00 = 0x1C00
+REG_CONFIG_2000 = 0x2000
+REG_PRODUCT_INFO = 0x2810
+REG_MOS_CONTROL = 0x2902
+REG_DRY_CONTACT = 0x2904
+REG_SLEEP_MODE = 0x2908
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def build_frame(address, function, start, end, payload=b""):
+    frame = struct.pack(">BBHHH", address, function, start, end, len(payload)) + payload
+    return frame + struct.pack("<H", crc16(frame))
+
+
+def temp_raw(celsius):
+    return int(round(celsius * 10)) + 500
+
+
+class Pack:
+    """Register images of one battery, built from REGISTER_MAP.md."""
+
+    CELLS = 16
+    TEMPERATURES = 4
+
+    def __init__(self, address, rng):
+        self.address = address
+        self.rng = rng
+        self.cells_mv = [3300 + rng.randint(-15, 15) for _ in range(self.CELLS)]
+        self.temperatures = [24.0 + rng.uniform(-1.5, 1.5) for _ in range(self.TEMPERATURES)]
+        self.current = -12.5 + address
+        self.soc = 76.0 - address
+        self.mosfet = 0x0003
+        self.cycles = 40 + address
+        self.serial = f"UP16S0190001242250713{address:03d}".encode()
+
+    def vary(self):
+        """Small random walk so change-gated publishing and filters have something to do."""
+        self.cells_mv = [max(2500, min(3650, mv + self.rng.randint(-2, 2))) for mv in self.cells_mv]
+        self.temperatures = [t + self.rng.uniform(-0.1, 0.1) for t in self.temperatures]
+        self.current += self.rng.uniform(-0.3, 0.3)
+
+    def pack_status(self):
+        cells = self.cells_mv
+        voltage_cv = sum(cells) // 10
+        max_cell = max(range(self.CELLS), key=lambda i: cells[i])
+        min_cell = min(range(self.CELLS), key=lambda i: cells[i])
+        temps = self.temperatures
+        status = 1 if self.current > 0.5 else 2 if self.current < -0.5 else 0
+        data = struct.pack(
+            ">HHIHHHHHHHHIIHHHHHHHHHHHHHHHHHH",
+            voltage_cv,
+            voltage_cv,
+            int(round(self.current * 100)) + 300000,
+            int(self.soc * 100),
+            int(self.soc * 100),  # Residual capacity, 100 Ah pack
+            10000,
+            10000,
+            temp_raw(30.0),
+            temp_raw(25.0),
+            status,
+            98,
+            0,  # Fault bitmask
+            0,  # Alarm bitmask
+            self.mosfet,
+            0,
+            self.cycles,
+            max_cell + 1,
+            cells[max_cell],
+            min_cell + 1,
+            cells[min_cell],
+            sum(cells) // self.CELLS,
+            temps.index(max(temps)) + 1,
+            temp_raw(max(temps)),
+            temps.index(min(temps)) + 1,
+            temp_raw(min(temps)),
+            temp_raw(sum(temps) / len(temps)),
+            568,  # CVL 56.8 V
+            1000,  # CCL 100.0 A
+            480,  # DVL 48.0 V
+            1000,  # DCL 100.0 A
+            self.CELLS,
+        )
+        data += struct.pack(f">{self.CELLS}H", *cells)
+        data += struct.pack(f">H{self.TEMPERATURES}H", self.TEMPERATURES, *(temp_raw(t) for t in temps))
+        balancing = 1 << max_cell if cells[max_cell] - cells[min_cell] > 10 else 0
+        data += struct.pack(">HHH", 0, balancing, 0x0102)
+        data += self.serial.ljust(30, b"\0")[:30]
+        return data.ljust(0xA0, b"\0")
+
+    def individual_status(self):
+        return self.pack_status()[:96] + struct.pack(">HH", 500, 500)
+
+    @staticmethod
+    def config_1c00():
+        data = bytearray(136)
+        struct.pack_into(">HHHHHH", data, 4, 3350, 10, temp_raw(0), temp_raw(10), 5680, 1500)
+        data[16:42] = b"UP16S0190001242250713001".ljust(26, b"\0")
+        struct.pack_into(">HHH", data, 46, 2025, 7, 29)
+        data[52:64] = b"JBD481000000"
+        struct.pack_into(">HHH", data, 64, 4400, 60, 0)
+        return bytes(data)
+
+    @staticmethod
+    def config_2000():
+        data = bytearray(80)
+        struct.pack_into(">II", data, 12, 1234567, 1200345)
+        struct.pack_into(">HHHH", data, 32, 568, 1000, 480, 1000)
+        struct.pack_into(">H", data, 44, 250)
+        return bytes(data)
+
+    @staticmethod
+    def product_info():
+        data = bytearray(44)
+        struct.pack_into(">HHHH", data, 4, 12, 1, 2, 3)
+        data[12:28] = b"UP16S015".ljust(16, b"\0")
+        return bytes(data)
+
+    @staticmethod
+    def protection_params():
+        data = bytearray(208)
+        struct.pack_into(">12H", data, 0, 3550, 3450, 2000, 3600, 3500, 1000, 2750, 2900, 2000, 2700, 2950, 1000)
+        struct.pack_into(">12H", data, 24, 5680, 5520, 2000, 5760, 5600, 1000, 4400, 4640, 2000, 4200, 4720, 1000)
+        struct.pack_into(">10H", data, 48, 1050, 0, 5000, 1200, 3000, 60000, 0, 1300, 500, 0)
+        struct.pack_into(">10H", data, 68, 1050, 0, 5000, 1200, 3000, 60000, 0, 1400, 500, 0)
+        temps = [(55, 50), (65, 60), (5, 10), (0, 5), (60, 55), (65, 60), (-15, -10), (-20, -15)]
+        for i, (trigger, release) in enumerate(temps):
+            struct.pack_into(">HHH", data, 88 + i * 6, temp_raw(trigger), temp_raw(release), 5000)
+        return bytes(data)
+
+
+class Emulator:
+    def __init__(self, args):
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.packs = {args.base_address + i: Pack(args.base_address + i, self.rng) for i in range(args.packs)}
+        self.offline = set(args.offline)
+        self.latency = {address: args.latency for address in self.packs}
+        for entry in args.latency_for:
+            address, latency = entry.split("=")
+            self.latency[int(address, 0)] = float(latency)
+        self.byte_time = 10.0 / args.baud if args.baud > 0 else 0.0
+        self.rx = bytearray()
+        self.stats = {"requests": 0, "responses": 0, "dropped": 0, "corrupted": 0, "offline": 0, "bad_crc": 0}
+        self.per_address = {address: 0 for address in self.packs}
+
+    def open_pty(self):
+        master, slave = os.openpty()
+        tty.setraw(slave)
+        path = os.ttyname(slave)
+        if self.args.link:
+            if os.path.islink(self.args.link):
+                os.unlink(self.args.link)
+            os.symlink(path, self.args.link)
+            path = f"{self.args.link} -> {path}"
+        print(f"Emulating {len(self.packs)} pack(s) on {path}", flush=True)
+        return master, slave
+
+    def next_frame(self):
+        """Pop one complete request from the receive buffer, resynchronizing past garbage."""
+        while len(self.rx) >= HEADER_LEN + 2:
+            if self.rx[1] not in (FUNCTION_READ, FUNCTION_WRITE, FUNCTION_INDIVIDUAL_PACK_STATUS):
+                del self.rx[0]
+                continue
+            data_len = struct.unpack_from(">H", self.rx, 6)[0]
+            if data_len > MAX_DATA_LEN:
+                del self.rx[0]
+                continue
+            total = HEADER_LEN + data_len + 2
+            if len(self.rx) < total:
+                return None
+            frame = bytes(self.rx[:total])
+            if crc16(frame[:-2]) != struct.unpack_from("<H", frame, total - 2)[0]:
+                self.stats["bad_crc"] += 1
+                del self.rx[0]
+                continue
+            del self.rx[:total]
+            return frame
+        return None
+
+    def respond(self, frame):
+        address, function, start, end, data_len = struct.unpack_from(">BBHHH", frame)
+        pack = self.packs.get(address)
+        if pack is None:
+            return None  # Not one of ours; a real bank stays silent too
+        self.stats["requests"] += 1
+        if address in self.offline:
+            self.stats["offline"] += 1
+            return None
+        if self.rng.random() < self.args.drop_rate:
+            self.stats["dropped"] += 1
+            return None
+
+        if function == FUNCTION_WRITE:
+            payload = frame[HEADER_LEN:HEADER_LEN + data_len]
+            if not payload.startswith(WRITE_PREFIX):
+                return None
+            value = payload[len(WRITE_PREFIX):]
+            if start == REG_MOS_CONTROL and len(value) >= 2:
+                pack.mosfet = (pack.mosfet & ~0x0003) | (value[1] & 0x03)
+            print(f"Write 0x{address:02X} 0x{start:04X}: {value.hex(' ')}", flush=True)
+            response = build_frame(address, function, start, end)
+        elif function == FUNCTION_INDIVIDUAL_PACK_STATUS:
+            if address != self.args.base_address:
+                return None  # Only the directly connected battery answers 0x45
+            response = build_frame(address, function, start, end, pack.individual_status())
+        else:
+            images = {
+                REG_PACK_STATUS: pack.pack_status,
+                REG_CONFIG_1C00: Pack.config_1c00,
+                REG_CONFIG_2000: Pack.config_2000,
+                REG_PRODUCT_INFO: Pack.product_info,
+                REG_PROTECTION_PARAMS: Pack.protection_params,
+            }
+            image = images.get(start)
+            if image is None:
+                return None
+            if start != REG_PACK_STATUS and address != self.args.base_address:
+                return None  # Config blocks are only available from the primary
+            if self.args.vary and start == REG_PACK_STATUS:
+                pack.vary()
+            response = build_frame(address, function, start, end, image()[: max(0, end - start)])
+
+        if self.rng.random() < self.args.crc_error_rate:
+            self.stats["corrupted"] += 1
+            corrupt = bytearray(response)
+            corrupt[self.rng.randrange(HEADER_LEN, len(corrupt))] ^= 1 << self.rng.randrange(8)
+            response = bytes(corrupt)
+
+        self.stats["responses"] += 1
+        self.per_address[address] += 1
+        return response
+
+    def send(self, fd, response):
+        if self.byte_time == 0:
+            os.write(fd, response)
+            return
+        # Byte-level pacing at the configured baud rate
+        start = time.monotonic()
+        for i, byte in enumerate(response):
+            delay = start + i * self.byte_time - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            os.write(fd, bytes([byte]))
+
+    def run(self):
+        master, _slave = self.open_pty()
+        while True:
+            readable, _, _ = select.select([master], [], [], 1.0)
+            if not readable:
+                continue
+            self.rx += os.read(master, 1024)
+            while True:
+                frame = self.next_frame()
+                if frame is None:
+                    break
+                address = frame[0]
+                response = self.respond(frame)
+                if response is None:
+                    continue
+                latency = self.latency.get(address, self.args.latency) + self.rng.uniform(0, self.args.jitter)
+                time.sleep(latency / 1000.0)
+                self.send(master, response)
+
+    def print_stats(self):
+        print("\nStatistics:", ", ".join(f"{key} {value}" for key, value in self.stats.items()))
+        for address, count in sorted(self.per_address.items()):
+            state = " (offline)" if address in self.offline else ""
+            print(f"  0x{address:02X}: {count} responses{state}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--packs", type=int, default=1, choices=range(1, 17), metavar="1-16")
+    parser.add_argument("--base-address", type=lambda v: int(v, 0), default=0x01)
+    parser.add_argument("--latency", type=float, default=150.0, help="response latency in ms (default 150)")
+    parser.add_argument("--latency-for", action="append", default=[], metavar="ADDR=MS",
+                        help="per-address response latency, repeatable")
+    parser.add_argument("--jitter", type=float, default=20.0, help="random extra latency up to this many ms")
+    parser.add_argument("--baud", type=int, default=9600, help="pace response bytes at this rate, 0 to disable")
+    parser.add_argument("--drop-rate", type=float, default=0.0, help="probability a response is not sent")
+    parser.add_argument("--crc-error-rate", type=float, default=0.0, help="probability a response has a bit flipped")
+    parser.add_argument("--offline", action="append", default=[], type=lambda v: int(v, 0), metavar="ADDR",
+                        help="address that never answers, repeatable")
+    parser.add_argument("--vary", action="store_true", help="random-walk cell voltages, temperatures and current")
+    parser.add_argument("--seed", type=int, default=None, help="random seed for repeatable runs")
+    parser.add_argument("--link", help="create a symlink to the pty at this path")
+    args = parser.parse_args()
+
+    emulator = Emulator(args)
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    try:
+        emulator.run()
+    except (KeyboardInterrupt, SystemExit):
+        pass
+    finally:
+        emulator.print_stats()
+        if args.link and os.path.islink(args.link):
+            os.unlink(args.link)
+
+
+if __name__ == "__main__":
+    main()